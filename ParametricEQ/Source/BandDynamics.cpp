@@ -0,0 +1,198 @@
+/*
+  ==============================================================================
+
+    BandDynamics.cpp
+
+  ==============================================================================
+*/
+
+#include "BandDynamics.h"
+
+DynamicsSettings::DynamicsSettings() noexcept
+{
+    threshold_db.fill(-24.f);
+    ratio.fill(4.f);
+    attack_ms.fill(10.f);
+    release_ms.fill(150.f);
+    dynamic.fill(false);
+    sidechain.fill(false);
+}
+
+bool DynamicsSettings::isAnyBandDynamic() const noexcept
+{
+    return std::find(dynamic.begin(), dynamic.end(), true) != dynamic.end();
+}
+
+bool isDynamicsParameterID(const juce::String& parameter_id)
+{
+    if (getBandForParameterID(parameter_id) < 0)
+        return false;
+    
+    for (auto* suffix : { " Dynamic", " Threshold", " Ratio", " Attack", " Release", " Sidechain" })
+        if (parameter_id.endsWith(suffix))
+            return true;
+    
+    return false;
+}
+
+void BandDynamics::prepare(double new_sample_rate, int max_block_size)
+{
+    sample_rate = new_sample_rate;
+    main_mix.assign((size_t) juce::jmax(1, max_block_size), 0.0);
+    sidechain_mix.assign(main_mix.size(), 0.0);
+    
+    // Designed again on the next setSettings
+    detector_freq.fill(0.f);
+    reset();
+}
+
+void BandDynamics::reset() noexcept
+{
+    for (int band = 0; band < max_bands; ++band)
+        clearBand(band);
+}
+
+void BandDynamics::clearBand(int band) noexcept
+{
+    const auto i = (size_t) band;
+    
+    if (gain_offset_db[i] != 0.f)
+        changed_bands |= getBandBit(getBandPosition(band));
+    
+    gain_offset_db[i] = 0.f;
+    envelope_db[i] = silence_db;
+    detector_state[i] = {};
+}
+
+void BandDynamics::setSettings(const DynamicsSettings& dynamics_settings, const ChainSettings& chain_settings) noexcept
+{
+    settings = dynamics_settings;
+    const auto old_bands = dynamic_bands;
+    dynamic_bands = 0;
+    sidechain_bands = 0;
+    
+    for (int band = 0; band < max_bands; ++band)
+    {
+        const auto i = (size_t) band;
+        const auto bit = getBandBit(getBandPosition(band));
+        
+        if (! settings.dynamic[i] || ! chain_settings.band_enabled[i] || chain_settings.band_type[i] == Band_Notch)
+        {
+            // Back to the band's own gain
+            if (old_bands & bit)
+                clearBand(band);
+            
+            continue;
+        }
+        
+        dynamic_bands |= bit;
+        
+        if (settings.sidechain[i])
+            sidechain_bands |= bit;
+        
+        // The detector follows the band, a redesign only costs a sin and a cos
+        const auto freq = juce::jmin(chain_settings.band_freq[i], (float) (sample_rate * 0.49));
+        
+        if (freq != detector_freq[i] || chain_settings.band_q[i] != detector_q[i])
+        {
+            detector_freq[i] = freq;
+            detector_q[i] = chain_settings.band_q[i];
+            makeBandPassCoefficients(detectors[i], sample_rate, freq, detector_q[i]);
+        }
+    }
+}
+
+template <typename SampleType>
+void BandDynamics::mixToMono(const SampleType* const* channels, int num_channels, int start_sample, int num_samples, double* mono) noexcept
+{
+    const auto gain = 1.0 / (double) juce::jmax(1, num_channels);
+    
+    for (int n = 0; n < num_samples; ++n)
+        mono[n] = (double) channels[0][start_sample + n];
+    
+    for (int ch = 1; ch < num_channels; ++ch)
+        for (int n = 0; n < num_samples; ++n)
+            mono[n] += (double) channels[ch][start_sample + n];
+    
+    for (int n = 0; n < num_samples; ++n)
+        mono[n] *= gain;
+}
+
+double BandDynamics::measureBand(int band, const double* input, int num_samples) noexcept
+{
+    const auto& c = detectors[(size_t) band];
+    auto s1 = detector_state[(size_t) band][0], s2 = detector_state[(size_t) band][1];
+    auto sum = 0.0;
+    
+    for (int n = 0; n < num_samples; ++n)
+    {
+        const auto y = c.b0 * input[n] + s1;
+        s1 = c.b1 * input[n] - c.a1 * y + s2;
+        s2 = c.b2 * input[n] - c.a2 * y;
+        sum += y * y;
+    }
+    
+    detector_state[(size_t) band] = { s1, s2 };
+    return sum / (double) juce::jmax(1, num_samples);
+}
+
+template <typename SampleType>
+int BandDynamics::process(const SampleType* const* main, int num_main_channels,
+                          const SampleType* const* sidechain, int num_sidechain_channels,
+                          int start_sample, int num_samples) noexcept
+{
+    auto moved_bands = std::exchange(changed_bands, 0);
+    
+    if (dynamic_bands == 0 || num_main_channels <= 0 || num_samples <= 0)
+        return moved_bands;
+    
+    // Control blocks are never longer than the host block
+    jassert(num_samples <= (int) main_mix.size());
+    num_samples = juce::jmin(num_samples, (int) main_mix.size());
+    
+    const auto use_sidechain = sidechain != nullptr && num_sidechain_channels > 0;
+    
+    if ((dynamic_bands & ~sidechain_bands) != 0 || ! use_sidechain)
+        mixToMono(main, num_main_channels, start_sample, num_samples, main_mix.data());
+    
+    if (sidechain_bands != 0 && use_sidechain)
+        mixToMono(sidechain, num_sidechain_channels, start_sample, num_samples, sidechain_mix.data());
+    
+    const auto block_seconds = (double) num_samples / sample_rate;
+    
+    for (int band = 0; band < max_bands; ++band)
+    {
+        const auto i = (size_t) band;
+        const auto bit = getBandBit(getBandPosition(band));
+        
+        if ((dynamic_bands & bit) == 0)
+            continue;
+        
+        const auto& input = (sidechain_bands & bit) != 0 && use_sidechain ? sidechain_mix : main_mix;
+        const auto mean_square = measureBand(band, input.data(), num_samples);
+        
+        // +3 dB so a sine reads at its peak level
+        const auto level_db = (float) juce::jmax((double) silence_db, 10.0 * std::log10(mean_square + 1.0e-30) + 3.0103);
+        
+        // One pole in dB, stepped once per control block
+        const auto time_ms = level_db > envelope_db[i] ? settings.attack_ms[i] : settings.release_ms[i];
+        const auto coefficient = (float) std::exp(-block_seconds * 1000.0 / juce::jmax(0.01, (double) time_ms));
+        envelope_db[i] = level_db + coefficient * (envelope_db[i] - level_db);
+        
+        const auto over_db = envelope_db[i] - settings.threshold_db[i];
+        const auto target_db = over_db > 0.f ? juce::jmax(-max_dynamic_cut_db, -over_db * (1.f - 1.f / juce::jmax(1.f, settings.ratio[i])))
+                                             : 0.f;
+        
+        // Small steps aren't worth a redesign, but the way back always ends at exactly 0 dB
+        if (std::abs(target_db - gain_offset_db[i]) >= min_gain_step_db || (target_db == 0.f && gain_offset_db[i] != 0.f))
+        {
+            gain_offset_db[i] = target_db;
+            moved_bands |= bit;
+        }
+    }
+    
+    return moved_bands;
+}
+
+template int BandDynamics::process<float>(const float* const*, int, const float* const*, int, int, int) noexcept;
+template int BandDynamics::process<double>(const double* const*, int, const double* const*, int, int, int) noexcept;
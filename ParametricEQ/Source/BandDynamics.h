@@ -0,0 +1,91 @@
+/*
+  ==============================================================================
+
+    BandDynamics.h
+
+    Dynamic EQ. A dynamic band is turned down by the amount its level
+    goes over a threshold, like a compressor acting on that band alone.
+    The level is read from the main input or the sidechain, mixed to mono
+    and band passed at the band's frequency and Q. The detectors run per
+    sample, but the envelopes and gains only move once per control block,
+    so a moving band costs one redesign per control block rather than per
+    sample.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterChain.h"
+
+// Most a band's gain is pulled down by on top of its own gain
+static constexpr float max_dynamic_cut_db = 24.f;
+
+// Dynamics parameters of the bands, one array per parameter like
+// ChainSettings. Defaults match the parameter layout.
+struct DynamicsSettings
+{
+    DynamicsSettings() noexcept;
+    
+    bool isAnyBandDynamic() const noexcept;
+    
+    std::array<float, max_bands> threshold_db, ratio, attack_ms, release_ms;
+    std::array<bool, max_bands> dynamic, sidechain;
+};
+
+// Parameter IDs that only drive the dynamics ("PeakN Dynamic", "PeakN
+// Threshold", ...), changing them needs no redesign
+bool isDynamicsParameterID(const juce::String& parameter_id);
+
+class BandDynamics
+{
+public:
+    // max_block_size is the most process() is handed at once
+    void prepare(double sample_rate, int max_block_size);
+    
+    // Envelopes back to silence. Bands that had a gain offset report it as
+    // changed on the next process().
+    void reset() noexcept;
+    
+    // Once per block. Disabled bands and notches (which have no gain) stay static.
+    void setSettings(const DynamicsSettings& dynamics_settings, const ChainSettings& chain_settings) noexcept;
+    
+    // ChainPositions bits
+    int getDynamicBands() const noexcept { return dynamic_bands; }
+    
+    // Runs the detectors over one control block and moves the envelopes.
+    // Bands listening to the sidechain use the main input while it has no
+    // channels. Returns the bands whose gain offset changed (ChainPositions bits).
+    template <typename SampleType>
+    int process(const SampleType* const* main, int num_main_channels,
+                const SampleType* const* sidechain, int num_sidechain_channels,
+                int start_sample, int num_samples) noexcept;
+    
+    // Added to each band's gain when it's designed, 0 dB or below
+    const std::array<float, max_bands>& getGainOffsets() const noexcept { return gain_offset_db; }
+    
+private:
+    template <typename SampleType>
+    static void mixToMono(const SampleType* const* channels, int num_channels, int start_sample, int num_samples, double* mono) noexcept;
+    
+    // Mean square of the band passed detector over the block
+    double measureBand(int band, const double* input, int num_samples) noexcept;
+    void clearBand(int band) noexcept;
+    
+    // Offsets closer than this are left alone rather than redesigned
+    static constexpr float min_gain_step_db = 0.05f;
+    static constexpr float silence_db = -120.f;
+    
+    double sample_rate { 44100.0 };
+    int dynamic_bands { 0 }, sidechain_bands { 0 }, changed_bands { 0 };
+    DynamicsSettings settings;
+    std::vector<double> main_mix, sidechain_mix;
+    
+    // Detector per band, and the frequency and Q it was designed for
+    std::array<BiquadCoefficients<double>, max_bands> detectors {};
+    std::array<std::array<double, 2>, max_bands> detector_state {};
+    std::array<float, max_bands> detector_freq {}, detector_q {};
+    
+    std::array<float, max_bands> envelope_db {}, gain_offset_db {};
+};
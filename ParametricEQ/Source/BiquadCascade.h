@@ -0,0 +1,486 @@
+/*
+  ==============================================================================
+
+    BiquadCascade.h
+
+    A chain of second order sections processed in a single pass, shared by
+    every channel. Channels are packed into SIMD lanes (one channel per
+    lane) so stereo, quad or 7.1 all run through one set of coefficients.
+    The cascade runs in float or double, state and coefficients included.
+    The instruction set is picked at runtime from what the CPU supports,
+    with a scalar fallback.
+
+    Every active section runs per sample with its state held in locals, so
+    the block is read and written once no matter how many sections are on.
+    Inactive sections are skipped entirely but keep their state, like a
+    bypassed juce::dsp::IIR::Filter. The maths is the same transposed
+    direct form II as juce::dsp::IIR::Filter.
+
+    The first two channels can also run different subsets of the sections,
+    or be encoded to mid / side on the way into the kernel and decoded on
+    the way out, see setSides.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BiquadDesign.h"
+#include "ChannelWorkerPool.h"
+
+// Longest cascade the kernels are specialised for
+static constexpr int max_cascade_sections = 32;
+
+// Adapts a vector type to the cascade kernel, one channel per lane. Plain
+// float and double are a single lane.
+template <typename VectorType>
+struct LaneTraits
+{
+    using SampleType = VectorType;
+
+    static constexpr int width = 1;
+    static SampleType load(const SampleType* source) noexcept              { return *source; }
+    static void store(SampleType* destination, SampleType v) noexcept      { *destination = v; }
+    static SampleType broadcast(SampleType v) noexcept                     { return v; }
+};
+
+#if JUCE_USE_SIMD
+template <typename Type>
+struct LaneTraits<juce::dsp::SIMDRegister<Type>>
+{
+    using SampleType = Type;
+    using Register = juce::dsp::SIMDRegister<Type>;
+
+    static constexpr int width = (int) Register::SIMDNumElements;
+    static Register load(const SampleType* source) noexcept              { return Register::fromRawArray(source); }
+    static void store(SampleType* destination, Register v) noexcept      { v.copyToRawArray(destination); }
+    static Register broadcast(SampleType v) noexcept                     { return Register::expand(v); }
+};
+#endif
+
+// Cascade state is [section][s1, s2][lane], coefficients are shared by all lanes
+template <typename SampleType>
+using CascadeKernel = void (*)(SampleType* interleaved, int num_samples,
+                               const BiquadCoefficients<SampleType>* coefficients,
+                               SampleType* state, const int* active_sections);
+
+// Same, but every lane has coefficients of its own, laid out like the
+// state as [section][b0, b1, b2, a1, a2][lane]. For unrelated streams
+// sharing a register, see EqEngine.
+template <typename SampleType>
+using LaneCascadeKernel = void (*)(SampleType* interleaved, int num_samples,
+                                   const SampleType* lane_coefficients,
+                                   SampleType* state, const int* active_sections);
+
+static constexpr int num_lane_coefficients = 5;
+
+template <typename SampleType>
+struct CascadeKernelSet
+{
+    const char* name;
+    int width;
+    std::array<CascadeKernel<SampleType>, max_cascade_sections + 1> kernels;
+    std::array<LaneCascadeKernel<SampleType>, max_cascade_sections + 1> lane_kernels;
+};
+
+// Defined for float and double in BiquadCascadeKernels.cpp / BiquadCascadeKernelsAVX.cpp
+template <typename SampleType> const CascadeKernelSet<SampleType>& getScalarCascadeKernels();
+template <typename SampleType> const CascadeKernelSet<SampleType>* getSIMDRegisterCascadeKernels();
+
+// Only call these if SystemStats::hasAVX()
+template <typename SampleType> const CascadeKernelSet<SampleType>* getAVXCascadeKernels();
+template <> const CascadeKernelSet<float>* getAVXCascadeKernels<float>();
+template <> const CascadeKernelSet<double>* getAVXCascadeKernels<double>();
+
+// Widest kernel set this CPU can run
+template <typename SampleType> const CascadeKernelSet<SampleType>& getBestCascadeKernels();
+
+// SIMD loads need the lane vectors aligned
+template <typename SampleType>
+struct AlignedBuffer
+{
+    void allocate(size_t num_values)
+    {
+        storage.allocate(num_values + alignment / sizeof(SampleType), true);
+        auto address = reinterpret_cast<juce::pointer_sized_uint>(storage.getData());
+        data = reinterpret_cast<SampleType*>((address + alignment - 1) & ~(juce::pointer_sized_uint) (alignment - 1));
+    }
+
+    void clear(size_t num_values) noexcept
+    {
+        if (data != nullptr)
+            std::fill(data, data + num_values, SampleType());
+    }
+
+    SampleType* getData() const noexcept { return data; }
+
+    static constexpr size_t alignment = 64;
+    juce::HeapBlock<SampleType> storage;
+    SampleType* data = nullptr;
+};
+
+//==============================================================================
+template <int MaxSections, typename SampleType>
+class BiquadCascade
+{
+public:
+    static constexpr int max_sections = MaxSections;
+    static_assert(max_sections <= max_cascade_sections, "No kernel for a cascade this long");
+
+    BiquadCascade() { setActiveSections(0); }
+
+    // Allocates state and scratch, call from prepareToPlay
+    void prepare(int num_channels, int max_block_size)
+    {
+        prepare(num_channels, max_block_size, getBestCascadeKernels<SampleType>());
+    }
+
+    void prepare(int num_channels, int max_block_size, const CascadeKernelSet<SampleType>& kernel_set)
+    {
+        kernel_set_ptr = &kernel_set;
+        const auto width = kernel_set.width;
+
+        prepared_channels = num_channels;
+        num_groups = (num_channels + width - 1) / width;
+        state_stride = max_sections * 2 * width;
+
+        // Each group gets its own scratch so groups can run on different threads
+        state.allocate((size_t) (num_groups * state_stride));
+        scratch.allocate((size_t) (num_groups * max_block_size * width));
+        lane_coefficients.allocate((size_t) (max_sections * num_lane_coefficients * width));
+        lane_coefficients_dirty = true;
+        prepared_block_size = max_block_size;
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        state.clear((size_t) (num_groups * state_stride));
+    }
+
+    // Clears the state of the sections in mask, e.g. ones coming back into the chain
+    void resetSections(juce::uint32 mask) noexcept
+    {
+        const auto width = kernel_set_ptr != nullptr ? kernel_set_ptr->width : 1;
+        
+        for (int group = 0; group < num_groups; ++group)
+            for (int i = 0; i < max_sections; ++i)
+                if (mask & (1u << i))
+                    std::fill_n(state.getData() + group * state_stride + i * 2 * width, 2 * width, SampleType());
+    }
+    
+    // One channel's state of a section, for handing it to another cascade
+    std::pair<SampleType, SampleType> getSectionState(int section, int channel) const noexcept
+    {
+        const auto* s = getSectionStateData(section, channel);
+        return { s[0], s[kernel_set_ptr->width] };
+    }
+    
+    void setSectionState(int section, int channel, std::pair<SampleType, SampleType> new_state) noexcept
+    {
+        auto* s = getSectionStateData(section, channel);
+        s[0] = new_state.first;
+        s[kernel_set_ptr->width] = new_state.second;
+    }
+    
+    // Takes over another cascade's coefficients and state, both must be
+    // prepared with the same channel count and kernel set. Never allocates.
+    void copyFrom(const BiquadCascade& other) noexcept
+    {
+        jassert(other.num_groups == num_groups && other.state_stride == state_stride);
+        
+        coefficients = other.coefficients;
+        active = other.active;
+        active_mask = other.active_mask;
+        num_active = other.num_active;
+        side_masks = other.side_masks;
+        side_active = other.side_active;
+        side_num_active = other.side_num_active;
+        split_sides = other.split_sides;
+        mid_side = other.mid_side;
+        lane_coefficients_dirty = true;
+        std::copy(other.state.getData(), other.state.getData() + num_groups * state_stride, state.getData());
+    }
+    
+    void setCoefficients(int section, const BiquadCoefficients<SampleType>& new_coefficients) noexcept
+    {
+        jassert(section >= 0 && section < max_sections);
+        coefficients[(size_t) section] = new_coefficients;
+        lane_coefficients_dirty = true;
+    }
+
+    // One bit per section, in chain order
+    void setActiveSections(juce::uint32 mask) noexcept
+    {
+        active_mask = mask;
+        num_active = 0;
+
+        for (int i = 0; i < max_sections; ++i)
+            if (mask & (1u << i))
+                active[(size_t) num_active++] = i;
+
+        updateSides();
+    }
+    
+    // The sections channel 0 and channel 1 run, out of the active ones.
+    // With use_mid_side the pair is encoded to mid (channel 0) and side
+    // (channel 1) while it's interleaved and decoded while it's
+    // deinterleaved, so it takes no extra pass over the block. Further
+    // channels run every active section. Split sides run the pair through
+    // the per lane kernel, a section a lane skips getting pass-through
+    // coefficients there, so the cost is that of all the sections either
+    // side runs. The scalar fallback has no interleave step to fold mid /
+    // side into and converts the pair in place instead.
+    void setSides(juce::uint32 first_mask, juce::uint32 second_mask, bool use_mid_side) noexcept
+    {
+        side_masks = { first_mask, second_mask };
+        mid_side = use_mid_side;
+        updateSides();
+    }
+
+    juce::uint32 getActiveSections() const noexcept { return active_mask; }
+    int getNumActiveSections() const noexcept       { return num_active; }
+
+    const BiquadCoefficients<SampleType>& getCoefficients(int section) const noexcept { return coefficients[(size_t) section]; }
+
+    // Spread channel groups over a worker pool (nullptr to stay on the calling thread)
+    void setWorkerPool(ChannelWorkerPool* new_pool) noexcept { worker_pool = new_pool; }
+
+    int getNumChannels() const noexcept      { return prepared_channels; }
+    int getNumChannelGroups() const noexcept { return num_groups; }
+
+    const char* getInstructionSetName() const noexcept { return kernel_set_ptr != nullptr ? kernel_set_ptr->name : "none"; }
+
+    void process(SampleType* const* channels, int num_channels, int num_samples) noexcept
+    {
+        process(channels, num_channels, 0, num_samples);
+    }
+
+    void process(SampleType* const* channels, int num_channels, int start_sample, int num_samples) noexcept
+    {
+        jassert(kernel_set_ptr != nullptr);
+        jassert(num_channels <= prepared_channels);
+
+        const auto in_place_mid_side = mid_side && num_channels >= 2 && kernel_set_ptr->width == 1;
+
+        if (split_sides && kernel_set_ptr->width > 1 && lane_coefficients_dirty)
+            updateLaneCoefficients();
+
+        // Hosts occasionally send more than they promised, scratch is only so big
+        for (int offset = start_sample; offset < start_sample + num_samples; offset += prepared_block_size)
+        {
+            const auto chunk = juce::jmin(prepared_block_size, start_sample + num_samples - offset);
+
+            if (in_place_mid_side)
+                encodeMidSide(channels[0] + offset, channels[1] + offset, chunk);
+
+            if (worker_pool != nullptr && num_groups > 1)
+            {
+                pending = { channels, num_channels, offset, chunk };
+                worker_pool->run(num_groups, &processGroupJob, this);
+            }
+            else
+            {
+                for (int group = 0; group < num_groups; ++group)
+                    processGroup(group, channels, num_channels, offset, chunk);
+            }
+
+            if (in_place_mid_side)
+                decodeMidSide(channels[0] + offset, channels[1] + offset, chunk);
+        }
+    }
+
+private:
+    SampleType* getSectionStateData(int section, int channel) const noexcept
+    {
+        jassert(section >= 0 && section < max_sections && channel >= 0 && channel < prepared_channels);
+        
+        const auto width = kernel_set_ptr->width;
+        return state.getData() + (channel / width) * state_stride + section * 2 * width + channel % width;
+    }
+    
+    struct PendingBlock
+    {
+        SampleType* const* channels;
+        int num_channels, offset, num_samples;
+    };
+
+    static void processGroupJob(void* context, int group) noexcept
+    {
+        auto& cascade = *static_cast<BiquadCascade*>(context);
+        const auto& block = cascade.pending;
+        cascade.processGroup(group, block.channels, block.num_channels, block.offset, block.num_samples);
+    }
+
+    void processGroup(int group, SampleType* const* channels, int num_channels, int offset, int num_samples) noexcept
+    {
+        const auto width = kernel_set_ptr->width;
+        const auto kernel = kernel_set_ptr->kernels[(size_t) num_active];
+        const auto first_channel = group * width;
+        const auto lanes = juce::jmin(width, num_channels - first_channel);
+
+        if (lanes <= 0)
+            return;
+
+        auto* group_state = state.getData() + group * state_stride;
+
+        // One lane is just the channel itself, no need to interleave
+        if (width == 1)
+        {
+            if (split_sides && first_channel < 2)
+            {
+                const auto side = (size_t) first_channel;
+                kernel_set_ptr->kernels[(size_t) side_num_active[side]](channels[first_channel] + offset, num_samples, coefficients.data(),
+                                                                        group_state, side_active[side].data());
+                return;
+            }
+
+            kernel(channels[first_channel] + offset, num_samples, coefficients.data(), group_state, active.data());
+            return;
+        }
+
+        auto* group_scratch = scratch.getData() + group * prepared_block_size * width;
+
+        // Only the first group holds the pair
+        const auto pair_mid_side = mid_side && group == 0 && lanes >= 2;
+
+        interleave(group_scratch, channels + first_channel, lanes, width, offset, num_samples, pair_mid_side);
+
+        if (split_sides && group == 0)
+            kernel_set_ptr->lane_kernels[(size_t) num_active](group_scratch, num_samples, lane_coefficients.getData(), group_state, active.data());
+        else
+            kernel(group_scratch, num_samples, coefficients.data(), group_state, active.data());
+
+        deinterleave(group_scratch, channels + first_channel, lanes, width, offset, num_samples, pair_mid_side);
+    }
+
+    static void interleave(SampleType* destination, const SampleType* const* channels, int lanes, int width, int offset, int num_samples,
+                           bool mid_side_pair) noexcept
+    {
+        const SampleType half (0.5);
+
+        for (int n = 0; n < num_samples; ++n, destination += width)
+        {
+            int lane = 0;
+
+            if (mid_side_pair)
+            {
+                const auto left = channels[0][offset + n], right = channels[1][offset + n];
+                destination[0] = half * (left + right);
+                destination[1] = half * (left - right);
+                lane = 2;
+            }
+
+            for (; lane < lanes; ++lane)
+                destination[lane] = channels[lane][offset + n];
+
+            // Unused lanes still run, keep them at zero
+            for (; lane < width; ++lane)
+                destination[lane] = SampleType();
+        }
+    }
+
+    static void deinterleave(const SampleType* source, SampleType* const* channels, int lanes, int width, int offset, int num_samples,
+                             bool mid_side_pair) noexcept
+    {
+        for (int n = 0; n < num_samples; ++n, source += width)
+        {
+            int lane = 0;
+
+            if (mid_side_pair)
+            {
+                channels[0][offset + n] = source[0] + source[1];
+                channels[1][offset + n] = source[0] - source[1];
+                lane = 2;
+            }
+
+            for (; lane < lanes; ++lane)
+                channels[lane][offset + n] = source[lane];
+        }
+    }
+
+    static void encodeMidSide(SampleType* left, SampleType* right, int num_samples) noexcept
+    {
+        const SampleType half (0.5);
+
+        for (int n = 0; n < num_samples; ++n)
+        {
+            const auto l = left[n], r = right[n];
+            left[n] = half * (l + r);
+            right[n] = half * (l - r);
+        }
+    }
+
+    static void decodeMidSide(SampleType* mid, SampleType* side, int num_samples) noexcept
+    {
+        for (int n = 0; n < num_samples; ++n)
+        {
+            const auto m = mid[n], s = side[n];
+            mid[n] = m + s;
+            side[n] = m - s;
+        }
+    }
+    
+    // Works out the per channel section lists, and whether the pair needs them at all
+    void updateSides() noexcept
+    {
+        // Both sides skipping a section still leaves the other channels running it
+        split_sides = (active_mask & ~(side_masks[0] & side_masks[1])) != 0;
+        lane_coefficients_dirty = true;
+        
+        for (size_t side = 0; side < 2; ++side)
+        {
+            side_num_active[side] = 0;
+            
+            for (int i = 0; i < num_active; ++i)
+                if (side_masks[side] & (1u << active[(size_t) i]))
+                    side_active[side][(size_t) side_num_active[side]++] = active[(size_t) i];
+        }
+    }
+    
+    // Lane coefficients for the first group, a lane skipping a section passes it straight through
+    void updateLaneCoefficients() noexcept
+    {
+        const auto width = kernel_set_ptr->width;
+        const BiquadCoefficients<SampleType> pass_through { SampleType(1), SampleType(), SampleType(), SampleType(), SampleType() };
+        
+        for (int i = 0; i < num_active; ++i)
+        {
+            const auto section = active[(size_t) i];
+            auto* c = lane_coefficients.getData() + section * num_lane_coefficients * width;
+            
+            for (int lane = 0; lane < width; ++lane)
+            {
+                const auto runs = lane >= 2 || (side_masks[(size_t) lane] & (1u << section)) != 0;
+                const auto& s = runs ? coefficients[(size_t) section] : pass_through;
+                c[lane] = s.b0;
+                c[width + lane] = s.b1;
+                c[2 * width + lane] = s.b2;
+                c[3 * width + lane] = s.a1;
+                c[4 * width + lane] = s.a2;
+            }
+        }
+        
+        lane_coefficients_dirty = false;
+    }
+
+    std::array<BiquadCoefficients<SampleType>, max_sections> coefficients {};
+    std::array<int, max_sections> active {};
+    juce::uint32 active_mask { 0 };
+    int num_active { 0 };
+
+    // Stereo pair, see setSides
+    std::array<juce::uint32, 2> side_masks { ~0u, ~0u };
+    std::array<std::array<int, max_sections>, 2> side_active {};
+    std::array<int, 2> side_num_active {};
+    AlignedBuffer<SampleType> lane_coefficients;
+    bool split_sides { false }, mid_side { false }, lane_coefficients_dirty { true };
+
+    const CascadeKernelSet<SampleType>* kernel_set_ptr = nullptr;
+    AlignedBuffer<SampleType> state, scratch;
+    ChannelWorkerPool* worker_pool = nullptr;
+    PendingBlock pending {};
+    int prepared_channels { 0 }, prepared_block_size { 0 }, num_groups { 0 }, state_stride { 0 };
+};
@@ -0,0 +1,112 @@
+/*
+  ==============================================================================
+
+    BiquadCascadeKernel.h
+
+    The cascade kernel itself. Only the kernel translation units include
+    this, each one instantiating it for the vector type it was compiled for
+    (see BiquadCascadeKernelsAVX.cpp for why that matters).
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include "BiquadCascade.h"
+
+// N is known at compile time so the section loop unrolls and the
+// coefficients and state stay in registers for the whole block. The two
+// kernels below only differ in how load_section fills the coefficients.
+template <typename VectorType, int N, typename LoadSection>
+void runCascade(typename LaneTraits<VectorType>::SampleType* interleaved, int num_samples,
+                typename LaneTraits<VectorType>::SampleType* state, const int* active_sections,
+                LoadSection&& load_section)
+{
+    using Lanes = LaneTraits<VectorType>;
+    constexpr int width = Lanes::width;
+
+    if constexpr (N == 0)
+    {
+        juce::ignoreUnused(interleaved, num_samples, state, active_sections, load_section);
+    }
+    else
+    {
+        VectorType b0[N], b1[N], b2[N], a1[N], a2[N], s1[N], s2[N];
+
+        for (int i = 0; i < N; ++i)
+        {
+            load_section(active_sections[i], b0[i], b1[i], b2[i], a1[i], a2[i]);
+            s1[i] = Lanes::load(state + (active_sections[i] * 2) * width);
+            s2[i] = Lanes::load(state + (active_sections[i] * 2 + 1) * width);
+        }
+
+        for (int n = 0; n < num_samples; ++n)
+        {
+            auto x = Lanes::load(interleaved + n * width);
+
+            for (int i = 0; i < N; ++i)
+            {
+                const auto y = b0[i] * x + s1[i];
+                s1[i] = b1[i] * x - a1[i] * y + s2[i];
+                s2[i] = b2[i] * x - a2[i] * y;
+                x = y;
+            }
+
+            Lanes::store(interleaved + n * width, x);
+        }
+
+        for (int i = 0; i < N; ++i)
+        {
+            Lanes::store(state + (active_sections[i] * 2) * width, s1[i]);
+            Lanes::store(state + (active_sections[i] * 2 + 1) * width, s2[i]);
+        }
+    }
+}
+
+template <typename VectorType, int N>
+void processCascade(typename LaneTraits<VectorType>::SampleType* interleaved, int num_samples,
+                    const BiquadCoefficients<typename LaneTraits<VectorType>::SampleType>* coefficients,
+                    typename LaneTraits<VectorType>::SampleType* state, const int* active_sections)
+{
+    using Lanes = LaneTraits<VectorType>;
+
+    runCascade<VectorType, N>(interleaved, num_samples, state, active_sections,
+                              [coefficients](int section, VectorType& b0, VectorType& b1, VectorType& b2, VectorType& a1, VectorType& a2)
+    {
+        const auto& c = coefficients[section];
+        b0 = Lanes::broadcast(c.b0);
+        b1 = Lanes::broadcast(c.b1);
+        b2 = Lanes::broadcast(c.b2);
+        a1 = Lanes::broadcast(c.a1);
+        a2 = Lanes::broadcast(c.a2);
+    });
+}
+
+template <typename VectorType, int N>
+void processLaneCascade(typename LaneTraits<VectorType>::SampleType* interleaved, int num_samples,
+                        const typename LaneTraits<VectorType>::SampleType* lane_coefficients,
+                        typename LaneTraits<VectorType>::SampleType* state, const int* active_sections)
+{
+    using Lanes = LaneTraits<VectorType>;
+    constexpr int width = Lanes::width;
+
+    runCascade<VectorType, N>(interleaved, num_samples, state, active_sections,
+                              [lane_coefficients](int section, VectorType& b0, VectorType& b1, VectorType& b2, VectorType& a1, VectorType& a2)
+    {
+        const auto* c = lane_coefficients + section * num_lane_coefficients * width;
+        b0 = Lanes::load(c);
+        b1 = Lanes::load(c + width);
+        b2 = Lanes::load(c + 2 * width);
+        a1 = Lanes::load(c + 3 * width);
+        a2 = Lanes::load(c + 4 * width);
+    });
+}
+
+template <typename VectorType, size_t... N>
+CascadeKernelSet<typename LaneTraits<VectorType>::SampleType> makeCascadeKernelSet(const char* name, std::index_sequence<N...>)
+{
+    return { name, LaneTraits<VectorType>::width,
+             { &processCascade<VectorType, (int) N>... },
+             { &processLaneCascade<VectorType, (int) N>... } };
+}
+
@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    BiquadCascadeKernels.cpp
+
+    Scalar and baseline SIMD cascade kernels, plus the runtime dispatch.
+    juce::dsp::SIMDRegister maps onto SSE on Intel and NEON on ARM.
+
+  ==============================================================================
+*/
+
+#include "BiquadCascadeKernel.h"
+
+namespace
+{
+    constexpr auto kernel_indices = std::make_index_sequence<max_cascade_sections + 1>();
+}
+
+template <typename SampleType>
+const CascadeKernelSet<SampleType>& getScalarCascadeKernels()
+{
+    static const auto kernel_set = makeCascadeKernelSet<SampleType>("scalar", kernel_indices);
+    return kernel_set;
+}
+
+template <typename SampleType>
+const CascadeKernelSet<SampleType>* getSIMDRegisterCascadeKernels()
+{
+   #if JUCE_USE_SIMD
+   #if JUCE_ARM
+    static const auto kernel_set = makeCascadeKernelSet<juce::dsp::SIMDRegister<SampleType>>("neon", kernel_indices);
+   #else
+    static const auto kernel_set = makeCascadeKernelSet<juce::dsp::SIMDRegister<SampleType>>("sse", kernel_indices);
+   #endif
+    return &kernel_set;
+   #else
+    return nullptr;
+   #endif
+}
+
+template <typename SampleType>
+const CascadeKernelSet<SampleType>& getBestCascadeKernels()
+{
+    // The AVX translation unit must not run at all on older CPUs, so check first
+    if (juce::SystemStats::hasAVX())
+        if (auto* avx = getAVXCascadeKernels<SampleType>())
+            return *avx;
+
+    if (auto* simd = getSIMDRegisterCascadeKernels<SampleType>())
+        return *simd;
+
+    return getScalarCascadeKernels<SampleType>();
+}
+
+template const CascadeKernelSet<float>& getScalarCascadeKernels<float>();
+template const CascadeKernelSet<double>& getScalarCascadeKernels<double>();
+template const CascadeKernelSet<float>* getSIMDRegisterCascadeKernels<float>();
+template const CascadeKernelSet<double>* getSIMDRegisterCascadeKernels<double>();
+template const CascadeKernelSet<float>& getBestCascadeKernels<float>();
+template const CascadeKernelSet<double>& getBestCascadeKernels<double>();
@@ -0,0 +1,113 @@
+/*
+  ==============================================================================
+
+    BiquadCascadeKernelsAVX.cpp
+
+    AVX cascade kernels, eight float or four double channels per register. The rest of the plugin
+    is built for the baseline instruction set, so only the code below the
+    target pragma may use AVX; the kernel header is deliberately included
+    after it, and the kernel is only instantiated here for the AVX lane types, so no
+    AVX code can leak into functions shared with other translation units.
+    getBestCascadeKernels() only picks these when the CPU reports AVX.
+
+  ==============================================================================
+*/
+
+#include "BiquadCascade.h"
+
+#if JUCE_INTEL && (JUCE_GCC || JUCE_CLANG || JUCE_MSVC)
+ #define PARAMETRIC_EQ_AVX_KERNELS 1
+#else
+ #define PARAMETRIC_EQ_AVX_KERNELS 0
+#endif
+
+#if PARAMETRIC_EQ_AVX_KERNELS
+
+#if JUCE_CLANG
+ #pragma clang attribute push (__attribute__ ((target ("avx"))), apply_to = function)
+#elif JUCE_GCC
+ #pragma GCC push_options
+ #pragma GCC target ("avx")
+#endif
+
+#include <immintrin.h>
+#include "BiquadCascadeKernel.h"
+
+namespace
+{
+    struct AVXLanes
+    {
+        __m256 value;
+    };
+
+    inline AVXLanes operator+ (AVXLanes a, AVXLanes b) noexcept { return { _mm256_add_ps(a.value, b.value) }; }
+    inline AVXLanes operator- (AVXLanes a, AVXLanes b) noexcept { return { _mm256_sub_ps(a.value, b.value) }; }
+    inline AVXLanes operator* (AVXLanes a, AVXLanes b) noexcept { return { _mm256_mul_ps(a.value, b.value) }; }
+
+    struct AVXDoubleLanes
+    {
+        __m256d value;
+    };
+
+    inline AVXDoubleLanes operator+ (AVXDoubleLanes a, AVXDoubleLanes b) noexcept { return { _mm256_add_pd(a.value, b.value) }; }
+    inline AVXDoubleLanes operator- (AVXDoubleLanes a, AVXDoubleLanes b) noexcept { return { _mm256_sub_pd(a.value, b.value) }; }
+    inline AVXDoubleLanes operator* (AVXDoubleLanes a, AVXDoubleLanes b) noexcept { return { _mm256_mul_pd(a.value, b.value) }; }
+}
+
+template <>
+struct LaneTraits<AVXLanes>
+{
+    using SampleType = float;
+
+    static constexpr int width = 8;
+    static AVXLanes load(const float* source) noexcept          { return { _mm256_load_ps(source) }; }
+    static void store(float* destination, AVXLanes v) noexcept  { _mm256_store_ps(destination, v.value); }
+    static AVXLanes broadcast(float v) noexcept                 { return { _mm256_set1_ps(v) }; }
+};
+
+template <>
+struct LaneTraits<AVXDoubleLanes>
+{
+    using SampleType = double;
+
+    static constexpr int width = 4;
+    static AVXDoubleLanes load(const double* source) noexcept          { return { _mm256_load_pd(source) }; }
+    static void store(double* destination, AVXDoubleLanes v) noexcept  { _mm256_store_pd(destination, v.value); }
+    static AVXDoubleLanes broadcast(double v) noexcept                 { return { _mm256_set1_pd(v) }; }
+};
+
+template <>
+const CascadeKernelSet<float>* getAVXCascadeKernels<float>()
+{
+    static const auto kernel_set = makeCascadeKernelSet<AVXLanes>("avx", std::make_index_sequence<max_cascade_sections + 1>());
+    return &kernel_set;
+}
+
+template <>
+const CascadeKernelSet<double>* getAVXCascadeKernels<double>()
+{
+    static const auto kernel_set = makeCascadeKernelSet<AVXDoubleLanes>("avx", std::make_index_sequence<max_cascade_sections + 1>());
+    return &kernel_set;
+}
+
+#if JUCE_CLANG
+ #pragma clang attribute pop
+#elif JUCE_GCC
+ #pragma GCC pop_options
+#endif
+
+#else
+
+template <>
+const CascadeKernelSet<float>* getAVXCascadeKernels<float>()
+{
+    return nullptr;
+}
+
+template <>
+const CascadeKernelSet<double>* getAVXCascadeKernels<double>()
+{
+    return nullptr;
+}
+
+#endif
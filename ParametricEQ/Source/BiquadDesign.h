@@ -0,0 +1,436 @@
+/*
+  ==============================================================================
+
+    BiquadDesign.h
+
+    Allocation free RBJ peak, shelf and notch designs and Butterworth cuts.
+    Results are written straight into plain coefficient structs, so every
+    designer here is safe to call from the audio thread. The responses
+    match juce::dsp::IIR::Coefficients::makePeakFilter / makeLowShelf /
+    makeHighShelf / makeNotch and
+    juce::dsp::FilterDesign::design*HighOrderButterworthMethod.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Second order section, juce order with a0 normalised to 1
+template <typename SampleType>
+struct BiquadCoefficients
+{
+    SampleType b0 { 1 }, b1 { 0 }, b2 { 0 }, a1 { 0 }, a2 { 0 };
+};
+
+// Rounds (or widens) a designed section to the sample type a cascade runs in
+template <typename TargetType, typename SourceType>
+BiquadCoefficients<TargetType> convertCoefficients(const BiquadCoefficients<SourceType>& c) noexcept
+{
+    return { static_cast<TargetType>(c.b0), static_cast<TargetType>(c.b1), static_cast<TargetType>(c.b2),
+             static_cast<TargetType>(c.a1), static_cast<TargetType>(c.a2) };
+}
+
+// |c0 + c1 z^-1 + c2 z^-2|^2 on the unit circle as a polynomial in
+// phi = 4 sin^2(w / 2). Unlike the cos(w) form it doesn't cancel near DC.
+struct PowerResponseTerms
+{
+    double constant, linear, quadratic;
+    
+    double evaluate(double phi) const noexcept { return constant + phi * (linear + phi * quadratic); }
+};
+
+inline PowerResponseTerms getPowerResponseTerms(double c0, double c1, double c2) noexcept
+{
+    const auto sum = c0 + c1 + c2;
+    return { sum * sum, -(c0 * c1 + c1 * c2 + 4.0 * c0 * c2), c0 * c2 };
+}
+
+// Highest cut slope is 48 dB/Oct, i.e. four second order sections
+static constexpr int max_cut_sections = 4;
+
+template <typename SampleType>
+using CutCoefficients = std::array<BiquadCoefficients<SampleType>, max_cut_sections>;
+
+namespace ButterworthDetail
+{
+    // std::cos isn't constexpr, the angles we need are all in (0, pi/2)
+    constexpr double cosine(double x)
+    {
+        double term = 1.0, sum = 1.0;
+
+        for (int n = 1; n < 24; ++n)
+        {
+            term *= -x * x / ((2 * n - 1) * (2 * n));
+            sum += term;
+        }
+
+        return sum;
+    }
+
+    struct QTable
+    {
+        double q[max_cut_sections][max_cut_sections] {};
+    };
+
+    // Section i of an order N Butterworth filter has Q = 1 / (2 cos((2i + 1) pi / 2N))
+    constexpr QTable makeQTable()
+    {
+        QTable table;
+
+        for (int slope = 0; slope < max_cut_sections; ++slope)
+        {
+            const int order = 2 * (slope + 1);
+
+            for (int i = 0; i <= slope; ++i)
+                table.q[slope][i] = 1.0 / (2.0 * cosine((2.0 * i + 1.0) * juce::MathConstants<double>::pi / (order * 2.0)));
+        }
+
+        return table;
+    }
+
+    static constexpr QTable q_table = makeQTable();
+
+    static_assert(q_table.q[0][0] > 0.7071 && q_table.q[0][0] < 0.7072, "Second order Butterworth Q should be 1/sqrt(2)");
+}
+
+// Number of sections used by a Slope choice
+constexpr int getNumCutSections(int slope) noexcept
+{
+    return slope + 1;
+}
+
+// Butterworth section Q for a Slope choice, computed at compile time
+constexpr double getButterworthQ(int slope, int section) noexcept
+{
+    return ButterworthDetail::q_table.q[slope][section];
+}
+
+template <typename SampleType>
+void makePeakCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q, double gain_db) noexcept
+{
+    jassert(sample_rate > 0 && freq > 0 && freq <= sample_rate * 0.5 && q > 0);
+
+    const auto a = std::pow(10.0, gain_db / 40.0);
+    const auto omega = juce::MathConstants<double>::twoPi * freq / sample_rate;
+    const auto alpha = std::sin(omega) / (q * 2.0);
+    const auto c2 = -2.0 * std::cos(omega);
+    const auto alpha_times_a = alpha * a;
+    const auto alpha_over_a = alpha / a;
+    const auto inv_a0 = 1.0 / (1.0 + alpha_over_a);
+
+    c.b0 = static_cast<SampleType>((1.0 + alpha_times_a) * inv_a0);
+    c.b1 = static_cast<SampleType>(c2 * inv_a0);
+    c.b2 = static_cast<SampleType>((1.0 - alpha_times_a) * inv_a0);
+    c.a1 = static_cast<SampleType>(c2 * inv_a0);
+    c.a2 = static_cast<SampleType>((1.0 - alpha_over_a) * inv_a0);
+}
+
+// Shared by the shelves, sign is +1 for a high shelf and -1 for a low one
+template <typename SampleType>
+void makeShelfCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q, double gain_db, double sign) noexcept
+{
+    jassert(sample_rate > 0 && freq > 0 && freq <= sample_rate * 0.5 && q > 0);
+
+    const auto a = std::pow(10.0, gain_db / 40.0);
+    const auto omega = juce::MathConstants<double>::twoPi * freq / sample_rate;
+    const auto cos_omega = std::cos(omega) * sign;
+    const auto beta = std::sin(omega) * std::sqrt(a) / q;
+    const auto a_plus_1 = a + 1.0, a_minus_1 = a - 1.0;
+    const auto inv_a0 = 1.0 / (a_plus_1 - a_minus_1 * cos_omega + beta);
+
+    c.b0 = static_cast<SampleType>(a * (a_plus_1 + a_minus_1 * cos_omega + beta) * inv_a0);
+    c.b1 = static_cast<SampleType>(a * -2.0 * sign * (a_minus_1 + a_plus_1 * cos_omega) * inv_a0);
+    c.b2 = static_cast<SampleType>(a * (a_plus_1 + a_minus_1 * cos_omega - beta) * inv_a0);
+    c.a1 = static_cast<SampleType>(2.0 * sign * (a_minus_1 - a_plus_1 * cos_omega) * inv_a0);
+    c.a2 = static_cast<SampleType>((a_plus_1 - a_minus_1 * cos_omega - beta) * inv_a0);
+}
+
+template <typename SampleType>
+void makeLowShelfCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q, double gain_db) noexcept
+{
+    makeShelfCoefficients(c, sample_rate, freq, q, gain_db, -1.0);
+}
+
+template <typename SampleType>
+void makeHighShelfCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q, double gain_db) noexcept
+{
+    makeShelfCoefficients(c, sample_rate, freq, q, gain_db, 1.0);
+}
+
+template <typename SampleType>
+void makeNotchCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q) noexcept
+{
+    jassert(sample_rate > 0 && freq > 0 && freq <= sample_rate * 0.5 && q > 0);
+
+    const auto omega = juce::MathConstants<double>::twoPi * freq / sample_rate;
+    const auto alpha = std::sin(omega) / (q * 2.0);
+    const auto c2 = -2.0 * std::cos(omega);
+    const auto inv_a0 = 1.0 / (1.0 + alpha);
+
+    c.b0 = static_cast<SampleType>(inv_a0);
+    c.b1 = static_cast<SampleType>(c2 * inv_a0);
+    c.b2 = static_cast<SampleType>(inv_a0);
+    c.a1 = static_cast<SampleType>(c2 * inv_a0);
+    c.a2 = static_cast<SampleType>((1.0 - alpha) * inv_a0);
+}
+
+// A high shelf turned down by half its gain: -gain_db / 2 at DC, +gain_db / 2
+// at Nyquist, pivoting around freq
+template <typename SampleType>
+void makeTiltCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q, double gain_db) noexcept
+{
+    BiquadCoefficients<double> shelf;
+    makeHighShelfCoefficients(shelf, sample_rate, freq, q, gain_db);
+
+    const auto trim = std::pow(10.0, -gain_db / 40.0);
+    c.b0 = static_cast<SampleType>(shelf.b0 * trim);
+    c.b1 = static_cast<SampleType>(shelf.b1 * trim);
+    c.b2 = static_cast<SampleType>(shelf.b2 * trim);
+    c.a1 = static_cast<SampleType>(shelf.a1);
+    c.a2 = static_cast<SampleType>(shelf.a2);
+}
+
+// How an analog prototype becomes a biquad. The bilinear transform squeezes
+// the whole analog axis in below Nyquist, so peaks and cuts close to
+// Nyquist come out narrower and steeper than designed ("cramping"); the
+// usual fix is oversampling the whole chain. Matched designs instead take
+// the analog poles as they are (z = e^s) and solve for the zeros that match
+// the analog magnitude at DC and at the centre frequency, after M. Vicanek,
+// "Matched Second Order Digital Filters" (2016). That keeps high bands close
+// to their analog shape at the base rate, for the same cost per sample.
+// Only peaks and cuts have a matched design, other shapes stay bilinear.
+enum DesignMethod
+{
+    Design_Bilinear,
+    Design_Matched
+};
+
+namespace MatchedDetail
+{
+    // The analog denominator s^2 + s / q + 1 at w0 (radians per sample), poles mapped by z = e^s
+    inline void getPoles(double w0, double q, double& a1, double& a2) noexcept
+    {
+        const auto zeta = 0.5 / q;
+        const auto decay = std::exp(-zeta * w0);
+
+        a1 = zeta <= 1.0 ? -2.0 * decay * std::cos(std::sqrt(1.0 - zeta * zeta) * w0)
+                         : -2.0 * decay * std::cosh(std::sqrt(zeta * zeta - 1.0) * w0);
+        a2 = decay * decay;
+    }
+
+    // |c0 + c1 z^-1 + c2 z^-2|^2 = C0 phi0 + C1 phi1 + C2 phi2 at w, with phi1 = sin^2(w / 2),
+    // phi0 = 1 - phi1 and phi2 = 4 phi0 phi1. These hold C0, C1, C2 for the denominator.
+    struct PowerTerms
+    {
+        double c0, c1, c2;
+
+        PowerTerms(double a1, double a2) noexcept
+            : c0((1.0 + a1 + a2) * (1.0 + a1 + a2)), c1((1.0 - a1 + a2) * (1.0 - a1 + a2)), c2(-4.0 * a2) {}
+    };
+
+    struct Phi
+    {
+        double phi0, phi1, phi2;
+
+        explicit Phi(double w) noexcept
+        {
+            const auto s = std::sin(w * 0.5);
+            phi1 = s * s;
+            phi0 = 1.0 - phi1;
+            phi2 = 4.0 * phi0 * phi1;
+        }
+    };
+}
+
+// Matched counterpart of makePeakCoefficients, with the same bandwidth for the same q
+template <typename SampleType>
+void makeMatchedPeakCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q, double gain_db) noexcept
+{
+    jassert(sample_rate > 0 && freq > 0 && freq <= sample_rate * 0.5 && q > 0);
+
+    // RBJ's peak is (s^2 + s a / q + 1) / (s^2 + s / (a q) + 1), i.e. poles at q a
+    const auto gain = std::pow(10.0, gain_db / 20.0);
+    const auto w0 = juce::MathConstants<double>::twoPi * freq / sample_rate;
+    double a1, a2;
+    MatchedDetail::getPoles(w0, q * std::sqrt(gain), a1, a2);
+
+    // Unity at DC, the full gain at w0 and a flat top there
+    const MatchedDetail::PowerTerms den(a1, a2);
+    const MatchedDetail::Phi phi(w0);
+    const auto g2 = gain * gain;
+    const auto r1 = (den.c0 * phi.phi0 + den.c1 * phi.phi1 + den.c2 * phi.phi2) * g2;
+    const auto r2 = (den.c1 - den.c0 + 4.0 * (phi.phi0 - phi.phi1) * den.c2) * g2;
+
+    const auto n0 = den.c0;
+    const auto n2 = (r1 - r2 * phi.phi1 - n0) / (4.0 * phi.phi1 * phi.phi1);
+    const auto n1 = juce::jmax(0.0, r2 + n0 + 4.0 * (phi.phi1 - phi.phi0) * n2);
+
+    const auto sqrt_n0 = std::sqrt(n0), sqrt_n1 = std::sqrt(n1);
+    const auto w = 0.5 * (sqrt_n0 + sqrt_n1);
+    const auto b0 = 0.5 * (w + std::sqrt(juce::jmax(0.0, w * w + n2)));
+
+    c.b0 = static_cast<SampleType>(b0);
+    c.b1 = static_cast<SampleType>(0.5 * (sqrt_n0 - sqrt_n1));
+    c.b2 = static_cast<SampleType>(-n2 / (4.0 * b0));
+    c.a1 = static_cast<SampleType>(a1);
+    c.a2 = static_cast<SampleType>(a2);
+}
+
+// Shape of a parametric band
+enum BandType
+{
+    Band_Peak,
+    Band_LowShelf,
+    Band_HighShelf,
+    Band_Notch,
+    Band_Tilt
+};
+
+static constexpr int num_band_types = Band_Tilt + 1;
+
+// Any BandType, a notch ignores gain_db
+template <typename SampleType>
+void makeBandCoefficients(BiquadCoefficients<SampleType>& c, int type, double sample_rate, double freq, double q, double gain_db,
+                          int method = Design_Bilinear) noexcept
+{
+    if (method == Design_Matched && type == Band_Peak)
+    {
+        makeMatchedPeakCoefficients(c, sample_rate, freq, q, gain_db);
+        return;
+    }
+
+    switch (type)
+    {
+        case Band_LowShelf:  makeLowShelfCoefficients(c, sample_rate, freq, q, gain_db);  break;
+        case Band_HighShelf: makeHighShelfCoefficients(c, sample_rate, freq, q, gain_db); break;
+        case Band_Notch:     makeNotchCoefficients(c, sample_rate, freq, q);               break;
+        case Band_Tilt:      makeTiltCoefficients(c, sample_rate, freq, q, gain_db);      break;
+        default:             makePeakCoefficients(c, sample_rate, freq, q, gain_db);      break;
+    }
+}
+
+template <typename SampleType>
+void makeLowPassCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q) noexcept
+{
+    jassert(sample_rate > 0 && freq > 0 && freq <= sample_rate * 0.5 && q > 0);
+
+    const auto n = 1.0 / std::tan(juce::MathConstants<double>::pi * freq / sample_rate);
+    const auto n_squared = n * n;
+    const auto inv_q = 1.0 / q;
+    const auto c1 = 1.0 / (1.0 + inv_q * n + n_squared);
+
+    c.b0 = static_cast<SampleType>(c1);
+    c.b1 = static_cast<SampleType>(c1 * 2.0);
+    c.b2 = static_cast<SampleType>(c1);
+    c.a1 = static_cast<SampleType>(c1 * 2.0 * (1.0 - n_squared));
+    c.a2 = static_cast<SampleType>(c1 * (1.0 - inv_q * n + n_squared));
+}
+
+template <typename SampleType>
+void makeHighPassCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q) noexcept
+{
+    jassert(sample_rate > 0 && freq > 0 && freq <= sample_rate * 0.5 && q > 0);
+
+    const auto n = std::tan(juce::MathConstants<double>::pi * freq / sample_rate);
+    const auto n_squared = n * n;
+    const auto inv_q = 1.0 / q;
+    const auto c1 = 1.0 / (1.0 + inv_q * n + n_squared);
+
+    c.b0 = static_cast<SampleType>(c1);
+    c.b1 = static_cast<SampleType>(c1 * -2.0);
+    c.b2 = static_cast<SampleType>(c1);
+    c.a1 = static_cast<SampleType>(c1 * 2.0 * (n_squared - 1.0));
+    c.a2 = static_cast<SampleType>(c1 * (1.0 - inv_q * n + n_squared));
+}
+
+// Band pass with 0 dB at freq, for detectors rather than the chain
+template <typename SampleType>
+void makeBandPassCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q) noexcept
+{
+    jassert(sample_rate > 0 && freq > 0 && freq <= sample_rate * 0.5 && q > 0);
+
+    const auto omega = juce::MathConstants<double>::twoPi * freq / sample_rate;
+    const auto alpha = std::sin(omega) / (q * 2.0);
+    const auto inv_a0 = 1.0 / (1.0 + alpha);
+
+    c.b0 = static_cast<SampleType>(alpha * inv_a0);
+    c.b1 = static_cast<SampleType>(0.0);
+    c.b2 = static_cast<SampleType>(-alpha * inv_a0);
+    c.a1 = static_cast<SampleType>(-2.0 * std::cos(omega) * inv_a0);
+    c.a2 = static_cast<SampleType>((1.0 - alpha) * inv_a0);
+}
+
+// Matched low pass: unity at DC and q at freq, b2 = 0
+template <typename SampleType>
+void makeMatchedLowPassCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q) noexcept
+{
+    jassert(sample_rate > 0 && freq > 0 && freq <= sample_rate * 0.5 && q > 0);
+
+    const auto w0 = juce::MathConstants<double>::twoPi * freq / sample_rate;
+    double a1, a2;
+    MatchedDetail::getPoles(w0, q, a1, a2);
+
+    const MatchedDetail::PowerTerms den(a1, a2);
+    const MatchedDetail::Phi phi(w0);
+    const auto r1 = (den.c0 * phi.phi0 + den.c1 * phi.phi1 + den.c2 * phi.phi2) * q * q;
+    const auto sqrt_n0 = std::sqrt(den.c0);
+    const auto sqrt_n1 = std::sqrt(juce::jmax(0.0, (r1 - den.c0 * phi.phi0) / phi.phi1));
+    const auto b0 = 0.5 * (sqrt_n0 + sqrt_n1);
+
+    c.b0 = static_cast<SampleType>(b0);
+    c.b1 = static_cast<SampleType>(sqrt_n0 - b0);
+    c.b2 = static_cast<SampleType>(0.0);
+    c.a1 = static_cast<SampleType>(a1);
+    c.a2 = static_cast<SampleType>(a2);
+}
+
+// Matched high pass: b0 (1 - z^-1)^2 with q at freq
+template <typename SampleType>
+void makeMatchedHighPassCoefficients(BiquadCoefficients<SampleType>& c, double sample_rate, double freq, double q) noexcept
+{
+    jassert(sample_rate > 0 && freq > 0 && freq <= sample_rate * 0.5 && q > 0);
+
+    const auto w0 = juce::MathConstants<double>::twoPi * freq / sample_rate;
+    double a1, a2;
+    MatchedDetail::getPoles(w0, q, a1, a2);
+
+    const MatchedDetail::PowerTerms den(a1, a2);
+    const MatchedDetail::Phi phi(w0);
+    const auto b0 = q * std::sqrt(den.c0 * phi.phi0 + den.c1 * phi.phi1 + den.c2 * phi.phi2) / (4.0 * phi.phi1);
+
+    c.b0 = static_cast<SampleType>(b0);
+    c.b1 = static_cast<SampleType>(-2.0 * b0);
+    c.b2 = static_cast<SampleType>(b0);
+    c.a1 = static_cast<SampleType>(a1);
+    c.a2 = static_cast<SampleType>(a2);
+}
+
+// Butterworth high pass cascade, fills the first getNumCutSections(slope) entries
+template <typename SampleType>
+void makeLowCutCoefficients(CutCoefficients<SampleType>& sections, double sample_rate, double freq, int slope,
+                            int method = Design_Bilinear) noexcept
+{
+    for (int i = 0; i < getNumCutSections(slope); ++i)
+    {
+        if (method == Design_Matched)
+            makeMatchedHighPassCoefficients(sections[(size_t) i], sample_rate, freq, getButterworthQ(slope, i));
+        else
+            makeHighPassCoefficients(sections[(size_t) i], sample_rate, freq, getButterworthQ(slope, i));
+    }
+}
+
+// Butterworth low pass cascade, fills the first getNumCutSections(slope) entries
+template <typename SampleType>
+void makeHighCutCoefficients(CutCoefficients<SampleType>& sections, double sample_rate, double freq, int slope,
+                             int method = Design_Bilinear) noexcept
+{
+    for (int i = 0; i < getNumCutSections(slope); ++i)
+    {
+        if (method == Design_Matched)
+            makeMatchedLowPassCoefficients(sections[(size_t) i], sample_rate, freq, getButterworthQ(slope, i));
+        else
+            makeLowPassCoefficients(sections[(size_t) i], sample_rate, freq, getButterworthQ(slope, i));
+    }
+}
@@ -0,0 +1,214 @@
+/*
+  ==============================================================================
+
+    ChainSmoother.cpp
+
+  ==============================================================================
+*/
+
+#include "ChainSmoother.h"
+
+void ChainSmoother::reset(double new_sample_rate, const ChainSettings& chain_settings, ChainCoefficients& coefficients) noexcept
+{
+    sample_rate = new_sample_rate;
+    resetSmoothers();
+    jumpTo(chain_settings);
+    
+    gain_offset_db.fill(0.f);
+    offset_bands = 0;
+    
+    designChainCoefficients(current, sample_rate, coefficients);
+}
+
+void ChainSmoother::jumpTo(const ChainSettings& chain_settings) noexcept
+{
+    current = chain_settings;
+    pending_bands = 0;
+    ramping_bands = 0;
+    
+    low_cut_freq.setCurrentAndTargetValue(chain_settings.low_cut_freq);
+    high_cut_freq.setCurrentAndTargetValue(chain_settings.high_cut_freq);
+    
+    for (int band = 0; band < max_bands; ++band)
+        jumpBandTo(band, chain_settings);
+}
+
+void ChainSmoother::jumpBandTo(int band, const ChainSettings& chain_settings) noexcept
+{
+    const auto i = (size_t) band;
+    band_freq[i].setCurrentAndTargetValue(chain_settings.band_freq[i]);
+    band_gain_db[i].setCurrentAndTargetValue(chain_settings.band_gain_db[i]);
+    band_q[i].setCurrentAndTargetValue(chain_settings.band_q[i]);
+    current.band_freq[i] = chain_settings.band_freq[i];
+    current.band_gain_db[i] = chain_settings.band_gain_db[i];
+    current.band_q[i] = chain_settings.band_q[i];
+}
+
+void ChainSmoother::setRampLengthSeconds(double seconds) noexcept
+{
+    ramp_seconds = seconds;
+    resetSmoothers();
+}
+
+void ChainSmoother::resetSmoothers() noexcept
+{
+    low_cut_freq.reset(sample_rate, ramp_seconds);
+    high_cut_freq.reset(sample_rate, ramp_seconds);
+    
+    for (int i = 0; i < max_bands; ++i)
+    {
+        band_freq[(size_t) i].reset(sample_rate, ramp_seconds);
+        band_gain_db[(size_t) i].reset(sample_rate, ramp_seconds);
+        band_q[(size_t) i].reset(sample_rate, ramp_seconds);
+    }
+}
+
+void ChainSmoother::setTargets(const ChainSettings& chain_settings) noexcept
+{
+    low_cut_freq.setTargetValue(chain_settings.low_cut_freq);
+    high_cut_freq.setTargetValue(chain_settings.high_cut_freq);
+    
+    for (int band = 0; band < max_bands; ++band)
+    {
+        const auto i = (size_t) band;
+        const auto bit = getBandBit(getBandPosition(band));
+        
+        // Switching a band on or changing its shape, topology or side can't ramp,
+        // and a band that's off has nothing to ramp. Either way it starts from its targets.
+        if (chain_settings.band_enabled[i] != current.band_enabled[i] || chain_settings.band_type[i] != current.band_type[i]
+             || chain_settings.band_topology[i] != current.band_topology[i] || chain_settings.band_placement[i] != current.band_placement[i])
+        {
+            current.band_enabled[i] = chain_settings.band_enabled[i];
+            current.band_type[i] = chain_settings.band_type[i];
+            current.band_topology[i] = chain_settings.band_topology[i];
+            current.band_placement[i] = chain_settings.band_placement[i];
+            jumpBandTo(band, chain_settings);
+            ramping_bands &= ~bit;
+            pending_bands |= bit;
+            continue;
+        }
+        
+        if (! current.band_enabled[i])
+        {
+            jumpBandTo(band, chain_settings);
+            continue;
+        }
+        
+        band_freq[i].setTargetValue(chain_settings.band_freq[i]);
+        band_gain_db[i].setTargetValue(chain_settings.band_gain_db[i]);
+        band_q[i].setTargetValue(chain_settings.band_q[i]);
+        
+        if (band_freq[i].isSmoothing() || band_gain_db[i].isSmoothing() || band_q[i].isSmoothing())
+            ramping_bands |= bit;
+    }
+    
+    // Switching to or from matched designs changes every peak and cut at once
+    if (chain_settings.design_method != current.design_method)
+    {
+        current.design_method = chain_settings.design_method;
+        pending_bands |= all_bands;
+    }
+    
+    // Every band's side changes with the stereo mode
+    if (chain_settings.stereo_mode != current.stereo_mode)
+    {
+        current.stereo_mode = chain_settings.stereo_mode;
+        pending_bands |= all_bands;
+    }
+    
+    if (chain_settings.low_cut_slope != current.low_cut_slope || chain_settings.low_cut_topology != current.low_cut_topology
+         || chain_settings.low_cut_placement != current.low_cut_placement)
+    {
+        current.low_cut_slope = chain_settings.low_cut_slope;
+        current.low_cut_topology = chain_settings.low_cut_topology;
+        current.low_cut_placement = chain_settings.low_cut_placement;
+        pending_bands |= getBandBit(LowCut);
+    }
+    
+    if (chain_settings.high_cut_slope != current.high_cut_slope || chain_settings.high_cut_topology != current.high_cut_topology
+         || chain_settings.high_cut_placement != current.high_cut_placement)
+    {
+        current.high_cut_slope = chain_settings.high_cut_slope;
+        current.high_cut_topology = chain_settings.high_cut_topology;
+        current.high_cut_placement = chain_settings.high_cut_placement;
+        pending_bands |= getBandBit(HiCut);
+    }
+}
+
+void ChainSmoother::setGainOffsets(const std::array<float, max_bands>& offsets_db, int changed_bands) noexcept
+{
+    for (int band = 0; band < max_bands; ++band)
+    {
+        const auto i = (size_t) band;
+        const auto bit = getBandBit(getBandPosition(band));
+        
+        if ((changed_bands & bit) == 0)
+            continue;
+        
+        gain_offset_db[i] = offsets_db[i];
+        offset_bands = offsets_db[i] != 0.f ? (offset_bands | bit) : (offset_bands & ~bit);
+        pending_bands |= bit;
+    }
+}
+
+bool ChainSmoother::isSmoothing() const noexcept
+{
+    return pending_bands != 0 || ramping_bands != 0
+        || low_cut_freq.isSmoothing() || high_cut_freq.isSmoothing();
+}
+
+int ChainSmoother::advance(int num_samples, ChainCoefficients& coefficients) noexcept
+{
+    auto bands = pending_bands;
+    pending_bands = 0;
+    
+    if (low_cut_freq.isSmoothing())
+    {
+        current.low_cut_freq = low_cut_freq.skip(num_samples);
+        bands |= getBandBit(LowCut);
+    }
+    
+    if (high_cut_freq.isSmoothing())
+    {
+        current.high_cut_freq = high_cut_freq.skip(num_samples);
+        bands |= getBandBit(HiCut);
+    }
+    
+    // Only the bands that are ramping, so an idle band costs nothing here
+    for (int band = 0; band < max_bands && ramping_bands != 0; ++band)
+    {
+        const auto i = (size_t) band;
+        const auto bit = getBandBit(getBandPosition(band));
+        
+        if ((ramping_bands & bit) == 0)
+            continue;
+        
+        current.band_freq[i] = band_freq[i].skip(num_samples);
+        current.band_gain_db[i] = band_gain_db[i].skip(num_samples);
+        current.band_q[i] = band_q[i].skip(num_samples);
+        bands |= bit;
+        
+        if (! (band_freq[i].isSmoothing() || band_gain_db[i].isSmoothing() || band_q[i].isSmoothing()))
+            ramping_bands &= ~bit;
+    }
+    
+    if (bands == 0)
+        return bands;
+    
+    if (offset_bands == 0)
+    {
+        designChainCoefficients(current, sample_rate, coefficients, bands);
+        return bands;
+    }
+    
+    // Dynamic bands are designed at their smoothed gain plus the offset
+    offset_settings = current;
+    
+    for (int band = 0; band < max_bands; ++band)
+        if (offset_bands & getBandBit(getBandPosition(band)))
+            offset_settings.band_gain_db[(size_t) band] += gain_offset_db[(size_t) band];
+    
+    designChainCoefficients(offset_settings, sample_rate, coefficients, bands);
+    
+    return bands;
+}
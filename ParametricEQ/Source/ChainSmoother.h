@@ -0,0 +1,76 @@
+/*
+  ==============================================================================
+
+    ChainSmoother.h
+
+    Control rate parameter smoothing for the filter chain. The block is cut
+    into fixed size sub-blocks, the smoothed frequency, gain and Q move once
+    per sub-block, and only the bands that are still ramping get redesigned.
+    The cost per sample is therefore the same for any host block size, and
+    so is the sound of automation. Slopes, band types, topologies, stereo
+    placement, the design method and enabling a band can't be smoothed and
+    switch straight away, and disabled bands don't ramp at all. Bands run
+    as state variable filters also ramp per sample between sub-blocks, see
+    StateVariableCascade.
+    Dynamic bands get their gain offsets from BandDynamics once per
+    sub-block, on top of the smoothed gain.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterChain.h"
+
+class ChainSmoother
+{
+public:
+    // Snaps every smoother to chain_settings and designs all bands
+    void reset(double sample_rate, const ChainSettings& chain_settings, ChainCoefficients& coefficients) noexcept;
+
+    // Snaps every smoother to chain_settings without designing, for when
+    // the matching coefficients are already known (e.g. a preset)
+    void jumpTo(const ChainSettings& chain_settings) noexcept;
+
+    void setRampLengthSeconds(double seconds) noexcept;
+
+    void setTargets(const ChainSettings& chain_settings) noexcept;
+    
+    // Extra gain on top of each band's smoothed gain, from BandDynamics.
+    // Only the bands in changed_bands (ChainPositions bits) are read, and
+    // they're redesigned on the next advance without ramping.
+    void setGainOffsets(const std::array<float, max_bands>& offsets_db, int changed_bands) noexcept;
+
+    // Moves every ramping band on by num_samples and redesigns it into
+    // coefficients. Returns the bands that changed (ChainPositions bits).
+    int advance(int num_samples, ChainCoefficients& coefficients) noexcept;
+
+    bool isSmoothing() const noexcept;
+
+private:
+    using FrequencySmoother = juce::SmoothedValue<float, juce::ValueSmoothingTypes::Multiplicative>;
+    using LinearSmoother = juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear>;
+
+    void resetSmoothers() noexcept;
+    void jumpBandTo(int band, const ChainSettings& chain_settings) noexcept;
+
+    double sample_rate { 44100.0 };
+    double ramp_seconds { 0.05 };
+
+    FrequencySmoother low_cut_freq, high_cut_freq;
+
+    // One array per parameter, like ChainSettings
+    std::array<FrequencySmoother, max_bands> band_freq;
+    std::array<LinearSmoother, max_bands> band_gain_db, band_q;
+    int ramping_bands { 0 };   // ChainPositions bits
+
+    // Current values, slopes included, as last designed
+    ChainSettings current;
+    int pending_bands { 0 };
+    
+    // Dynamic gain, added to a copy of current when designing
+    std::array<float, max_bands> gain_offset_db {};
+    int offset_bands { 0 };   // ChainPositions bits with a non-zero offset
+    ChainSettings offset_settings;
+};
@@ -0,0 +1,127 @@
+/*
+  ==============================================================================
+
+    ChannelWorkerPool.cpp
+
+  ==============================================================================
+*/
+
+#include "ChannelWorkerPool.h"
+
+class ChannelWorkerPool::Worker : public juce::Thread
+{
+public:
+    explicit Worker(ChannelWorkerPool& owner_pool)
+        : juce::Thread("EQ Channel Worker"), pool(owner_pool)
+    {
+        startThread(juce::Thread::Priority::highest);
+    }
+    
+    ~Worker() override
+    {
+        signalThreadShouldExit();
+        wake_event.signal();
+        stopThread(1000);
+    }
+    
+    void wakeIfSleeping() noexcept
+    {
+        if (sleeping.load())
+            wake_event.signal();
+    }
+    
+private:
+    void run() override
+    {
+        auto seen = pool.generation.load();
+        
+        while (! threadShouldExit())
+        {
+            if (pool.generation.load() != seen)
+            {
+                seen = pool.generation.load();
+                const RealtimeMonitor::ScopedRealtime realtime(pool.current_monitor.load());
+                juce::ScopedNoDenormals no_denormals;   // MXCSR is per thread, the audio thread's doesn't reach here
+                
+                while (pool.runOneJob(seen))
+                    {}
+                
+                continue;
+            }
+            
+            // Stay hot for a little while, consecutive blocks arrive quickly
+            for (int spin = 0; spin < spin_count && pool.generation.load() == seen; ++spin)
+                std::this_thread::yield();
+            
+            sleeping = true;
+            
+            if (pool.generation.load() == seen && ! threadShouldExit())
+                wake_event.wait(100);
+            
+            sleeping = false;
+        }
+    }
+    
+    static constexpr int spin_count = 2000;
+    
+    ChannelWorkerPool& pool;
+    juce::WaitableEvent wake_event;
+    std::atomic<bool> sleeping { false };
+};
+
+//==============================================================================
+ChannelWorkerPool::ChannelWorkerPool(int num_workers)
+{
+    for (int i = 0; i < num_workers; ++i)
+        workers.add(new Worker(*this));
+}
+
+ChannelWorkerPool::~ChannelWorkerPool()
+{
+    workers.clear();
+}
+
+bool ChannelWorkerPool::runOneJob(juce::uint32 batch) noexcept
+{
+    auto claim = next_claim.load();
+    
+    for (;;)
+    {
+        const auto index = (juce::uint32) (claim & 0xffffu);
+        const auto num_jobs = (juce::uint32) ((claim >> 16) & 0xffffu);
+        
+        if ((juce::uint32) (claim >> 32) != batch || index >= num_jobs)
+            return false;
+        
+        if (next_claim.compare_exchange_weak(claim, claim + 1))
+        {
+            current_job.load()(current_context.load(), (int) index);
+            jobs_done.fetch_add(1);
+            return true;
+        }
+    }
+}
+
+void ChannelWorkerPool::run(int num_jobs, Job job, void* context) noexcept
+{
+    jassert(num_jobs >= 0 && num_jobs <= max_jobs);
+    
+    const auto batch = generation.load() + 1;
+    
+    current_job = job;
+    current_context = context;
+    current_monitor = RealtimeMonitor::getCurrent();
+    jobs_done = 0;
+    next_claim = makeClaim(batch, (juce::uint32) num_jobs, 0);
+    generation = batch;
+    
+    for (auto* worker : workers)
+        worker->wakeIfSleeping();
+    
+    while (runOneJob(batch))
+        {}
+    
+    // Only jobs a worker has already claimed are left
+    while (jobs_done.load() < num_jobs)
+        {}
+}
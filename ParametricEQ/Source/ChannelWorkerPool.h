@@ -0,0 +1,60 @@
+/*
+  ==============================================================================
+
+    ChannelWorkerPool.h
+
+    Pre-spawned worker threads that help the audio thread get through a
+    batch of independent jobs (e.g. SIMD channel groups of a wide bus).
+    run() never allocates or takes a lock: jobs are claimed from an atomic
+    counter, the audio thread claims jobs too, and it only ever waits for
+    jobs a worker has already started. Idle workers spin briefly and then
+    sleep; waking a sleeping worker is the only call into the OS. Jobs on
+    workers are realtime checked like the thread that called run(), and
+    run with denormals flushed to zero.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Instrumentation.h"
+
+class ChannelWorkerPool
+{
+public:
+    using Job = void (*)(void* context, int job_index) noexcept;
+    
+    explicit ChannelWorkerPool(int num_workers);
+    ~ChannelWorkerPool();
+    
+    int getNumWorkers() const noexcept { return workers.size(); }
+    
+    static constexpr int max_jobs = 0xffff;
+    
+    // Runs job(context, i) for every i in [0, num_jobs) and returns once all are done
+    void run(int num_jobs, Job job, void* context) noexcept;
+    
+private:
+    class Worker;
+    
+    // Claims carry the batch generation and its job count, so a late worker can't
+    // take a job from a newer batch or check its index against a newer count
+    bool runOneJob(juce::uint32 batch) noexcept;
+    
+    static juce::uint64 makeClaim(juce::uint32 batch, juce::uint32 num_jobs, juce::uint32 index) noexcept
+    {
+        return ((juce::uint64) batch << 32) | ((juce::uint64) num_jobs << 16) | index;
+    }
+    
+    std::atomic<Job> current_job { nullptr };
+    std::atomic<RealtimeMonitor*> current_monitor { nullptr };   // The calling thread's, workers report to it too
+    std::atomic<void*> current_context { nullptr };
+    std::atomic<int> jobs_done { 0 };
+    std::atomic<juce::uint64> next_claim { 0 };
+    std::atomic<juce::uint32> generation { 0 };
+    
+    juce::OwnedArray<Worker> workers;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChannelWorkerPool)
+};
@@ -0,0 +1,241 @@
+/*
+  ==============================================================================
+
+    CoefficientCache.cpp
+
+  ==============================================================================
+*/
+
+#include "CoefficientCache.h"
+
+CoefficientCache::CoefficientCache()
+{
+    setCapacity(default_capacity);
+}
+
+void CoefficientCache::setCapacity(int num_entries)
+{
+    const juce::SpinLock::ScopedLockType sl(lock);
+    
+    entries.assign((size_t) juce::jmax(1, num_entries), Entry {});
+    buckets.assign((size_t) juce::nextPowerOfTwo((int) entries.size() * 2), none);
+    size = 0;
+    most_recent = least_recent = none;
+}
+
+// Packs the parameter steps and the DesignMethod into 58 bits, false if a
+// value is off the grid. For a band, slope holds the BandType.
+bool CoefficientCache::makeKey(juce::uint64& key, Kind kind, double sample_rate, float freq, float q, float gain_db, int slope, int method) noexcept
+{
+    auto quantize = [](double value, double step, int limit, int& index)
+    {
+        index = juce::roundToInt(value / step);
+        return index >= 0 && index < limit && std::abs(value - index * step) < step * 1.0e-3;
+    };
+    
+    int rate_index = 0, freq_index = 0, q_index = 0, gain_index = 0;
+    
+    if (! quantize(sample_rate, 1.0, 1 << 20, rate_index)
+        || ! quantize(freq, 1.0, 1 << 15, freq_index)
+        || ! quantize(q, 0.05, 1 << 9, q_index)
+        || ! quantize(gain_db + 64.0, 0.5, 1 << 8, gain_index)
+        || slope < 0 || slope >= (kind == Kind::Band ? num_band_types : max_cut_sections)
+        || (method != Design_Bilinear && method != Design_Matched))
+        return false;
+    
+    key = (juce::uint64) kind
+        | (juce::uint64) slope << 2
+        | (juce::uint64) gain_index << 5
+        | (juce::uint64) q_index << 13
+        | (juce::uint64) freq_index << 22
+        | (juce::uint64) rate_index << 37
+        | (juce::uint64) method << 57;
+    
+    return true;
+}
+
+void CoefficientCache::getBand(BiquadCoefficients<double>& c, int type, double sample_rate, float freq, float q, float gain_db,
+                               int method) noexcept
+{
+    juce::uint64 key;
+    CutCoefficients<double> value;
+    
+    // A notch at any gain is the same notch, and only peaks have a matched design
+    if (type == Band_Notch)
+        gain_db = 0.f;
+    
+    if (type != Band_Peak)
+        method = Design_Bilinear;
+    
+    if (! makeKey(key, Kind::Band, sample_rate, freq, q, gain_db, type, method))
+    {
+        ++uncacheable;
+        makeBandCoefficients(c, type, sample_rate, freq, q, gain_db, method);
+        return;
+    }
+    
+    if (! find(key, value))
+    {
+        makeBandCoefficients(value[0], type, sample_rate, freq, q, gain_db, method);
+        insert(key, value);
+    }
+    
+    c = value[0];
+}
+
+void CoefficientCache::getLowCut(CutCoefficients<double>& sections, double sample_rate, float freq, int slope, int method) noexcept
+{
+    juce::uint64 key;
+    
+    if (! makeKey(key, Kind::LowCut, sample_rate, freq, 1.f, 0.f, slope, method))
+    {
+        ++uncacheable;
+        makeLowCutCoefficients(sections, sample_rate, freq, slope, method);
+        return;
+    }
+    
+    if (! find(key, sections))
+    {
+        makeLowCutCoefficients(sections, sample_rate, freq, slope, method);
+        insert(key, sections);
+    }
+}
+
+void CoefficientCache::getHighCut(CutCoefficients<double>& sections, double sample_rate, float freq, int slope, int method) noexcept
+{
+    juce::uint64 key;
+    
+    if (! makeKey(key, Kind::HighCut, sample_rate, freq, 1.f, 0.f, slope, method))
+    {
+        ++uncacheable;
+        makeHighCutCoefficients(sections, sample_rate, freq, slope, method);
+        return;
+    }
+    
+    if (! find(key, sections))
+    {
+        makeHighCutCoefficients(sections, sample_rate, freq, slope, method);
+        insert(key, sections);
+    }
+}
+
+static size_t getBucket(juce::uint64 key, size_t num_buckets) noexcept
+{
+    key ^= key >> 29;
+    key *= 0xbf58476d1ce4e5b9ull;
+    key ^= key >> 32;
+    return (size_t) key & (num_buckets - 1);
+}
+
+bool CoefficientCache::find(juce::uint64 key, CutCoefficients<double>& value) noexcept
+{
+    PARAMETRIC_EQ_NOTE_LOCK();
+    const juce::SpinLock::ScopedLockType sl(lock);
+    
+    for (auto index = buckets[getBucket(key, buckets.size())]; index != none; index = entries[(size_t) index].next_in_bucket)
+    {
+        if (entries[(size_t) index].key == key)
+        {
+            unlink(index);
+            pushFront(index);
+            value = entries[(size_t) index].value;
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    
+    misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void CoefficientCache::insert(juce::uint64 key, const CutCoefficients<double>& value) noexcept
+{
+    PARAMETRIC_EQ_NOTE_LOCK();
+    const juce::SpinLock::ScopedLockType sl(lock);
+    const auto bucket = getBucket(key, buckets.size());
+    
+    // Another thread may have designed the same thing meanwhile
+    for (auto index = buckets[bucket]; index != none; index = entries[(size_t) index].next_in_bucket)
+        if (entries[(size_t) index].key == key)
+            return;
+    
+    int index = size;
+    
+    if (size < (int) entries.size())
+    {
+        ++size;
+    }
+    else
+    {
+        // Recycle the least recently used entry
+        index = least_recent;
+        unlink(index);
+        
+        auto* link = &buckets[getBucket(entries[(size_t) index].key, buckets.size())];
+        
+        while (*link != index)
+            link = &entries[(size_t) *link].next_in_bucket;
+        
+        *link = entries[(size_t) index].next_in_bucket;
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    auto& entry = entries[(size_t) index];
+    entry.key = key;
+    entry.value = value;
+    entry.next_in_bucket = buckets[bucket];
+    buckets[bucket] = index;
+    
+    pushFront(index);
+}
+
+void CoefficientCache::unlink(int index) noexcept
+{
+    auto& entry = entries[(size_t) index];
+    
+    if (entry.previous != none) entries[(size_t) entry.previous].next = entry.next;
+    else                        most_recent = entry.next;
+    
+    if (entry.next != none)     entries[(size_t) entry.next].previous = entry.previous;
+    else                        least_recent = entry.previous;
+    
+    entry.previous = entry.next = none;
+}
+
+void CoefficientCache::pushFront(int index) noexcept
+{
+    auto& entry = entries[(size_t) index];
+    entry.previous = none;
+    entry.next = most_recent;
+    
+    if (most_recent != none)
+        entries[(size_t) most_recent].previous = index;
+    
+    most_recent = index;
+    
+    if (least_recent == none)
+        least_recent = index;
+}
+
+CoefficientCache::Stats CoefficientCache::getStats() const noexcept
+{
+    PARAMETRIC_EQ_NOTE_LOCK();
+    const juce::SpinLock::ScopedLockType sl(lock);
+    
+    Stats stats;
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.evictions = evictions.load(std::memory_order_relaxed);
+    stats.uncacheable = uncacheable.load(std::memory_order_relaxed);
+    stats.size = size;
+    stats.capacity = (int) entries.size();
+    return stats;
+}
+
+void CoefficientCache::resetStats() noexcept
+{
+    hits = 0;
+    misses = 0;
+    evictions = 0;
+    uncacheable = 0;
+}
@@ -0,0 +1,82 @@
+/*
+  ==============================================================================
+
+    CoefficientCache.h
+
+    Every parameter is quantized by its NormalisableRange (1 Hz, 0.5 dB,
+    0.05 Q, four slopes), so only a finite set of coefficients can ever be
+    asked for. This cache keeps the most recently used designs, keyed on
+    the parameter steps and the sample rate, so repeated settings and
+    automation sweeps become lookups instead of tan / sin / pow.
+
+    Storage is allocated up front and entries are recycled least recently
+    used first, so lookups never allocate. One cache is shared by every
+    plugin instance (use it through juce::SharedResourcePointer).
+    Values that aren't on the parameter grid are designed directly.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BiquadDesign.h"
+#include "Instrumentation.h"
+
+class CoefficientCache
+{
+public:
+    struct Stats
+    {
+        juce::uint64 hits { 0 }, misses { 0 }, evictions { 0 }, uncacheable { 0 };
+        int size { 0 }, capacity { 0 };
+    };
+    
+    static constexpr int default_capacity = 4096;
+    
+    CoefficientCache();
+    
+    // Allocates and empties the cache, don't call while designs are running
+    void setCapacity(int num_entries);
+    
+    // Any BandType and DesignMethod, see makeBandCoefficients
+    void getBand(BiquadCoefficients<double>& c, int type, double sample_rate, float freq, float q, float gain_db,
+                 int method = Design_Bilinear) noexcept;
+    void getLowCut(CutCoefficients<double>& sections, double sample_rate, float freq, int slope, int method = Design_Bilinear) noexcept;
+    void getHighCut(CutCoefficients<double>& sections, double sample_rate, float freq, int slope, int method = Design_Bilinear) noexcept;
+    
+    Stats getStats() const noexcept;
+    void resetStats() noexcept;
+    
+private:
+    // The band kinds follow BandType order
+    enum class Kind { LowCut, HighCut, Band };
+    
+    static bool makeKey(juce::uint64& key, Kind kind, double sample_rate, float freq, float q, float gain_db, int slope, int method) noexcept;
+    
+    // Both take the lock, the design itself happens outside it
+    bool find(juce::uint64 key, CutCoefficients<double>& value) noexcept;
+    void insert(juce::uint64 key, const CutCoefficients<double>& value) noexcept;
+    
+    void unlink(int index) noexcept;
+    void pushFront(int index) noexcept;
+    
+    static constexpr int none = -1;
+    
+    // A band only uses the first section
+    struct Entry
+    {
+        juce::uint64 key { 0 };
+        CutCoefficients<double> value {};
+        int previous { none }, next { none }, next_in_bucket { none };
+    };
+    
+    mutable juce::SpinLock lock;
+    std::vector<Entry> entries;
+    std::vector<int> buckets;
+    int size { 0 }, most_recent { none }, least_recent { none };
+    
+    std::atomic<juce::uint64> hits { 0 }, misses { 0 }, evictions { 0 }, uncacheable { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CoefficientCache)
+};
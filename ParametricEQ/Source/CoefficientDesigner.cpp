@@ -0,0 +1,47 @@
+/*
+  ==============================================================================
+
+    CoefficientDesigner.cpp
+
+  ==============================================================================
+*/
+
+#include "CoefficientDesigner.h"
+
+CoefficientDesignThread::CoefficientDesignThread()
+    : juce::Thread("EQ Coefficient Designer")
+{
+    startThread();
+}
+
+CoefficientDesignThread::~CoefficientDesignThread()
+{
+    stopThread(1000);
+}
+
+void CoefficientDesignThread::addClient(CoefficientDesignClient* client)
+{
+    const juce::ScopedLock sl(client_lock);
+    clients.addIfNotAlreadyThere(client);
+}
+
+void CoefficientDesignThread::removeClient(CoefficientDesignClient* client)
+{
+    const juce::ScopedLock sl(client_lock);
+    clients.removeFirstMatchingValue(client);
+}
+
+void CoefficientDesignThread::run()
+{
+    while (! threadShouldExit())
+    {
+        {
+            const juce::ScopedLock sl(client_lock);
+
+            for (auto* client : clients)
+                client->designPendingBands();
+        }
+
+        wait(poll_interval_ms);
+    }
+}
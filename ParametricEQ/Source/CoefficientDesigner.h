@@ -0,0 +1,48 @@
+/*
+  ==============================================================================
+
+    CoefficientDesigner.h
+
+    Background thread that designs filter coefficients away from the audio
+    thread. A single thread is shared by every plugin instance in the process
+    (use it through juce::SharedResourcePointer).
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+// Anything that has coefficient work queued up for the design thread
+struct CoefficientDesignClient
+{
+    virtual ~CoefficientDesignClient() = default;
+
+    // Called on the design thread. Must return quickly if nothing is dirty.
+    virtual void designPendingBands() = 0;
+};
+
+class CoefficientDesignThread : private juce::Thread
+{
+public:
+    CoefficientDesignThread();
+    ~CoefficientDesignThread() override;
+
+    void addClient(CoefficientDesignClient* client);
+
+    // Once this returns the client is guaranteed not to be called again
+    void removeClient(CoefficientDesignClient* client);
+
+private:
+    void run() override;
+
+    // Clients only set atomic dirty flags from the audio thread, so the
+    // thread polls rather than being woken (waking would need a lock).
+    static constexpr int poll_interval_ms = 5;
+
+    juce::CriticalSection client_lock;
+    juce::Array<CoefficientDesignClient*> clients;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CoefficientDesignThread)
+};
@@ -0,0 +1,275 @@
+/*
+  ==============================================================================
+
+    EqEngine.cpp
+
+  ==============================================================================
+*/
+
+#include "EqEngine.h"
+
+template <typename SampleType>
+void EqEngine<SampleType>::prepare(double new_sample_rate, int new_max_streams, int max_block_size)
+{
+    prepare(new_sample_rate, new_max_streams, max_block_size, getBestCascadeKernels<SampleType>());
+}
+
+template <typename SampleType>
+void EqEngine<SampleType>::prepare(double new_sample_rate, int new_max_streams, int max_block_size, const CascadeKernelSet<SampleType>& kernel_set)
+{
+    kernel_set_ptr = &kernel_set;
+    const auto width = kernel_set.width;
+    
+    sample_rate = new_sample_rate;
+    max_streams = juce::jmax(0, new_max_streams);
+    num_streams = 0;
+    num_groups = (max_streams + width - 1) / width;
+    prepared_block_size = juce::jmax(1, max_block_size);
+    state_stride = num_chain_sections * 2 * width;
+    coefficient_stride = num_chain_sections * num_lane_coefficients * width;
+    
+    state.allocate((size_t) (num_groups * state_stride));
+    coefficients.allocate((size_t) (num_groups * coefficient_stride));
+    scratch.allocate((size_t) (num_groups * prepared_block_size * width));
+    groups.assign((size_t) num_groups, StreamGroup());
+    stream_masks.assign((size_t) max_streams, 0u);
+    
+    state.clear((size_t) (num_groups * state_stride));
+    
+    // Every slot starts out passing its lane straight through
+    for (int stream = 0; stream < num_groups * width; ++stream)
+        for (int section = 0; section < num_chain_sections; ++section)
+            setLaneCoefficients(stream, section, {});
+}
+
+template <typename SampleType>
+int EqEngine<SampleType>::addStream(const ChainSettings& chain_settings) noexcept
+{
+    const auto width = getLanesPerGroup();
+    
+    for (int group = 0; group < num_groups; ++group)
+    {
+        for (int lane = 0; lane < width; ++lane)
+        {
+            const auto stream = group * width + lane;
+            
+            if (stream >= max_streams)
+                return -1;
+            
+            if (groups[(size_t) group].lanes & (1u << lane))
+                continue;
+            
+            groups[(size_t) group].lanes |= 1u << lane;
+            stream_masks[(size_t) stream] = 0;
+            ++num_streams;
+            
+            setStreamSettings(stream, chain_settings);
+            return stream;
+        }
+    }
+    
+    return -1;
+}
+
+template <typename SampleType>
+void EqEngine<SampleType>::removeStream(int stream) noexcept
+{
+    if (! isStreamActive(stream))
+        return;
+    
+    const auto group = stream / getLanesPerGroup();
+    
+    // Back to a pass through with clean state, ready for the next stream in this lane
+    for (int section = 0; section < num_chain_sections; ++section)
+        setLaneCoefficients(stream, section, {});
+    
+    clearLaneState(stream, ~0u);
+    stream_masks[(size_t) stream] = 0;
+    groups[(size_t) group].lanes &= ~(1u << (stream % getLanesPerGroup()));
+    --num_streams;
+    
+    updateGroupSections(group);
+}
+
+template <typename SampleType>
+bool EqEngine<SampleType>::isStreamActive(int stream) const noexcept
+{
+    if (! juce::isPositiveAndBelow(stream, max_streams))
+        return false;
+    
+    const auto width = getLanesPerGroup();
+    return (groups[(size_t) (stream / width)].lanes & (1u << (stream % width))) != 0;
+}
+
+template <typename SampleType>
+void EqEngine<SampleType>::setStreamSettings(int stream, const ChainSettings& chain_settings) noexcept
+{
+    designChainCoefficients(chain_settings, sample_rate, designed, all_bands, cache);
+    setStreamCoefficients(stream, designed);
+}
+
+template <typename SampleType>
+void EqEngine<SampleType>::setStreamCoefficients(int stream, const ChainCoefficients& chain_coefficients) noexcept
+{
+    jassert(isStreamActive(stream));
+    
+    const auto mask = getActiveSectionMask(chain_coefficients);
+    const auto old_mask = stream_masks[(size_t) stream];
+    
+    // A slot the stream doesn't run is a pass through, not a skipped
+    // section, since the other lanes of the group may still run it
+    for (int section = 0; section < num_chain_sections; ++section)
+        setLaneCoefficients(stream, section, (mask & (1u << section)) != 0 ? getSectionCoefficients(chain_coefficients, section)
+                                                                            : BiquadCoefficients<double>());
+    
+    // Sections coming back into the stream's chain start from silence, like in FilterChain
+    clearLaneState(stream, mask & ~old_mask);
+    stream_masks[(size_t) stream] = mask;
+    
+    updateGroupSections(stream / getLanesPerGroup());
+}
+
+template <typename SampleType>
+void EqEngine<SampleType>::setLaneCoefficients(int stream, int section, const BiquadCoefficients<double>& c) noexcept
+{
+    const auto width = getLanesPerGroup();
+    auto* lane = coefficients.getData() + (stream / width) * coefficient_stride
+                   + section * num_lane_coefficients * width + stream % width;
+    
+    lane[0]         = (SampleType) c.b0;
+    lane[width]     = (SampleType) c.b1;
+    lane[2 * width] = (SampleType) c.b2;
+    lane[3 * width] = (SampleType) c.a1;
+    lane[4 * width] = (SampleType) c.a2;
+}
+
+template <typename SampleType>
+void EqEngine<SampleType>::clearLaneState(int stream, juce::uint32 section_mask) noexcept
+{
+    const auto width = getLanesPerGroup();
+    auto* lane = state.getData() + (stream / width) * state_stride + stream % width;
+    
+    for (int section = 0; section < num_chain_sections; ++section)
+    {
+        if (section_mask & (1u << section))
+        {
+            lane[(section * 2) * width] = SampleType();
+            lane[(section * 2 + 1) * width] = SampleType();
+        }
+    }
+}
+
+template <typename SampleType>
+void EqEngine<SampleType>::updateGroupSections(int group) noexcept
+{
+    const auto width = getLanesPerGroup();
+    auto& g = groups[(size_t) group];
+    
+    g.active_mask = 0;
+    
+    for (int lane = 0; lane < width; ++lane)
+        if (g.lanes & (1u << lane))
+            g.active_mask |= stream_masks[(size_t) (group * width + lane)];
+    
+    g.num_active = 0;
+    
+    for (int section = 0; section < num_chain_sections; ++section)
+        if (g.active_mask & (1u << section))
+            g.active[(size_t) g.num_active++] = section;
+}
+
+template <typename SampleType>
+void EqEngine<SampleType>::process(SampleType* const* streams, int num_samples) noexcept
+{
+    jassert(kernel_set_ptr != nullptr);
+    
+    if (num_streams == 0)
+        return;
+    
+    // Hundreds of decaying streams, nothing else here sets FTZ / DAZ for the caller
+    juce::ScopedNoDenormals no_denormals;
+    
+    for (int offset = 0; offset < num_samples; offset += prepared_block_size)
+    {
+        const auto chunk = juce::jmin(prepared_block_size, num_samples - offset);
+        
+        if (worker_pool != nullptr && num_groups > 1)
+        {
+            pending = { streams, offset, chunk };
+            worker_pool->run(num_groups, &processGroupJob, this);
+            continue;
+        }
+        
+        for (int group = 0; group < num_groups; ++group)
+            processGroup(group, streams, offset, chunk);
+    }
+}
+
+template <typename SampleType>
+void EqEngine<SampleType>::processGroupJob(void* context, int group) noexcept
+{
+    auto& engine = *static_cast<EqEngine*>(context);
+    const auto& block = engine.pending;
+    engine.processGroup(group, block.streams, block.offset, block.num_samples);
+}
+
+template <typename SampleType>
+void EqEngine<SampleType>::processGroup(int group, SampleType* const* streams, int offset, int num_samples) noexcept
+{
+    const auto& g = groups[(size_t) group];
+    
+    // Empty groups and groups where every stream is flat cost nothing
+    if (g.lanes == 0 || g.num_active == 0)
+        return;
+    
+    const auto width = kernel_set_ptr->width;
+    const auto kernel = kernel_set_ptr->lane_kernels[(size_t) g.num_active];
+    const auto first_stream = group * width;
+    auto* group_state = state.getData() + group * state_stride;
+    const auto* group_coefficients = coefficients.getData() + group * coefficient_stride;
+    
+    // One lane is just the stream itself, no need to interleave
+    if (width == 1)
+    {
+        kernel(streams[first_stream] + offset, num_samples, group_coefficients, group_state, g.active.data());
+        return;
+    }
+    
+    auto* group_scratch = scratch.getData() + group * prepared_block_size * width;
+    
+    // Free lanes still run, keep them at zero
+    for (int lane = 0; lane < width; ++lane)
+    {
+        auto* destination = group_scratch + lane;
+        
+        if (g.lanes & (1u << lane))
+        {
+            const auto* source = streams[first_stream + lane] + offset;
+            
+            for (int n = 0; n < num_samples; ++n)
+                destination[n * width] = source[n];
+        }
+        else
+        {
+            for (int n = 0; n < num_samples; ++n)
+                destination[n * width] = SampleType();
+        }
+    }
+    
+    kernel(group_scratch, num_samples, group_coefficients, group_state, g.active.data());
+    
+    for (int lane = 0; lane < width; ++lane)
+    {
+        if ((g.lanes & (1u << lane)) == 0)
+            continue;
+        
+        const auto* source = group_scratch + lane;
+        auto* destination = streams[first_stream + lane] + offset;
+        
+        for (int n = 0; n < num_samples; ++n)
+            destination[n] = source[n * width];
+    }
+}
+
+template class EqEngine<float>;
+template class EqEngine<double>;
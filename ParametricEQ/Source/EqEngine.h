@@ -0,0 +1,103 @@
+/*
+  ==============================================================================
+
+    EqEngine.h
+
+    The filter chain for many independent mono streams, without an
+    AudioProcessor, parameter tree or editor per stream. Each stream has
+    its own ChainSettings. Streams are packed into SIMD lanes, one stream
+    per lane, so eight float streams share a single AVX pass; lanes of a
+    group run the same section slots, and a slot a stream doesn't use
+    passes it through unchanged.
+
+    Coefficients, state and scratch live in arenas sized by prepare().
+    Adding, removing and redesigning streams only write into them, so
+    none of it allocates and all of it can happen on the processing
+    thread between blocks. The engine isn't thread safe: every call must
+    come from the same thread, or be serialised by the caller. Groups of
+    streams can be spread over a worker pool.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterChain.h"
+
+template <typename SampleType>
+class EqEngine
+{
+public:
+    // Allocates every arena and drops all streams. The only call that allocates.
+    void prepare(double sample_rate, int max_streams, int max_block_size);
+    void prepare(double sample_rate, int max_streams, int max_block_size, const CascadeKernelSet<SampleType>& kernel_set);
+    
+    // Returns the new stream's index, or -1 when all max_streams are in use.
+    // Streams fill the lowest free lane so groups stay full. Never allocates.
+    int addStream(const ChainSettings& chain_settings) noexcept;
+    void removeStream(int stream) noexcept;
+    
+    bool isStreamActive(int stream) const noexcept;
+    int getNumStreams() const noexcept      { return num_streams; }
+    int getMaxStreams() const noexcept      { return max_streams; }
+    
+    // New settings for a running stream, designed straight away. There's no
+    // smoothing, the state carries on as with an unsmoothed parameter change.
+    void setStreamSettings(int stream, const ChainSettings& chain_settings) noexcept;
+    
+    // For streams sharing a design, e.g. from a preset, or designed on another thread
+    void setStreamCoefficients(int stream, const ChainCoefficients& coefficients) noexcept;
+    
+    // Optional, settings already seen are looked up instead of designed
+    void setCoefficientCache(CoefficientCache* new_cache) noexcept   { cache = new_cache; }
+    
+    // Spread stream groups over a worker pool (nullptr to stay on the calling thread)
+    void setWorkerPool(ChannelWorkerPool* new_pool) noexcept         { worker_pool = new_pool; }
+    
+    int getLanesPerGroup() const noexcept               { return kernel_set_ptr != nullptr ? kernel_set_ptr->width : 1; }
+    const char* getInstructionSetName() const noexcept  { return kernel_set_ptr != nullptr ? kernel_set_ptr->name : "none"; }
+    
+    // Filters every active stream in place. streams is indexed by stream,
+    // entries for inactive streams are ignored and may be null. Denormals
+    // are flushed to zero while it runs, on the caller and the workers.
+    void process(SampleType* const* streams, int num_samples) noexcept;
+    
+private:
+    // The lanes in use and the section slots any of them runs
+    struct StreamGroup
+    {
+        juce::uint32 lanes { 0 }, active_mask { 0 };
+        int num_active { 0 };
+        std::array<int, num_chain_sections> active {};
+    };
+    
+    struct PendingBlock
+    {
+        SampleType* const* streams;
+        int offset, num_samples;
+    };
+    
+    static void processGroupJob(void* context, int group) noexcept;
+    void processGroup(int group, SampleType* const* streams, int offset, int num_samples) noexcept;
+    
+    void setLaneCoefficients(int stream, int section, const BiquadCoefficients<double>& c) noexcept;
+    void clearLaneState(int stream, juce::uint32 section_mask) noexcept;
+    void updateGroupSections(int group) noexcept;
+    
+    double sample_rate { 44100.0 };
+    int max_streams { 0 }, num_streams { 0 }, num_groups { 0 }, prepared_block_size { 0 };
+    int state_stride { 0 }, coefficient_stride { 0 };
+    
+    // Group arenas: state is [group][section][s1, s2][lane], coefficients
+    // [group][section][b0, b1, b2, a1, a2][lane], scratch [group][sample][lane]
+    AlignedBuffer<SampleType> state, coefficients, scratch;
+    std::vector<StreamGroup> groups;
+    std::vector<juce::uint32> stream_masks;   // Section slots each stream runs
+    
+    const CascadeKernelSet<SampleType>* kernel_set_ptr = nullptr;
+    CoefficientCache* cache = nullptr;
+    ChannelWorkerPool* worker_pool = nullptr;
+    PendingBlock pending {};
+    ChainCoefficients designed;
+};
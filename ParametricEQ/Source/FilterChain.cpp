@@ -0,0 +1,365 @@
+/*
+  ==============================================================================
+
+    FilterChain.cpp
+
+  ==============================================================================
+*/
+
+#include "FilterChain.h"
+
+ChainSettings::ChainSettings() noexcept
+{
+    for (int band = 0; band < max_bands; ++band)
+        band_freq[(size_t) band] = getDefaultBandFrequency(band);
+    
+    band_gain_db.fill(0.f);
+    band_q.fill(1.f);
+    band_type.fill(Band_Peak);
+    band_topology.fill(Topology_Biquad);
+    band_placement.fill(Placement_Both);
+    band_enabled.fill(false);
+    std::fill(band_enabled.begin(), band_enabled.begin() + default_num_bands, true);
+}
+
+float getDefaultBandFrequency(int band) noexcept
+{
+    static constexpr float original_peaks[] = { 500.f, 750.f, 1200.f };
+    
+    if (band < 3)
+        return original_peaks[band];
+    
+    // The rest spread evenly on a log scale, rounded onto the 1 Hz parameter grid
+    const auto position = (double) (band - 3) / (double) (max_bands - 4);
+    return (float) juce::roundToInt(30.0 * std::pow(16000.0 / 30.0, position));
+}
+
+juce::String getBandParameterID(int band, const char* parameter)
+{
+    return "Peak" + juce::String(band + 1) + " " + parameter;
+}
+
+int getBandForParameterID(const juce::String& parameter_id)
+{
+    if (! parameter_id.startsWith("Peak"))
+        return -1;
+    
+    const auto band = parameter_id.substring(4).getIntValue() - 1;
+    return juce::isPositiveAndBelow(band, max_bands) ? band : -1;
+}
+
+bool isBandNeutral(const ChainSettings& chain_settings, ChainPositions band) noexcept
+{
+    if (band == LowCut) return chain_settings.low_cut_freq <= neutral_low_cut_freq;
+    if (band == HiCut)  return chain_settings.high_cut_freq >= neutral_high_cut_freq;
+    
+    const auto i = (size_t) (band - Band1);
+    
+    if (! chain_settings.band_enabled[i])
+        return true;
+    
+    return chain_settings.band_type[i] != Band_Notch && std::abs(chain_settings.band_gain_db[i]) < 1.0e-3f;
+}
+
+int getBandTopology(const ChainSettings& chain_settings, ChainPositions band) noexcept
+{
+    if (band == LowCut) return chain_settings.low_cut_topology;
+    if (band == HiCut)  return chain_settings.high_cut_topology;
+    
+    return chain_settings.band_topology[(size_t) (band - Band1)];
+}
+
+int getBandPlacement(const ChainSettings& chain_settings, ChainPositions band) noexcept
+{
+    if (chain_settings.stereo_mode == Stereo_Linked) return Placement_Both;
+    if (band == LowCut) return chain_settings.low_cut_placement;
+    if (band == HiCut)  return chain_settings.high_cut_placement;
+    
+    return chain_settings.band_placement[(size_t) (band - Band1)];
+}
+
+// Stores an SVF cut in its cascade slots, with the biquad equivalents alongside
+static void setSvfCut(ChainCoefficients& coefficients, CutCoefficients<double>& biquads, int first_section,
+                      const CutSvfCoefficients<double>& sections, int slope) noexcept
+{
+    for (int i = 0; i < getNumCutSections(slope); ++i)
+    {
+        coefficients.svf[(size_t) (first_section + i)] = sections[(size_t) i];
+        biquads[(size_t) i] = toBiquadCoefficients(sections[(size_t) i]);
+    }
+}
+
+// The other way round, for a cut designed as biquads
+static void setSvfCutFromBiquads(ChainCoefficients& coefficients, const CutCoefficients<double>& biquads, int first_section, int slope) noexcept
+{
+    for (int i = 0; i < getNumCutSections(slope); ++i)
+        coefficients.svf[(size_t) (first_section + i)] = toSvfCoefficients(biquads[(size_t) i]);
+}
+
+// Only the design of the cut's biquads, whatever topology runs them
+static void designCut(CutCoefficients<double>& sections, bool is_low_cut, double sample_rate, float freq, int slope,
+                      int method, CoefficientCache* cache) noexcept
+{
+    if (cache != nullptr && is_low_cut)
+        cache->getLowCut(sections, sample_rate, freq, slope, method);
+    else if (cache != nullptr)
+        cache->getHighCut(sections, sample_rate, freq, slope, method);
+    else if (is_low_cut)
+        makeLowCutCoefficients(sections, sample_rate, freq, slope, method);
+    else
+        makeHighCutCoefficients(sections, sample_rate, freq, slope, method);
+}
+
+// Placement is only bookkeeping, a band's design is the same on either side
+static void setSideBands(const ChainSettings& chain_settings, ChainCoefficients& coefficients, ChainPositions band) noexcept
+{
+    const auto placement = getBandPlacement(chain_settings, band);
+    
+    for (int side = 0; side < 2; ++side)
+    {
+        auto& side_bands = coefficients.side_bands[(size_t) side];
+        
+        if (placement == Placement_Both || placement == Placement_First + side)
+            side_bands |= getBandBit(band);
+        else
+            side_bands &= ~getBandBit(band);
+    }
+}
+
+void designChainCoefficients(const ChainSettings& chain_settings, double sample_rate,
+                             ChainCoefficients& coefficients, int band_mask, CoefficientCache* cache) noexcept
+{
+    // A bilinear state variable filter design is a single tan, cheaper than a
+    // cache lookup. Matched designs are biquads first, whatever runs them.
+    CutSvfCoefficients<double> svf_cut;
+    const auto method = chain_settings.design_method;
+    
+    if (band_mask & getBandBit(LowCut))
+    {
+        const auto slope = chain_settings.low_cut_slope;
+        
+        if (chain_settings.low_cut_topology == Topology_Svf && method == Design_Bilinear)
+        {
+            makeSvfLowCutCoefficients(svf_cut, sample_rate, chain_settings.low_cut_freq, slope);
+            setSvfCut(coefficients, coefficients.low_cut, low_cut_section, svf_cut, slope);
+        }
+        else
+        {
+            designCut(coefficients.low_cut, true, sample_rate, chain_settings.low_cut_freq, slope, method, cache);
+            
+            if (chain_settings.low_cut_topology == Topology_Svf)
+                setSvfCutFromBiquads(coefficients, coefficients.low_cut, low_cut_section, slope);
+        }
+        
+        coefficients.low_cut_slope = slope;
+    }
+    
+    // Neutral bands are left out of the chain, so only those that will run are designed
+    for (int i = 0; i < max_bands; ++i)
+    {
+        const auto band = getBandPosition(i);
+        
+        if ((band_mask & getBandBit(band)) == 0 || isBandNeutral(chain_settings, band))
+            continue;
+        
+        auto& c = coefficients.bands[(size_t) i];
+        const auto type = chain_settings.band_type[(size_t) i];
+        const auto freq = chain_settings.band_freq[(size_t) i];
+        const auto q = chain_settings.band_q[(size_t) i];
+        const auto gain_db = chain_settings.band_gain_db[(size_t) i];
+        
+        const auto is_svf = chain_settings.band_topology[(size_t) i] == Topology_Svf;
+        auto& svf = coefficients.svf[(size_t) (band_section + i)];
+        
+        if (is_svf && (method == Design_Bilinear || type != Band_Peak))
+        {
+            makeSvfBandCoefficients(svf, type, sample_rate, freq, q, gain_db);
+            c = toBiquadCoefficients(svf);
+            continue;
+        }
+        
+        if (cache != nullptr)
+            cache->getBand(c, type, sample_rate, freq, q, gain_db, method);
+        else
+            makeBandCoefficients(c, type, sample_rate, freq, q, gain_db, method);
+        
+        if (is_svf)
+            svf = toSvfCoefficients(c);
+    }
+    
+    if (band_mask & getBandBit(HiCut))
+    {
+        const auto slope = chain_settings.high_cut_slope;
+        
+        if (chain_settings.high_cut_topology == Topology_Svf && method == Design_Bilinear)
+        {
+            makeSvfHighCutCoefficients(svf_cut, sample_rate, chain_settings.high_cut_freq, slope);
+            setSvfCut(coefficients, coefficients.high_cut, high_cut_section, svf_cut, slope);
+        }
+        else
+        {
+            designCut(coefficients.high_cut, false, sample_rate, chain_settings.high_cut_freq, slope, method, cache);
+            
+            if (chain_settings.high_cut_topology == Topology_Svf)
+                setSvfCutFromBiquads(coefficients, coefficients.high_cut, high_cut_section, slope);
+        }
+        
+        coefficients.high_cut_slope = slope;
+    }
+    
+    for (int position = LowCut; position <= HiCut; ++position)
+    {
+        const auto band = static_cast<ChainPositions>(position);
+        
+        if ((band_mask & getBandBit(band)) == 0)
+            continue;
+        
+        if (isBandNeutral(chain_settings, band))
+            coefficients.neutral_bands |= getBandBit(band);
+        else
+            coefficients.neutral_bands &= ~getBandBit(band);
+        
+        if (getBandTopology(chain_settings, band) == Topology_Svf)
+            coefficients.svf_bands |= getBandBit(band);
+        else
+            coefficients.svf_bands &= ~getBandBit(band);
+        
+        setSideBands(chain_settings, coefficients, band);
+    }
+    
+    coefficients.mid_side = chain_settings.stereo_mode == Stereo_MidSide;
+}
+
+void setStereoLayout(const ChainSettings& chain_settings, ChainCoefficients& coefficients) noexcept
+{
+    for (int position = LowCut; position <= HiCut; ++position)
+        setSideBands(chain_settings, coefficients, static_cast<ChainPositions>(position));
+    
+    coefficients.mid_side = chain_settings.stereo_mode == Stereo_MidSide;
+}
+
+juce::uint32 getActiveSectionMask(const ChainCoefficients& coefficients) noexcept
+{
+    juce::uint32 mask = 0;
+    
+    auto add_sections = [&mask](int first_section, int num_sections)
+    {
+        mask |= ((1u << num_sections) - 1) << first_section;
+    };
+    
+    if (coefficients.isActive(LowCut))
+        add_sections(low_cut_section, getNumCutSections(coefficients.low_cut_slope));
+    
+    for (int i = 0; i < max_bands; ++i)
+        if (coefficients.isActive(getBandPosition(i)))
+            add_sections(band_section + i, 1);
+    
+    if (coefficients.isActive(HiCut))
+        add_sections(high_cut_section, getNumCutSections(coefficients.high_cut_slope));
+    
+    return mask;
+}
+
+const BiquadCoefficients<double>& getSectionCoefficients(const ChainCoefficients& coefficients, int section) noexcept
+{
+    if (section < band_section)      return coefficients.low_cut[(size_t) (section - low_cut_section)];
+    if (section < high_cut_section)  return coefficients.bands[(size_t) (section - band_section)];
+    
+    return coefficients.high_cut[(size_t) (section - high_cut_section)];
+}
+
+// Calls function(section) for every section in mask, in chain order
+template <typename Function>
+static void forEachSection(juce::uint32 mask, Function&& function)
+{
+    for (int section = 0; section < num_chain_sections; ++section)
+        if (mask & (1u << section))
+            function(section);
+}
+
+juce::uint32 getSvfSectionMask(const ChainCoefficients& coefficients) noexcept
+{
+    juce::uint32 mask = 0;
+    
+    for (int position = LowCut; position <= HiCut; ++position)
+        if (coefficients.isSvf(static_cast<ChainPositions>(position)))
+            mask |= getBandSectionMask(static_cast<ChainPositions>(position));
+    
+    return mask & getActiveSectionMask(coefficients);
+}
+
+juce::uint32 getSideSectionMask(const ChainCoefficients& coefficients, int side) noexcept
+{
+    juce::uint32 mask = 0;
+    
+    for (int position = LowCut; position <= HiCut; ++position)
+        if (coefficients.side_bands[(size_t) side] & getBandBit(static_cast<ChainPositions>(position)))
+            mask |= getBandSectionMask(static_cast<ChainPositions>(position));
+    
+    return mask;
+}
+
+juce::uint32 getPrecisionCriticalSectionMask(const ChainCoefficients& coefficients) noexcept
+{
+    juce::uint32 mask = 0;
+    
+    forEachSection(getActiveSectionMask(coefficients), [&](int section)
+    {
+        const auto& c = getSectionCoefficients(coefficients, section);
+        
+        if (1.0 + c.a1 + c.a2 < precision_critical_threshold)
+            mask |= 1u << section;
+    });
+    
+    return mask;
+}
+
+// Only the sections that run are copied, the rest get theirs when they come back
+template <typename SampleType>
+void applyChainCoefficients(FilterChain<SampleType>& chain, const ChainCoefficients& coefficients) noexcept
+{
+    const auto mask = getActiveSectionMask(coefficients);
+    const auto svf_mask = getSvfSectionMask(coefficients);
+    
+    forEachSection(mask, [&](int section)
+    {
+        if (svf_mask & (1u << section))
+            chain.setSvfCoefficients(section, coefficients.svf[(size_t) section]);
+        else
+            chain.setCoefficients(section, getSectionCoefficients(coefficients, section));
+    });
+    
+    chain.setSides(getSideSectionMask(coefficients, 0), getSideSectionMask(coefficients, 1), coefficients.mid_side);
+    chain.setActiveSections(mask, getPrecisionCriticalSectionMask(coefficients), svf_mask);
+}
+
+template void applyChainCoefficients<float>(FilterChain<float>&, const ChainCoefficients&) noexcept;
+template void applyChainCoefficients<double>(FilterChain<double>&, const ChainCoefficients&) noexcept;
+
+double getChainTailSeconds(const ChainCoefficients& coefficients, double sample_rate, double decay_db) noexcept
+{
+    // The slowest pole dominates, each further section adds at most a little on top
+    double tail_samples = 0, longest = 0;
+    
+    forEachActiveSection(coefficients, [&](const BiquadCoefficients<double>& c)
+    {
+        // Poles are the roots of z^2 + a1 z + a2
+        const auto a1 = c.a1, a2 = c.a2;
+        const auto discriminant = a1 * a1 - 4.0 * a2;
+        const auto radius = discriminant < 0.0 ? std::sqrt(a2)
+                                               : 0.5 * (std::abs(a1) + std::sqrt(discriminant));
+        
+        if (radius <= 0.0)
+            return;
+        
+        // Unstable or on the unit circle shouldn't happen, cap it rather than report forever
+        const auto decay_per_sample_db = -20.0 * std::log10(juce::jmin(radius, 0.999999));
+        const auto section_samples = decay_db / decay_per_sample_db;
+        longest = juce::jmax(longest, section_samples);
+        tail_samples += section_samples;
+    });
+    
+    tail_samples = longest + 0.25 * (tail_samples - longest);
+    
+    return sample_rate > 0.0 ? tail_samples / sample_rate : 0.0;
+}
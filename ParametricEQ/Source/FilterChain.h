@@ -0,0 +1,416 @@
+/*
+  ==============================================================================
+
+    FilterChain.h
+
+    The EQ's filter chain, independent of juce::AudioProcessor so the same
+    DSP can run in the plugin and in headless tools.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BiquadCascade.h"
+#include "CoefficientCache.h"
+#include "StateVariableFilter.h"
+
+// To help with slope int expressions
+enum Slope
+{
+    Slope_12,
+    Slope_24,
+    Slope_36,
+    Slope_48
+};
+
+// How a band is run: in the fused biquad cascade, or as state variable
+// filters whose coefficients ramp per sample (cheaper to modulate)
+enum FilterTopology
+{
+    Topology_Biquad,
+    Topology_Svf
+};
+
+// How the two channels of a stereo bus are EQ'd: through the same bands,
+// left and right each through their own, or mid and side each through
+// their own. Only stereo buses have sides, anything else runs linked.
+enum StereoMode
+{
+    Stereo_Linked,
+    Stereo_LeftRight,
+    Stereo_MidSide
+};
+
+// The channel of the pair a band runs on when the mode isn't linked: both,
+// the first (left or mid) or the second (right or side)
+enum StereoPlacement
+{
+    Placement_Both,
+    Placement_First,
+    Placement_Second
+};
+
+// Parametric bands between the two cuts, and how many a new instance has on
+static constexpr int max_bands = 24;
+static constexpr int default_num_bands = 3;
+
+// Settings at which a band does nothing and is taken out of the chain: a
+// disabled band, a band other than a notch at 0 dB, or a cut at the end
+// of its parameter range
+static constexpr float neutral_low_cut_freq = 20.f;
+static constexpr float neutral_high_cut_freq = 20000.f;
+
+// Get plugin parameters. The parametric bands are stored one array per
+// parameter so the design and smoothing loops walk them contiguously.
+// Defaults match the parameter layout.
+struct ChainSettings
+{
+    ChainSettings() noexcept;
+    
+    std::array<float, max_bands> band_freq, band_gain_db, band_q;
+    std::array<int, max_bands> band_type, band_topology, band_placement;
+    std::array<bool, max_bands> band_enabled;
+    float low_cut_freq { neutral_low_cut_freq }, high_cut_freq { neutral_high_cut_freq };
+    int low_cut_slope { Slope::Slope_12 }, high_cut_slope { Slope::Slope_12 };
+    int low_cut_topology { Topology_Biquad }, high_cut_topology { Topology_Biquad };
+    int low_cut_placement { Placement_Both }, high_cut_placement { Placement_Both };
+    int design_method { Design_Bilinear };   // For peaks and cuts, see DesignMethod
+    int stereo_mode { Stereo_Linked };
+};
+
+// The first three bands keep the frequencies of the original three peaks
+float getDefaultBandFrequency(int band) noexcept;
+
+// Parameter IDs of the parametric bands (band is 0 based, parameter is
+// "Freq", "Gain", "Q", "Type", "Enabled", "Placement" ...). They keep the "PeakN" form
+// from when every band was a peak, so older sessions still load.
+juce::String getBandParameterID(int band, const char* parameter);
+
+// The band (0 based) a parameter ID belongs to, -1 for anything else
+int getBandForParameterID(const juce::String& parameter_id);
+
+// Order of audio chain: the low cut, the parametric bands, the high cut
+enum ChainPositions
+{
+    LowCut,
+    Band1,
+    HiCut = Band1 + max_bands
+};
+
+constexpr ChainPositions getBandPosition(int band) noexcept { return static_cast<ChainPositions>(Band1 + band); }
+
+// One bit per ChainPositions entry
+constexpr int getBandBit(ChainPositions position) noexcept { return 1 << position; }
+static constexpr int all_bands = (1 << (HiCut + 1)) - 1;
+
+// Sections of the fused cascade: four for each cut filter, one per band.
+// Only the active ones run, through a kernel specialised for their count.
+static constexpr int low_cut_section = 0;
+static constexpr int band_section = low_cut_section + max_cut_sections;
+static constexpr int high_cut_section = band_section + max_bands;
+static constexpr int num_chain_sections = high_cut_section + max_cut_sections;
+
+static_assert(num_chain_sections <= max_cascade_sections, "Every section needs a bit in the cascade's mask");
+
+// The cascade sections that belong to one band
+constexpr juce::uint32 getBandSectionMask(ChainPositions band) noexcept
+{
+    return band == LowCut ? ((1u << max_cut_sections) - 1) << low_cut_section
+         : band == HiCut  ? ((1u << max_cut_sections) - 1) << high_cut_section
+                          : 1u << (band_section + band - Band1);
+}
+
+bool isBandNeutral(const ChainSettings& chain_settings, ChainPositions band) noexcept;
+
+// The FilterTopology of any chain position
+int getBandTopology(const ChainSettings& chain_settings, ChainPositions band) noexcept;
+
+// The StereoPlacement of any chain position, Placement_Both when linked
+int getBandPlacement(const ChainSettings& chain_settings, ChainPositions band) noexcept;
+
+// A complete set of designed coefficients for one FilterChain. Designs are
+// kept in double whatever the chain runs in, applyChainCoefficients rounds
+// them to the chain's sample type. Bands run as state variable filters also
+// get their biquad equivalent, so the response, tail and linear phase
+// kernel don't need to know which topology a band uses.
+struct ChainCoefficients
+{
+    CutCoefficients<double> low_cut {}, high_cut {};
+    std::array<BiquadCoefficients<double>, max_bands> bands {};
+    std::array<SvfCoefficients<double>, num_chain_sections> svf {};   // By cascade section
+    int low_cut_slope { Slope::Slope_12 }, high_cut_slope { Slope::Slope_12 };
+    int neutral_bands { 0 };   // ChainPositions bits, skipped when processing
+    int svf_bands { 0 };       // ChainPositions bits, run as state variable filters
+    
+    // ChainPositions bits of the bands each channel of a stereo pair runs,
+    // the pair being left and right, or mid and side
+    std::array<int, 2> side_bands { all_bands, all_bands };
+    bool mid_side { false };
+    
+    bool isActive(ChainPositions band) const noexcept { return (neutral_bands & getBandBit(band)) == 0; }
+    bool isSvf(ChainPositions band) const noexcept    { return (svf_bands & getBandBit(band)) != 0; }
+};
+
+// Calls function(section) for every section the chain would run, in chain
+// order, leaving out the bands that aren't in band_mask
+template <typename Function>
+void forEachActiveSection(const ChainCoefficients& coefficients, Function&& function, int band_mask = all_bands)
+{
+    const auto runs = [&](ChainPositions band) { return coefficients.isActive(band) && (band_mask & getBandBit(band)) != 0; };
+    
+    if (runs(LowCut))
+        for (int i = 0; i < getNumCutSections(coefficients.low_cut_slope); ++i)
+            function(coefficients.low_cut[(size_t) i]);
+    
+    for (int i = 0; i < max_bands; ++i)
+        if (runs(getBandPosition(i)))
+            function(coefficients.bands[(size_t) i]);
+    
+    if (runs(HiCut))
+        for (int i = 0; i < getNumCutSections(coefficients.high_cut_slope); ++i)
+            function(coefficients.high_cut[(size_t) i]);
+}
+
+// The cascade sections a coefficient set runs, for BiquadCascade::setActiveSections
+juce::uint32 getActiveSectionMask(const ChainCoefficients& coefficients) noexcept;
+
+// The designed section that goes into one cascade slot
+const BiquadCoefficients<double>& getSectionCoefficients(const ChainCoefficients& coefficients, int section) noexcept;
+
+// The active sections that belong to state variable filter bands
+juce::uint32 getSvfSectionMask(const ChainCoefficients& coefficients) noexcept;
+
+// The sections one channel of a stereo pair runs (side 0 or 1), for FilterChain::setSides
+juce::uint32 getSideSectionMask(const ChainCoefficients& coefficients, int side) noexcept;
+
+// Poles this close to z = 1 lose too much to float rounding. 1 + a1 + a2 is
+// |1 - p|^2, about (2 pi f / sample_rate)^2, so this is a corner or centre
+// below roughly sample_rate / 200.
+static constexpr double precision_critical_threshold = 1.0e-3;
+
+// The active sections whose state needs double precision, see FilterChain
+juce::uint32 getPrecisionCriticalSectionMask(const ChainCoefficients& coefficients) noexcept;
+
+//==============================================================================
+// One chain for every channel, channels run side by side in SIMD lanes.
+// Mixed precision keeps float I/O but runs the precision critical sections
+// in a double cascade over a copy of the block. The sections are linear and
+// time invariant, so pulling them out into their own pass doesn't change
+// the response. State variable filter bands run in a pass of their own
+// after the cascades, for the same reason. A stereo chain can give each
+// channel, or mid and side, its own subset of the sections, see setSides.
+template <typename SampleType>
+class FilterChain
+{
+public:
+    // Allocates state and scratch, call from prepareToPlay. Mixed precision
+    // only means something for a float chain.
+    void prepare(int num_channels, int max_block_size, bool use_mixed_precision = false)
+    {
+        mixed_precision = use_mixed_precision && std::is_same<SampleType, float>::value;
+        
+        cascade.prepare(num_channels, max_block_size);
+        precise_cascade.prepare(mixed_precision ? num_channels : 0, max_block_size);
+        precise_buffer.setSize(mixed_precision ? num_channels : 0, max_block_size);
+        svf_cascade.prepare(num_channels, max_block_size);
+    }
+    
+    void reset() noexcept
+    {
+        cascade.reset();
+        precise_cascade.reset();
+        svf_cascade.reset();
+    }
+    
+    void resetSections(juce::uint32 mask) noexcept
+    {
+        cascade.resetSections(mask);
+        precise_cascade.resetSections(mask);
+        svf_cascade.resetSections(mask);
+    }
+    
+    // Both chains must be prepared the same way, never allocates
+    void copyFrom(const FilterChain& other) noexcept
+    {
+        jassert(other.mixed_precision == mixed_precision);
+        
+        cascade.copyFrom(other.cascade);
+        precise_cascade.copyFrom(other.precise_cascade);
+        svf_cascade.copyFrom(other.svf_cascade);
+        active_mask = other.active_mask;
+        side_masks = other.side_masks;
+        mid_side = other.mid_side;
+    }
+    
+    void setCoefficients(int section, const BiquadCoefficients<double>& new_coefficients) noexcept
+    {
+        cascade.setCoefficients(section, convertCoefficients<SampleType>(new_coefficients));
+        
+        if (mixed_precision)
+            precise_cascade.setCoefficients(section, new_coefficients);
+    }
+    
+    // A running section ramps to these over the next process call
+    void setSvfCoefficients(int section, const SvfCoefficients<double>& new_coefficients) noexcept
+    {
+        svf_cascade.setCoefficients(section, new_coefficients);
+    }
+    
+    // Sections in both mask and precision_critical_mask run in double when
+    // mixed precision is on, those in svf_mask as state variable filters
+    void setActiveSections(juce::uint32 mask, juce::uint32 precision_critical_mask = 0, juce::uint32 svf_mask = 0) noexcept
+    {
+        svf_cascade.setActiveSections(mask & svf_mask);
+        mask &= ~svf_mask;
+        
+        const auto precise_mask = mixed_precision ? (mask & precision_critical_mask) : 0u;
+        const auto old_precise_mask = precise_cascade.getActiveSections();
+        
+        // A section crossing the threshold carries its state over, so moving
+        // a corner past it doesn't click
+        if (precise_mask != old_precise_mask)
+            moveSectionStates(precise_mask & ~old_precise_mask & active_mask, old_precise_mask & ~precise_mask);
+        
+        active_mask = mask;
+        precise_cascade.setActiveSections(precise_mask);
+        cascade.setActiveSections(mask & ~precise_mask);
+    }
+    
+    // The sections the first and second channel run (left and right, or mid
+    // and side with use_mid_side). Only a stereo chain has sides, any
+    // other runs every section on every channel.
+    void setSides(juce::uint32 first_mask, juce::uint32 second_mask, bool use_mid_side) noexcept
+    {
+        side_masks = { first_mask, second_mask };
+        mid_side = use_mid_side;
+        
+        if (cascade.getNumChannels() != 2)
+        {
+            first_mask = second_mask = ~0u;
+            use_mid_side = false;
+        }
+        
+        cascade.setSides(first_mask, second_mask, use_mid_side);
+        precise_cascade.setSides(first_mask, second_mask, use_mid_side);
+        svf_cascade.setSides(first_mask, second_mask, use_mid_side);
+    }
+    
+    // As last set, whether or not the chain is stereo
+    juce::uint32 getSideSections(int side) const noexcept { return side_masks[(size_t) side]; }
+    bool isMidSide() const noexcept                       { return mid_side; }
+    
+    // Every running section, whichever topology runs it
+    juce::uint32 getActiveSections() const noexcept { return active_mask | svf_cascade.getActiveSections(); }
+    juce::uint32 getDoublePrecisionSections() const noexcept { return precise_cascade.getActiveSections(); }
+    juce::uint32 getSvfSections() const noexcept { return svf_cascade.getActiveSections(); }
+    
+    void setWorkerPool(ChannelWorkerPool* new_pool) noexcept
+    {
+        cascade.setWorkerPool(new_pool);
+        precise_cascade.setWorkerPool(new_pool);
+    }
+    
+    int getNumChannelGroups() const noexcept            { return cascade.getNumChannelGroups(); }
+    const char* getInstructionSetName() const noexcept  { return cascade.getInstructionSetName(); }
+    
+    void process(SampleType* const* channels, int num_channels, int num_samples) noexcept
+    {
+        process(channels, num_channels, 0, num_samples);
+    }
+    
+    void process(SampleType* const* channels, int num_channels, int start_sample, int num_samples) noexcept
+    {
+        if (precise_cascade.getNumActiveSections() > 0)
+            processPrecise(channels, num_channels, start_sample, num_samples);
+        
+        if (cascade.getNumActiveSections() > 0)
+            cascade.process(channels, num_channels, start_sample, num_samples);
+        
+        svf_cascade.process(channels, num_channels, start_sample, num_samples);
+    }
+    
+    // Runs one band on its own, for timing the stages separately. Running
+    // every band in chain order gives the same output as process.
+    void processBand(ChainPositions band, SampleType* const* channels, int num_channels, int start_sample, int num_samples) noexcept
+    {
+        const auto mask = cascade.getActiveSections();
+        const auto precise_mask = precise_cascade.getActiveSections();
+        const auto svf_mask = svf_cascade.getActiveSections();
+        const auto band_mask = getBandSectionMask(band);
+        
+        cascade.setActiveSections(mask & band_mask);
+        precise_cascade.setActiveSections(precise_mask & band_mask);
+        svf_cascade.setActiveSections(svf_mask & band_mask);
+        process(channels, num_channels, start_sample, num_samples);
+        cascade.setActiveSections(mask);
+        precise_cascade.setActiveSections(precise_mask);
+        svf_cascade.setActiveSections(svf_mask);
+    }
+    
+private:
+    void moveSectionStates(juce::uint32 to_precise, juce::uint32 from_precise) noexcept
+    {
+        for (int section = 0; section < num_chain_sections; ++section)
+        {
+            for (int ch = 0; ch < cascade.getNumChannels(); ++ch)
+            {
+                if (to_precise & (1u << section))
+                {
+                    const auto s = cascade.getSectionState(section, ch);
+                    precise_cascade.setSectionState(section, ch, { (double) s.first, (double) s.second });
+                }
+                else if (from_precise & (1u << section))
+                {
+                    const auto s = precise_cascade.getSectionState(section, ch);
+                    cascade.setSectionState(section, ch, { (SampleType) s.first, (SampleType) s.second });
+                }
+            }
+        }
+    }
+    
+    void processPrecise(SampleType* const* channels, int num_channels, int start_sample, int num_samples) noexcept
+    {
+        const auto chunk_size = precise_buffer.getNumSamples();
+        
+        for (int offset = start_sample; offset < start_sample + num_samples; offset += chunk_size)
+        {
+            const auto chunk = juce::jmin(chunk_size, start_sample + num_samples - offset);
+            
+            for (int ch = 0; ch < num_channels; ++ch)
+                std::copy(channels[ch] + offset, channels[ch] + offset + chunk, precise_buffer.getWritePointer(ch));
+            
+            precise_cascade.process(precise_buffer.getArrayOfWritePointers(), num_channels, 0, chunk);
+            
+            for (int ch = 0; ch < num_channels; ++ch)
+                std::transform(precise_buffer.getReadPointer(ch), precise_buffer.getReadPointer(ch) + chunk, channels[ch] + offset,
+                               [](double v) { return static_cast<SampleType>(v); });
+        }
+    }
+    
+    BiquadCascade<num_chain_sections, SampleType> cascade;
+    BiquadCascade<num_chain_sections, double> precise_cascade;
+    StateVariableCascade<num_chain_sections, SampleType> svf_cascade;
+    juce::AudioBuffer<double> precise_buffer;
+    juce::uint32 active_mask { 0 };
+    std::array<juce::uint32, 2> side_masks { ~0u, ~0u };
+    bool mixed_precision { false }, mid_side { false };
+};
+
+// Time for the chain's impulse response to decay by decay_db, from the
+// slowest pole of every active section. 0 when every band is neutral.
+double getChainTailSeconds(const ChainCoefficients& coefficients, double sample_rate, double decay_db = 120.0) noexcept;
+
+// Redesign the bands in band_mask, never allocates. With a cache, settings
+// already seen at this sample rate are looked up instead of designed.
+void designChainCoefficients(const ChainSettings& chain_settings, double sample_rate,
+                             ChainCoefficients& coefficients, int band_mask = all_bands,
+                             CoefficientCache* cache = nullptr) noexcept;
+
+// Every position's side and the mid / side flag, which need no design
+void setStereoLayout(const ChainSettings& chain_settings, ChainCoefficients& coefficients) noexcept;
+
+// Copy a designed set into a chain, never allocates
+template <typename SampleType>
+void applyChainCoefficients(FilterChain<SampleType>& chain, const ChainCoefficients& coefficients) noexcept;
@@ -0,0 +1,217 @@
+/*
+  ==============================================================================
+
+    Instrumentation.cpp
+
+  ==============================================================================
+*/
+
+#include "Instrumentation.h"
+
+#include <cstdlib>
+#include <new>
+
+void DurationHistogram::add(double nanoseconds) noexcept
+{
+    auto& bucket = buckets[(size_t) getBucket(nanoseconds)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    
+    if (nanoseconds > max_ns.load(std::memory_order_relaxed))
+        max_ns.store(nanoseconds, std::memory_order_relaxed);
+}
+
+double DurationHistogram::getPercentile(double fraction) const noexcept
+{
+    std::array<juce::uint32, num_buckets> counts;
+    juce::uint64 total = 0;
+    
+    for (size_t i = 0; i < counts.size(); ++i)
+        total += counts[i] = buckets[i].load(std::memory_order_relaxed);
+    
+    if (total == 0)
+        return 0.0;
+    
+    // The first bucket that brings the running count to the target
+    const auto target = juce::jmax((juce::uint64) 1, (juce::uint64) std::ceil(fraction * (double) total));
+    juce::uint64 running = 0;
+    
+    for (int i = 0; i < num_buckets; ++i)
+    {
+        running += counts[(size_t) i];
+        
+        if (running >= target)
+            return juce::jmin(getBucketUpperBound(i), getMax());
+    }
+    
+    return getMax();
+}
+
+void DurationHistogram::reset() noexcept
+{
+    for (auto& bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    
+    count.store(0, std::memory_order_relaxed);
+    max_ns.store(0, std::memory_order_relaxed);
+}
+
+int DurationHistogram::getBucket(double nanoseconds) noexcept
+{
+    if (! (nanoseconds > min_ns))
+        return 0;
+    
+    return juce::jmin(num_buckets - 1, (int) (std::log2(nanoseconds / min_ns) * buckets_per_octave));
+}
+
+double DurationHistogram::getBucketUpperBound(int bucket) noexcept
+{
+    return min_ns * std::exp2((double) (bucket + 1) / buckets_per_octave);
+}
+
+//==============================================================================
+std::atomic<bool> RealtimeMonitor::fail_on_violation { false };
+
+// The monitor the calling thread is reporting to, null outside a realtime scope
+static thread_local RealtimeMonitor* current_monitor = nullptr;
+
+RealtimeMonitor::ScopedRealtime::ScopedRealtime(RealtimeMonitor& monitor, bool is_active) noexcept
+    : previous(current_monitor), active(instrumentation_enabled && is_active)
+{
+    if (active)
+        current_monitor = &monitor;
+}
+
+RealtimeMonitor::ScopedRealtime::ScopedRealtime(RealtimeMonitor* monitor) noexcept
+    : previous(current_monitor), active(instrumentation_enabled && monitor != nullptr)
+{
+    if (active)
+        current_monitor = monitor;
+}
+
+RealtimeMonitor::ScopedRealtime::~ScopedRealtime()
+{
+    if (active)
+        current_monitor = previous;
+}
+
+RealtimeMonitor* RealtimeMonitor::getCurrent() noexcept
+{
+    return current_monitor;
+}
+
+void RealtimeMonitor::noteAllocation() noexcept
+{
+    if (auto* monitor = current_monitor)
+    {
+        monitor->allocations.fetch_add(1, std::memory_order_relaxed);
+        violation("heap allocation");
+    }
+}
+
+void RealtimeMonitor::noteLock() noexcept
+{
+    if (auto* monitor = current_monitor)
+    {
+        monitor->locks.fetch_add(1, std::memory_order_relaxed);
+        violation("lock");
+    }
+}
+
+void RealtimeMonitor::violation(const char* what) noexcept
+{
+    if (! fail_on_violation.load(std::memory_order_relaxed))
+        return;
+    
+    // Stop reporting first, the logging below may allocate
+    current_monitor = nullptr;
+    juce::Logger::outputDebugString(juce::String("Realtime violation: ") + what + " on the audio thread");
+    std::abort();
+}
+
+//==============================================================================
+ProcessorInstrumentation::Snapshot ProcessorInstrumentation::getSnapshot() const noexcept
+{
+    auto timing = [](const DurationHistogram& histogram)
+    {
+        Timing t;
+        t.p50_ns = histogram.getPercentile(0.5);
+        t.p99_ns = histogram.getPercentile(0.99);
+        t.max_ns = histogram.getMax();
+        t.count = histogram.getCount();
+        return t;
+    };
+    
+    Snapshot snapshot;
+    snapshot.block = timing(block_time);
+    
+    for (size_t i = 0; i < stage_time.size(); ++i)
+        snapshot.stages[i] = timing(stage_time[i]);
+    
+    snapshot.designed_bands = designed_bands.load(std::memory_order_relaxed);
+    snapshot.smoothed_bands = smoothed_bands.load(std::memory_order_relaxed);
+    snapshot.coefficient_loads = coefficient_loads.load(std::memory_order_relaxed);
+    snapshot.allocations = monitor.getNumAllocations();
+    snapshot.locks = monitor.getNumLocks();
+    return snapshot;
+}
+
+void ProcessorInstrumentation::reset() noexcept
+{
+    block_time.reset();
+    
+    for (auto& histogram : stage_time)
+        histogram.reset();
+    
+    designed_bands = 0;
+    smoothed_bands = 0;
+    coefficient_loads = 0;
+    monitor.reset();
+}
+
+//==============================================================================
+#if PARAMETRIC_EQ_INSTRUMENTATION
+
+// Every C++ allocation in the process passes through here. The aligned
+// overloads aren't replaced, nothing in the audio path uses them.
+void* operator new(std::size_t size)
+{
+    RealtimeMonitor::noteAllocation();
+    
+    if (auto* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    RealtimeMonitor::noteAllocation();
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept
+{
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p != nullptr)
+        RealtimeMonitor::noteAllocation();
+    
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept                          { operator delete(p); }
+void operator delete(void* p, std::size_t) noexcept               { operator delete(p); }
+void operator delete[](void* p, std::size_t) noexcept             { operator delete(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept     { operator delete(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept   { operator delete(p); }
+
+#endif
@@ -0,0 +1,188 @@
+/*
+  ==============================================================================
+
+    Instrumentation.h
+
+    Optional realtime-safety and performance instrumentation, compiled in
+    with PARAMETRIC_EQ_INSTRUMENTATION=1 (a Projucer preprocessor
+    definition). Off by default, in which case the recording below folds
+    away to nothing and the allocation hooks aren't built.
+
+    DurationHistogram keeps log spaced counts of how long something took,
+    written by one thread with relaxed atomics and read from any other.
+    RealtimeMonitor counts heap and lock activity on a thread while that
+    thread is inside a realtime scope: allocations are caught by replacing
+    the global operator new / delete (so direct malloc, e.g. HeapBlock,
+    isn't seen), locks only where the plugin's own code marks them with
+    PARAMETRIC_EQ_NOTE_LOCK. In test mode the first violation aborts.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+#ifndef PARAMETRIC_EQ_INSTRUMENTATION
+ #define PARAMETRIC_EQ_INSTRUMENTATION 0
+#endif
+
+#if PARAMETRIC_EQ_INSTRUMENTATION
+ #define PARAMETRIC_EQ_NOTE_LOCK() RealtimeMonitor::noteLock()
+#else
+ #define PARAMETRIC_EQ_NOTE_LOCK()
+#endif
+
+// Everything below compiles either way, the recording folds away when this is false
+static constexpr bool instrumentation_enabled = PARAMETRIC_EQ_INSTRUMENTATION != 0;
+
+class DurationHistogram
+{
+public:
+    DurationHistogram() { reset(); }
+    
+    // One writer only
+    void add(double nanoseconds) noexcept;
+    
+    // Any thread. Values are accurate to the bucket width (about 9%).
+    double getPercentile(double fraction) const noexcept;
+    double getMax() const noexcept         { return max_ns.load(std::memory_order_relaxed); }
+    juce::uint64 getCount() const noexcept { return count.load(std::memory_order_relaxed); }
+    
+    // Racy against the writer, a block recorded meanwhile may be half counted
+    void reset() noexcept;
+    
+    // Times its own lifetime into a histogram
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(DurationHistogram& h) noexcept : histogram(h)
+        {
+            if constexpr (instrumentation_enabled)
+                start = juce::Time::getHighResolutionTicks();
+        }
+        
+        ~ScopedTimer()
+        {
+            if constexpr (instrumentation_enabled)
+                histogram.add(ticksToNanoseconds(juce::Time::getHighResolutionTicks() - start));
+        }
+        
+    private:
+        DurationHistogram& histogram;
+        juce::int64 start { 0 };
+    };
+    
+    static double ticksToNanoseconds(juce::int64 ticks) noexcept
+    {
+        return (double) ticks * 1.0e9 / (double) juce::Time::getHighResolutionTicksPerSecond();
+    }
+    
+private:
+    // 8 buckets per octave from 16 ns to about 17 s
+    static constexpr int buckets_per_octave = 8, num_octaves = 30;
+    static constexpr int num_buckets = buckets_per_octave * num_octaves;
+    static constexpr double min_ns = 16.0;
+    
+    static int getBucket(double nanoseconds) noexcept;
+    static double getBucketUpperBound(int bucket) noexcept;
+    
+    std::array<std::atomic<juce::uint32>, num_buckets> buckets;
+    std::atomic<juce::uint64> count { 0 };
+    std::atomic<double> max_ns { 0 };
+    
+    JUCE_DECLARE_NON_COPYABLE (DurationHistogram)
+};
+
+//==============================================================================
+class RealtimeMonitor
+{
+public:
+    // Heap or lock activity on this thread counts against the monitor while
+    // one of these is alive. Inactive scopes (e.g. offline renders) do nothing.
+    class ScopedRealtime
+    {
+    public:
+        ScopedRealtime(RealtimeMonitor& monitor, bool active) noexcept;
+        explicit ScopedRealtime(RealtimeMonitor* monitor) noexcept;   // Inactive when null
+        ~ScopedRealtime();
+        
+    private:
+        RealtimeMonitor* previous;
+        bool active;
+    };
+    
+    // The monitor this thread reports to, null outside a realtime scope.
+    // Helper threads use it to report to the same one, see ChannelWorkerPool.
+    static RealtimeMonitor* getCurrent() noexcept;
+    
+    // Called by the operator new / delete replacements and by PARAMETRIC_EQ_NOTE_LOCK
+    static void noteAllocation() noexcept;
+    static void noteLock() noexcept;
+    
+    // Test mode, process wide: abort on the first violation instead of counting it
+    static void setFailOnViolation(bool should_fail) noexcept { fail_on_violation = should_fail; }
+    static bool isFailingOnViolation() noexcept               { return fail_on_violation.load(); }
+    
+    juce::uint64 getNumAllocations() const noexcept { return allocations.load(std::memory_order_relaxed); }
+    juce::uint64 getNumLocks() const noexcept       { return locks.load(std::memory_order_relaxed); }
+    
+    void reset() noexcept
+    {
+        allocations = 0;
+        locks = 0;
+    }
+    
+private:
+    static void violation(const char* what) noexcept;
+    
+    std::atomic<juce::uint64> allocations { 0 }, locks { 0 };
+    
+    static std::atomic<bool> fail_on_violation;
+};
+
+//==============================================================================
+// What one processor instance records, see ParametricEQAudioProcessor::getInstrumentation
+class ProcessorInstrumentation
+{
+public:
+    static constexpr int num_stages = 26;   // one per band, in ChainPositions order
+    
+    struct Timing
+    {
+        double p50_ns { 0 }, p99_ns { 0 }, max_ns { 0 };
+        juce::uint64 count { 0 };
+    };
+    
+    struct Snapshot
+    {
+        bool enabled { instrumentation_enabled };
+        Timing block;                              // per host block
+        std::array<Timing, num_stages> stages;     // per chain pass, a sub-block when smoothing
+        juce::uint64 designed_bands { 0 }, smoothed_bands { 0 }, coefficient_loads { 0 };
+        juce::uint64 allocations { 0 }, locks { 0 };   // news, deletes and locks on the audio thread while live
+    };
+    
+    Snapshot getSnapshot() const noexcept;
+    void reset() noexcept;
+    
+    // Stages are timed by running the bands as separate passes instead of
+    // the one fused pass, which costs a little. Off times the fused chain.
+    void setStageTiming(bool should_time_stages) noexcept { stage_timing = should_time_stages; }
+    bool isStageTiming() const noexcept                   { return instrumentation_enabled && stage_timing.load(std::memory_order_relaxed); }
+    
+    // Recording side
+    void countDesignedBands(int band_mask) noexcept  { if constexpr (instrumentation_enabled) designed_bands.fetch_add(countBands(band_mask), std::memory_order_relaxed); }
+    void countSmoothedBands(int band_mask) noexcept  { if constexpr (instrumentation_enabled) smoothed_bands.fetch_add(countBands(band_mask), std::memory_order_relaxed); }
+    void countCoefficientLoad() noexcept             { if constexpr (instrumentation_enabled) coefficient_loads.fetch_add(1, std::memory_order_relaxed); }
+    
+    DurationHistogram block_time;
+    std::array<DurationHistogram, num_stages> stage_time;
+    RealtimeMonitor monitor;
+    
+private:
+    static juce::uint64 countBands(int band_mask) noexcept { return (juce::uint64) juce::countNumberOfBits((juce::uint32) band_mask); }
+    
+    std::atomic<bool> stage_timing { true };
+    std::atomic<juce::uint64> designed_bands { 0 }, smoothed_bands { 0 }, coefficient_loads { 0 };
+};
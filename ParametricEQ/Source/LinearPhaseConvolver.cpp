@@ -0,0 +1,292 @@
+/*
+  ==============================================================================
+
+    LinearPhaseConvolver.cpp
+
+  ==============================================================================
+*/
+
+#include "LinearPhaseConvolver.h"
+
+LinearPhaseLayout LinearPhaseLayout::create(double sample_rate, int partition_size) noexcept
+{
+    LinearPhaseLayout layout;
+    layout.kernel_length = juce::jmax(1024, juce::nextPowerOfTwo((int) (sample_rate / 6.0)));
+    layout.partition_size = juce::jlimit(64, layout.kernel_length, juce::nextPowerOfTwo(partition_size));
+    return layout;
+}
+
+//==============================================================================
+void LinearPhaseKernelDesigner::prepare(double new_sample_rate, const LinearPhaseLayout& new_layout)
+{
+    sample_rate = new_sample_rate;
+    layout = new_layout;
+    
+    const auto n = layout.kernel_length;
+    
+    kernel_fft = std::make_unique<juce::dsp::FFT>(juce::roundToInt(std::log2(n)));
+    partition_fft = std::make_unique<juce::dsp::FFT>(juce::roundToInt(std::log2(layout.getFFTSize())));
+    
+    phi.resize((size_t) (n / 2 + 1));
+    
+    for (size_t k = 0; k < phi.size(); ++k)
+    {
+        const auto half_sine = std::sin(juce::MathConstants<double>::pi * (double) k / n);
+        phi[k] = 4.0 * half_sine * half_sine;
+    }
+    
+    // Blackman, peaking at the kernel centre
+    window.resize((size_t) n);
+    
+    for (int i = 0; i < n; ++i)
+    {
+        const auto phase = juce::MathConstants<double>::twoPi * i / n;
+        window[(size_t) i] = (float) (0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase));
+    }
+    
+    kernel_buffer.resize((size_t) (2 * n));
+    partition_buffer.resize((size_t) (2 * layout.getFFTSize()));
+}
+
+void LinearPhaseKernelDesigner::design(const ChainCoefficients& coefficients, float* kernel_spectra, int band_mask) noexcept
+{
+    const auto n = layout.kernel_length;
+    const auto bins = n / 2 + 1;
+    
+    // Zero phase spectrum holding the chain's magnitude response
+    std::fill(kernel_buffer.begin(), kernel_buffer.end(), 0.f);
+    
+    for (int k = 0; k < bins; ++k)
+    {
+        const auto p = phi[(size_t) k];
+        auto magnitude_squared = 1.0;
+        
+        forEachActiveSection(coefficients, [&](const BiquadCoefficients<double>& c)
+        {
+            const auto den = getPowerResponseTerms(1.0, c.a1, c.a2).evaluate(p);
+            magnitude_squared *= den > 0.0 ? getPowerResponseTerms(c.b0, c.b1, c.b2).evaluate(p) / den : 0.0;
+        }, band_mask);
+        
+        kernel_buffer[(size_t) (2 * k)] = (float) std::sqrt(juce::jmax(0.0, magnitude_squared));
+    }
+    
+    kernel_fft->performRealOnlyInverseTransform(kernel_buffer.data());
+    
+    // Centre the impulse, window it and transform each partition
+    const auto partition_size = layout.partition_size;
+    const auto spectrum_floats = layout.getSpectrumFloats();
+    
+    for (int p = 0; p < layout.getNumPartitions(); ++p)
+    {
+        std::fill(partition_buffer.begin(), partition_buffer.end(), 0.f);
+        
+        for (int i = 0; i < partition_size; ++i)
+        {
+            const auto tap = p * partition_size + i;
+            partition_buffer[(size_t) i] = kernel_buffer[(size_t) ((tap + n / 2) % n)] * window[(size_t) tap];
+        }
+        
+        partition_fft->performRealOnlyForwardTransform(partition_buffer.data(), true);
+        std::copy(partition_buffer.begin(), partition_buffer.begin() + spectrum_floats, kernel_spectra + p * spectrum_floats);
+    }
+}
+
+//==============================================================================
+void UniformPartitionedConvolver::prepare(int num_channels, const LinearPhaseLayout& new_layout)
+{
+    layout = new_layout;
+    fft = std::make_unique<juce::dsp::FFT>(juce::roundToInt(std::log2(layout.getFFTSize())));
+    
+    channel_states.resize((size_t) num_channels);
+    
+    for (auto& channel : channel_states)
+    {
+        channel.input.resize((size_t) layout.getFFTSize());
+        channel.output.resize((size_t) layout.partition_size);
+        channel.delay_line.resize((size_t) layout.getKernelFloats());
+    }
+    
+    const auto kernel_floats = (size_t) (LinearPhaseKernels::num_kernels * layout.getKernelFloats());
+    current_kernel.assign(kernel_floats, 0.f);
+    previous_kernel.assign(kernel_floats, 0.f);
+    fft_buffer.resize((size_t) (2 * layout.getFFTSize()));
+    crossfade_buffer.resize((size_t) (2 * layout.getFFTSize()));
+    has_kernel = false;
+    mid_side = false;
+    
+    reset();
+}
+
+void UniformPartitionedConvolver::reset() noexcept
+{
+    for (auto& channel : channel_states)
+    {
+        std::fill(channel.input.begin(), channel.input.end(), 0.f);
+        std::fill(channel.output.begin(), channel.output.end(), 0.f);
+        std::fill(channel.delay_line.begin(), channel.delay_line.end(), 0.f);
+    }
+    
+    position = 0;
+    delay_line_position = 0;
+    crossfade_pending = false;
+}
+
+void UniformPartitionedConvolver::setKernels(const LinearPhaseKernels& kernels) noexcept
+{
+    jassert(kernels.spectra.size() == current_kernel.size());
+    
+    // Keep fading from whatever is actually playing if the last swap hasn't happened yet
+    if (has_kernel && ! crossfade_pending)
+    {
+        std::swap(current_kernel, previous_kernel);
+        crossfade_pending = true;
+    }
+    
+    std::copy(kernels.spectra.begin(), kernels.spectra.end(), current_kernel.begin());
+    has_kernel = true;
+    
+    const auto new_mid_side = kernels.mid_side && channel_states.size() >= 2;
+    
+    if (new_mid_side != mid_side)
+        convertMidSide(new_mid_side);
+}
+
+// Everything the convolver holds is linear in its input, so moving the
+// history of the pair into the other domain lets the crossfade run on
+// without a jump. Output is kept before decoding, so it converts the same way.
+void UniformPartitionedConvolver::convertMidSide(bool to_mid_side) noexcept
+{
+    const auto scale = to_mid_side ? 0.5f : 1.f;
+    
+    const auto convert = [scale](std::vector<float>& first, std::vector<float>& second)
+    {
+        for (size_t i = 0; i < first.size(); ++i)
+        {
+            const auto a = first[i], b = second[i];
+            first[i] = scale * (a + b);
+            second[i] = scale * (a - b);
+        }
+    };
+    
+    auto& first = channel_states[0];
+    auto& second = channel_states[1];
+    convert(first.input, second.input);
+    convert(first.output, second.output);
+    convert(first.delay_line, second.delay_line);
+    
+    mid_side = to_mid_side;
+}
+
+void UniformPartitionedConvolver::accumulate(const ChannelState& channel, const float* kernel, float* result) noexcept
+{
+    const auto spectrum_floats = layout.getSpectrumFloats();
+    const auto num_partitions = layout.getNumPartitions();
+    
+    std::fill(result, result + 2 * layout.getFFTSize(), 0.f);
+    
+    for (int p = 0; p < num_partitions; ++p)
+    {
+        const auto slot = (delay_line_position - p + num_partitions) % num_partitions;
+        const auto* x = channel.delay_line.data() + slot * spectrum_floats;
+        const auto* h = kernel + p * spectrum_floats;
+        
+        for (int i = 0; i < spectrum_floats; i += 2)
+        {
+            result[i]     += x[i] * h[i]     - x[i + 1] * h[i + 1];
+            result[i + 1] += x[i] * h[i + 1] + x[i + 1] * h[i];
+        }
+    }
+}
+
+void UniformPartitionedConvolver::processPartition(ChannelState& channel, int kernel_offset) noexcept
+{
+    const auto partition_size = layout.partition_size;
+    const auto spectrum_floats = layout.getSpectrumFloats();
+    
+    // Spectrum of the last two partitions goes into the delay line
+    std::copy(channel.input.begin(), channel.input.end(), fft_buffer.begin());
+    std::fill(fft_buffer.begin() + layout.getFFTSize(), fft_buffer.end(), 0.f);
+    fft->performRealOnlyForwardTransform(fft_buffer.data(), true);
+    std::copy(fft_buffer.begin(), fft_buffer.begin() + spectrum_floats, channel.delay_line.begin() + delay_line_position * spectrum_floats);
+    
+    // Overlap-save: only the second half of the result is valid
+    accumulate(channel, current_kernel.data() + kernel_offset, fft_buffer.data());
+    fft->performRealOnlyInverseTransform(fft_buffer.data());
+    std::copy(fft_buffer.begin() + partition_size, fft_buffer.begin() + 2 * partition_size, channel.output.begin());
+    
+    if (crossfading)
+    {
+        accumulate(channel, previous_kernel.data() + kernel_offset, crossfade_buffer.data());
+        fft->performRealOnlyInverseTransform(crossfade_buffer.data());
+        
+        for (int i = 0; i < partition_size; ++i)
+        {
+            const auto ramp = (float) i / (float) partition_size;
+            channel.output[(size_t) i] = crossfade_buffer[(size_t) (partition_size + i)] * (1.f - ramp) + channel.output[(size_t) i] * ramp;
+        }
+    }
+    
+    std::copy(channel.input.begin() + partition_size, channel.input.end(), channel.input.begin());
+}
+
+void UniformPartitionedConvolver::process(float* const* channels, int num_channels, int num_samples) noexcept
+{
+    jassert(num_channels <= (int) channel_states.size());
+    
+    const auto partition_size = layout.partition_size;
+    const auto num_partitions = layout.getNumPartitions();
+    const auto pair_channels = mid_side && num_channels >= 2 ? 2 : 0;
+    
+    // Every channel crosses partition boundaries at the same samples, so
+    // walk the block in boundary sized steps and run all channels together
+    for (int start = 0; start < num_samples;)
+    {
+        const auto length = juce::jmin(partition_size - position, num_samples - start);
+        
+        // Mid / side is encoded on the way in and decoded on the way out
+        if (pair_channels != 0)
+        {
+            auto* left = channels[0] + start;
+            auto* right = channels[1] + start;
+            auto* mid_input = channel_states[0].input.data() + partition_size + position;
+            auto* side_input = channel_states[1].input.data() + partition_size + position;
+            const auto* mid_output = channel_states[0].output.data() + position;
+            const auto* side_output = channel_states[1].output.data() + position;
+            
+            for (int i = 0; i < length; ++i)
+            {
+                const auto l = left[i], r = right[i];
+                mid_input[i] = 0.5f * (l + r);
+                side_input[i] = 0.5f * (l - r);
+                
+                left[i] = mid_output[i] + side_output[i];
+                right[i] = mid_output[i] - side_output[i];
+            }
+        }
+        
+        for (int ch = pair_channels; ch < num_channels; ++ch)
+        {
+            auto& channel = channel_states[(size_t) ch];
+            auto* data = channels[ch] + start;
+            
+            std::copy(data, data + length, channel.input.begin() + partition_size + position);
+            std::copy(channel.output.begin() + position, channel.output.begin() + position + length, data);
+        }
+        
+        position += length;
+        start += length;
+        
+        if (position == partition_size)
+        {
+            crossfading = crossfade_pending;
+            
+            // The first channel runs the first kernel, all others the second
+            for (int ch = 0; ch < num_channels; ++ch)
+                processPartition(channel_states[(size_t) ch], ch == 0 ? 0 : layout.getKernelFloats());
+            
+            crossfading = crossfade_pending = false;
+            delay_line_position = (delay_line_position + 1) % num_partitions;
+            position = 0;
+        }
+    }
+}
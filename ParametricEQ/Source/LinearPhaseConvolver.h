@@ -0,0 +1,99 @@
+/*
+  ==============================================================================
+
+    LinearPhaseConvolver.h
+
+    Linear phase mode. LinearPhaseKernelDesigner turns the magnitude
+    response of a designed chain into a symmetric FIR kernel and cuts it
+    into frequency domain partitions (design thread). The
+    UniformPartitionedConvolver runs that kernel with uniformly partitioned
+    overlap-save convolution on the audio thread, crossfading over one
+    partition whenever a new kernel arrives. Split stereo modes get a
+    kernel per side, mid / side is encoded and decoded around the
+    convolution.
+
+    Latency is one partition (input buffering) plus half the kernel.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterChain.h"
+
+// Sizes shared by the designer and the convolver
+struct LinearPhaseLayout
+{
+    int kernel_length { 0 }, partition_size { 0 };
+    
+    int getNumPartitions() const noexcept      { return kernel_length / partition_size; }
+    int getFFTSize() const noexcept            { return partition_size * 2; }
+    int getSpectrumFloats() const noexcept     { return partition_size * 2 + 2; }   // partition_size + 1 complex bins
+    int getKernelFloats() const noexcept       { return getNumPartitions() * getSpectrumFloats(); }
+    int getLatencySamples() const noexcept     { return partition_size + kernel_length / 2; }
+    
+    // Long enough to resolve a 48 dB/Oct cut at 20 Hz reasonably
+    static LinearPhaseLayout create(double sample_rate, int partition_size) noexcept;
+};
+
+// What the design thread hands the convolver: a kernel for the first
+// channel, one for every other channel, and whether a stereo pair is
+// convolved as mid and side
+struct LinearPhaseKernels
+{
+    static constexpr int num_kernels = 2;
+    
+    std::vector<float> spectra;   // num_kernels * LinearPhaseLayout::getKernelFloats()
+    bool mid_side { false };
+};
+
+class LinearPhaseKernelDesigner
+{
+public:
+    // Allocates, call before design()
+    void prepare(double sample_rate, const LinearPhaseLayout& layout);
+    
+    // Fills kernel_spectra (layout.getKernelFloats() values) from the bands
+    // in band_mask, never allocates
+    void design(const ChainCoefficients& coefficients, float* kernel_spectra, int band_mask = all_bands) noexcept;
+    
+private:
+    double sample_rate { 0 };
+    LinearPhaseLayout layout;
+    std::unique_ptr<juce::dsp::FFT> kernel_fft, partition_fft;
+    std::vector<double> phi;
+    std::vector<float> window, kernel_buffer, partition_buffer;
+};
+
+class UniformPartitionedConvolver
+{
+public:
+    // Allocates everything the audio thread will need
+    void prepare(int num_channels, const LinearPhaseLayout& layout);
+    void reset() noexcept;
+    
+    // Copies new kernels in, the next partition crossfades to them
+    void setKernels(const LinearPhaseKernels& kernels) noexcept;
+    
+    void process(float* const* channels, int num_channels, int num_samples) noexcept;
+    
+private:
+    struct ChannelState
+    {
+        std::vector<float> input;        // previous and current partition
+        std::vector<float> output;       // last computed partition
+        std::vector<float> delay_line;   // input spectra, one per kernel partition
+    };
+    
+    void processPartition(ChannelState& channel, int kernel_offset) noexcept;
+    void convertMidSide(bool to_mid_side) noexcept;
+    void accumulate(const ChannelState& channel, const float* kernel, float* result) noexcept;
+    
+    LinearPhaseLayout layout;
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<ChannelState> channel_states;
+    std::vector<float> current_kernel, previous_kernel, fft_buffer, crossfade_buffer;
+    int position { 0 }, delay_line_position { 0 };
+    bool has_kernel { false }, crossfade_pending { false }, crossfading { false }, mid_side { false };
+};
@@ -1,40 +1,396 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin editor.
-
-  ==============================================================================
-*/
-
-#include "PluginProcessor.h"
-#include "PluginEditor.h"
-
-//==============================================================================
-ParametricEQAudioProcessorEditor::ParametricEQAudioProcessorEditor (ParametricEQAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
-{
-    // Make sure that before the constructor has finished, you've set the
-    // editor's size to whatever you need it to be.
-    setSize (400, 300);
-}
-
-ParametricEQAudioProcessorEditor::~ParametricEQAudioProcessorEditor()
-{
-}
-
-//==============================================================================
-void ParametricEQAudioProcessorEditor::paint (juce::Graphics& g)
-{
-    // (Our component is opaque, so we must completely fill the background with a solid colour)
-    g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
-
-    g.setColour (juce::Colours::white);
-    g.setFont (15.0f);
-    g.drawFittedText ("Hello World!", getLocalBounds(), juce::Justification::centred, 1);
-}
-
-void ParametricEQAudioProcessorEditor::resized()
-{
-    // This is generally where you'll want to lay out the positions of any
-    // subcomponents in your editor..
-}
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin editor.
+
+  ==============================================================================
+*/
+
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+
+//==============================================================================
+SpectrumDisplay::SpectrumDisplay (SpectrumAnalyzer& a)
+    : analyzer (a)
+{
+    setOpaque (true);
+    analyzer.attachDisplay();
+    startTimerHz (analyzer.getRefreshRate());
+}
+
+SpectrumDisplay::~SpectrumDisplay()
+{
+    stopTimer();
+    analyzer.detachDisplay();
+}
+
+float SpectrumDisplay::frequencyToX (float freq) const noexcept
+{
+    return (float) getWidth() * std::log (freq / min_freq) / std::log (max_freq / min_freq);
+}
+
+float SpectrumDisplay::decibelsToY (float db) const noexcept
+{
+    return juce::jmap (juce::jlimit (min_db, max_db, db), min_db, max_db, (float) getHeight(), 0.f);
+}
+
+void SpectrumDisplay::resized()
+{
+    // The grid only changes with the size, draw it once into an image
+    grid = juce::Image (juce::Image::RGB, juce::jmax (1, getWidth()), juce::jmax (1, getHeight()), true);
+    juce::Graphics g (grid);
+
+    g.fillAll (juce::Colours::black);
+    g.setFont (10.f);
+
+    for (auto freq : { 20.f, 50.f, 100.f, 200.f, 500.f, 1000.f, 2000.f, 5000.f, 10000.f, 20000.f })
+    {
+        const auto x = frequencyToX (freq);
+        g.setColour (juce::Colours::darkgrey.withAlpha (0.5f));
+        g.drawVerticalLine (juce::roundToInt (x), 0.f, (float) getHeight());
+
+        g.setColour (juce::Colours::lightgrey);
+        const auto text = freq >= 1000.f ? juce::String (freq / 1000.f) + "k" : juce::String (freq);
+        g.drawText (text, juce::roundToInt (x) + 2, getHeight() - 14, 40, 12, juce::Justification::left);
+    }
+
+    for (auto db = max_db - 6.f; db > min_db; db -= 12.f)
+    {
+        const auto y = decibelsToY (db);
+        g.setColour (juce::Colours::darkgrey.withAlpha (0.5f));
+        g.drawHorizontalLine (juce::roundToInt (y), 0.f, (float) getWidth());
+
+        g.setColour (juce::Colours::lightgrey);
+        g.drawText (juce::String (db) + " dB", 2, juce::roundToInt (y) + 1, 50, 12, juce::Justification::left);
+    }
+
+    updatePaths();
+}
+
+void SpectrumDisplay::timerCallback()
+{
+    if (analyzer.updateFrame())
+    {
+        updatePaths();
+        repaint();
+    }
+}
+
+void SpectrumDisplay::updatePaths()
+{
+    const auto& frame = analyzer.getFrame();
+
+    if (frame.num_bins == 0)
+        return;
+
+    pre_path = makePath (frame.pre_db, frame.num_bins, frame.fft_size, frame.sample_rate);
+    post_path = makePath (frame.post_db, frame.num_bins, frame.fft_size, frame.sample_rate);
+}
+
+// One point per pixel column, taking the loudest bin that lands in it
+juce::Path SpectrumDisplay::makePath (const std::vector<float>& magnitudes_db, int num_bins, int fft_size, double sample_rate) const
+{
+    juce::Path path;
+    const auto bin_width = (float) (sample_rate / fft_size);
+    auto column = -1;
+    auto column_db = min_db;
+
+    for (int k = 1; k < num_bins; ++k)
+    {
+        const auto freq = (float) k * bin_width;
+
+        if (freq < min_freq)
+            continue;
+
+        if (freq > max_freq)
+            break;
+
+        const auto x = juce::roundToInt (frequencyToX (freq));
+
+        if (x != column && column >= 0)
+        {
+            if (path.isEmpty())
+                path.startNewSubPath ((float) column, decibelsToY (column_db));
+            else
+                path.lineTo ((float) column, decibelsToY (column_db));
+
+            column_db = min_db;
+        }
+
+        column = x;
+        column_db = juce::jmax (column_db, magnitudes_db[(size_t) k]);
+    }
+
+    if (column >= 0 && ! path.isEmpty())
+        path.lineTo ((float) column, decibelsToY (column_db));
+
+    return path;
+}
+
+void SpectrumDisplay::paint (juce::Graphics& g)
+{
+    g.drawImageAt (grid, 0, 0);
+
+    g.setColour (juce::Colours::skyblue.withAlpha (0.35f));
+    g.strokePath (pre_path, juce::PathStrokeType (1.f));
+
+    g.setColour (juce::Colours::orange);
+    g.strokePath (post_path, juce::PathStrokeType (1.5f));
+}
+
+//==============================================================================
+ResponseCurveDisplay::ResponseCurveDisplay (ParametricEQAudioProcessor& p)
+    : audioProcessor (p)
+{
+    setInterceptsMouseClicks (false, false);
+    startTimerHz (30);
+}
+
+void ResponseCurveDisplay::resized()
+{
+    refresh (true);
+}
+
+void ResponseCurveDisplay::timerCallback()
+{
+    refresh (false);
+}
+
+// Draws the processor's published design, nothing is designed here. Free
+// when nothing moved, the generation is all that gets read.
+void ResponseCurveDisplay::refresh (bool force)
+{
+    const auto new_sample_rate = audioProcessor.getSampleRate();
+
+    if (new_sample_rate <= 0.0 || getWidth() <= 0)
+        return;
+
+    if (force || new_sample_rate != sample_rate)
+    {
+        sample_rate = new_sample_rate;
+        curve.setFrequencies (getWidth(), SpectrumDisplay::min_freq, SpectrumDisplay::max_freq, sample_rate);
+        force = true;
+    }
+
+    const auto generation = audioProcessor.getDesignGeneration();
+
+    if (! force && generation == design_generation)
+        return;
+
+    design_generation = generation;
+    audioProcessor.getDesignedCoefficients (coefficients);
+
+    // Only the bands whose coefficients changed are recomputed
+    if (! curve.update (coefficients) && ! force)
+        return;
+
+    const auto* magnitudes = curve.getMagnitudesDb();
+    const auto height = (float) getHeight();
+
+    path.clear();
+
+    for (int x = 0; x < curve.getNumPoints(); ++x)
+    {
+        const auto y = juce::jmap (juce::jlimit (-range_db, range_db, magnitudes[x]), -range_db, range_db, height, 0.f);
+
+        if (x == 0)
+            path.startNewSubPath (0.f, y);
+        else
+            path.lineTo ((float) x, y);
+    }
+
+    repaint();
+}
+
+void ResponseCurveDisplay::paint (juce::Graphics& g)
+{
+    g.setColour (juce::Colours::white);
+    g.strokePath (path, juce::PathStrokeType (2.f));
+}
+
+//==============================================================================
+InstrumentationOverlay::InstrumentationOverlay (ProcessorInstrumentation& i)
+    : instrumentation (i)
+{
+    setInterceptsMouseClicks (false, false);
+
+    if (instrumentation_enabled)
+        startTimerHz (4);
+}
+
+void InstrumentationOverlay::timerCallback()
+{
+    const auto snapshot = instrumentation.getSnapshot();
+
+    auto timing = [] (const juce::String& name, const ProcessorInstrumentation::Timing& t)
+    {
+        return name.paddedRight (' ', 7)
+             + "p50 " + juce::String (t.p50_ns * 1.0e-3, 1)
+             + "  p99 " + juce::String (t.p99_ns * 1.0e-3, 1)
+             + "  max " + juce::String (t.max_ns * 1.0e-3, 1) + " us"
+             + "  n " + juce::String (t.count);
+    };
+
+    lines.clearQuick();
+    lines.add (timing ("Block", snapshot.block));
+
+    // Only the bands that have run
+    for (int i = 0; i < ProcessorInstrumentation::num_stages; ++i)
+    {
+        if (snapshot.stages[(size_t) i].count == 0)
+            continue;
+
+        const auto name = i == LowCut ? juce::String ("LowCut")
+                        : i == HiCut  ? juce::String ("HiCut")
+                                      : "Band" + juce::String (i - Band1 + 1);
+
+        lines.add (timing (name, snapshot.stages[(size_t) i]));
+    }
+
+    lines.add ("Designed " + juce::String (snapshot.designed_bands) + " bands, smoothed "
+               + juce::String (snapshot.smoothed_bands) + ", loads " + juce::String (snapshot.coefficient_loads));
+    lines.add ("Audio thread: " + juce::String (snapshot.allocations) + " heap ops, "
+               + juce::String (snapshot.locks) + " locks");
+
+    has_violations = snapshot.allocations > 0 || snapshot.locks > 0;
+    setSize (getWidth(), lines.size() * line_height + 8);
+    repaint();
+}
+
+void InstrumentationOverlay::paint (juce::Graphics& g)
+{
+    g.fillAll (juce::Colours::black.withAlpha (0.6f));
+    g.setFont (juce::Font (juce::Font::getDefaultMonospacedFontName(), 12.f, juce::Font::plain));
+
+    auto area = getLocalBounds().reduced (6, 4);
+
+    for (int i = 0; i < lines.size(); ++i)
+    {
+        const auto is_violation_line = i == lines.size() - 1;
+        g.setColour (is_violation_line && has_violations ? juce::Colours::red : juce::Colours::lightgrey);
+        g.drawText (lines[i], area.removeFromTop (line_height), juce::Justification::centredLeft, false);
+    }
+}
+
+//==============================================================================
+ParametricEQAudioProcessorEditor::ParametricEQAudioProcessorEditor (ParametricEQAudioProcessor& p)
+    : AudioProcessorEditor (&p), audioProcessor (p), spectrum (p.getAnalyzer()), response_curve (p),
+      instrumentation_overlay (p.getInstrumentation())
+{
+    addAndMakeVisible (spectrum);
+    addAndMakeVisible (response_curve);
+
+    if (instrumentation_enabled)
+        addAndMakeVisible (instrumentation_overlay);
+
+    for (auto* parameter : audioProcessor.getParameters())
+    {
+        auto* with_id = dynamic_cast<juce::AudioProcessorParameterWithID*> (parameter);
+
+        if (with_id == nullptr)
+            continue;
+
+        if (auto* choice = dynamic_cast<juce::AudioParameterChoice*> (parameter))
+        {
+            auto* combo_box = combo_boxes.add (new juce::ComboBox());
+            combo_box->addItemList (choice->choices, 1);
+            combo_box_attachments.add (new juce::AudioProcessorValueTreeState::ComboBoxAttachment (audioProcessor.apvts, with_id->paramID, *combo_box));
+            controls.add (combo_box);
+        }
+        else if (dynamic_cast<juce::AudioParameterBool*> (parameter) != nullptr)
+        {
+            auto* toggle_button = toggle_buttons.add (new juce::ToggleButton());
+            button_attachments.add (new juce::AudioProcessorValueTreeState::ButtonAttachment (audioProcessor.apvts, with_id->paramID, *toggle_button));
+            controls.add (toggle_button);
+        }
+        else
+        {
+            auto* slider = sliders.add (new juce::Slider (juce::Slider::RotaryHorizontalVerticalDrag, juce::Slider::TextBoxBelow));
+            slider->setTextBoxStyle (juce::Slider::TextBoxBelow, false, 70, 16);
+            slider_attachments.add (new juce::AudioProcessorValueTreeState::SliderAttachment (audioProcessor.apvts, with_id->paramID, *slider));
+            controls.add (slider);
+        }
+
+        auto* label = labels.add (new juce::Label ({}, with_id->name));
+        label->setJustificationType (juce::Justification::centred);
+        label->setFont (12.f);
+
+        control_bands.add (getBandForParameterID (with_id->paramID));
+        addChildComponent (controls.getLast());
+        addChildComponent (label);
+    }
+
+    // 24 bands don't fit on screen at once, pick one to edit
+    for (int band = 0; band < max_bands; ++band)
+        band_selector.addItem ("Band " + juce::String (band + 1), band + 1);
+
+    band_selector.onChange = [this] { showBand (band_selector.getSelectedId() - 1); };
+    band_selector.setSelectedId (1, juce::dontSendNotification);
+    addAndMakeVisible (band_selector);
+    showBand (0);
+
+    // Make sure that before the constructor has finished, you've set the
+    // editor's size to whatever you need it to be.
+    setSize (900, 560);
+}
+
+ParametricEQAudioProcessorEditor::~ParametricEQAudioProcessorEditor()
+{
+}
+
+//==============================================================================
+void ParametricEQAudioProcessorEditor::paint (juce::Graphics& g)
+{
+    // (Our component is opaque, so we must completely fill the background with a solid colour)
+    g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
+}
+
+void ParametricEQAudioProcessorEditor::resized()
+{
+    auto bounds = getLocalBounds().reduced (8);
+    spectrum.setBounds (bounds.removeFromTop (bounds.getHeight() / 2));
+    response_curve.setBounds (spectrum.getBounds());
+    instrumentation_overlay.setBounds (spectrum.getX(), spectrum.getY(), 440, instrumentation_overlay.getHeight());
+    bounds.removeFromTop (8);
+    band_selector.setBounds (bounds.removeFromTop (24).removeFromLeft (160));
+    bounds.removeFromTop (4);
+
+    juce::Array<int> visible;
+
+    for (int i = 0; i < controls.size(); ++i)
+        if (controls[i]->isVisible())
+            visible.add (i);
+
+    // Controls in a grid, label above each
+    const auto num_columns = 7;
+    const auto num_rows = (visible.size() + num_columns - 1) / num_columns;
+    const auto cell_width = bounds.getWidth() / num_columns;
+    const auto cell_height = bounds.getHeight() / juce::jmax (1, num_rows);
+
+    for (int cell_index = 0; cell_index < visible.size(); ++cell_index)
+    {
+        const auto i = visible[cell_index];
+        auto cell = juce::Rectangle<int> (bounds.getX() + (cell_index % num_columns) * cell_width,
+                                          bounds.getY() + (cell_index / num_columns) * cell_height,
+                                          cell_width, cell_height).reduced (4);
+
+        labels[i]->setBounds (cell.removeFromTop (16));
+
+        if (dynamic_cast<juce::Slider*> (controls[i]) == nullptr)
+            controls[i]->setBounds (cell.withSizeKeepingCentre (cell.getWidth(), 24));
+        else
+            controls[i]->setBounds (cell);
+    }
+}
+
+void ParametricEQAudioProcessorEditor::showBand (int band)
+{
+    for (int i = 0; i < controls.size(); ++i)
+    {
+        const auto is_shown = control_bands[i] < 0 || control_bands[i] == band;
+        controls[i]->setVisible (is_shown);
+        labels[i]->setVisible (is_shown);
+    }
+
+    resized();
+}
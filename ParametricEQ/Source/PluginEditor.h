@@ -1,33 +1,137 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin editor.
-
-  ==============================================================================
-*/
-
-#pragma once
-
-#include <JuceHeader.h>
-#include "PluginProcessor.h"
-
-//==============================================================================
-/**
-*/
-class ParametricEQAudioProcessorEditor  : public juce::AudioProcessorEditor
-{
-public:
-    ParametricEQAudioProcessorEditor (ParametricEQAudioProcessor&);
-    ~ParametricEQAudioProcessorEditor() override;
-
-    //==============================================================================
-    void paint (juce::Graphics&) override;
-    void resized() override;
-
-private:
-    // This reference is provided as a quick way for your editor to
-    // access the processor object that created it.
-    ParametricEQAudioProcessor& audioProcessor;
-
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParametricEQAudioProcessorEditor)
-};
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+#include "ResponseCurve.h"
+
+// Pre (dim) and post (bright) EQ spectra on a log frequency axis
+class SpectrumDisplay  : public juce::Component,
+                         private juce::Timer
+{
+public:
+    explicit SpectrumDisplay (SpectrumAnalyzer&);
+    ~SpectrumDisplay() override;
+
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+    // Shared with the response curve so both use the same frequency axis
+    static constexpr float min_freq = 20.f, max_freq = 20000.f;
+
+private:
+    void timerCallback() override;
+
+    // Rebuilt only when a new frame arrives or the size changes
+    void updatePaths();
+    juce::Path makePath (const std::vector<float>& magnitudes_db, int num_bins, int fft_size, double sample_rate) const;
+
+    float frequencyToX (float freq) const noexcept;
+    float decibelsToY (float db) const noexcept;
+
+    static constexpr float min_db = -90.f, max_db = 6.f;
+
+    SpectrumAnalyzer& analyzer;
+    juce::Path pre_path, post_path;
+    juce::Image grid;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumDisplay)
+};
+
+// The EQ's combined response, drawn over the spectrum. Only bands whose
+// coefficients changed are re-evaluated and the path is kept until the curve moves.
+class ResponseCurveDisplay  : public juce::Component,
+                              private juce::Timer
+{
+public:
+    explicit ResponseCurveDisplay (ParametricEQAudioProcessor&);
+
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+private:
+    void timerCallback() override;
+    void refresh (bool force);
+
+    static constexpr float range_db = 24.f;
+
+    ParametricEQAudioProcessor& audioProcessor;
+    ChainCoefficients coefficients;
+    juce::uint32 design_generation { 0 };
+    ResponseCurve curve;
+    double sample_rate { 0 };
+    juce::Path path;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ResponseCurveDisplay)
+};
+
+// Debug readout of the processor's timings, redesign counts and realtime
+// violations. Only shown in builds with PARAMETRIC_EQ_INSTRUMENTATION=1.
+class InstrumentationOverlay  : public juce::Component,
+                                private juce::Timer
+{
+public:
+    explicit InstrumentationOverlay (ProcessorInstrumentation&);
+
+    void paint (juce::Graphics&) override;
+
+    static constexpr int line_height = 14;
+
+private:
+    void timerCallback() override;
+
+    ProcessorInstrumentation& instrumentation;
+    juce::StringArray lines;
+    bool has_violations { false };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (InstrumentationOverlay)
+};
+
+//==============================================================================
+/**
+*/
+class ParametricEQAudioProcessorEditor  : public juce::AudioProcessorEditor
+{
+public:
+    ParametricEQAudioProcessorEditor (ParametricEQAudioProcessor&);
+    ~ParametricEQAudioProcessorEditor() override;
+
+    //==============================================================================
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+private:
+    // Shows the global controls and those of one band
+    void showBand (int band);
+
+    // This reference is provided as a quick way for your editor to
+    // access the processor object that created it.
+    ParametricEQAudioProcessor& audioProcessor;
+
+    SpectrumDisplay spectrum;
+    ResponseCurveDisplay response_curve;
+    InstrumentationOverlay instrumentation_overlay;
+
+    juce::ComboBox band_selector;
+
+    // One control per parameter: rotary sliders for floats, combo boxes for
+    // choices, toggles for bools. control_bands holds each one's band, -1 if global.
+    juce::OwnedArray<juce::Slider> sliders;
+    juce::OwnedArray<juce::ComboBox> combo_boxes;
+    juce::OwnedArray<juce::ToggleButton> toggle_buttons;
+    juce::OwnedArray<juce::Label> labels;
+    juce::OwnedArray<juce::AudioProcessorValueTreeState::SliderAttachment> slider_attachments;
+    juce::OwnedArray<juce::AudioProcessorValueTreeState::ComboBoxAttachment> combo_box_attachments;
+    juce::OwnedArray<juce::AudioProcessorValueTreeState::ButtonAttachment> button_attachments;
+    juce::Array<juce::Component*> controls;
+    juce::Array<int> control_bands;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParametricEQAudioProcessorEditor)
+};
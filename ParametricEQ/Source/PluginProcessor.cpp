@@ -1,359 +1,1116 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin processor.
-
-  ==============================================================================
-*/
-
-#include "PluginProcessor.h"
-#include "PluginEditor.h"
-
-//==============================================================================
-ParametricEQAudioProcessor::ParametricEQAudioProcessor()
-#ifndef JucePlugin_PreferredChannelConfigurations
-     : AudioProcessor (BusesProperties()
-                     #if ! JucePlugin_IsMidiEffect
-                      #if ! JucePlugin_IsSynth
-                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
-                      #endif
-                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
-                     #endif
-                       )
-#endif
-{
-}
-
-ParametricEQAudioProcessor::~ParametricEQAudioProcessor()
-{
-}
-
-//==============================================================================
-const juce::String ParametricEQAudioProcessor::getName() const
-{
-    return JucePlugin_Name;
-}
-
-bool ParametricEQAudioProcessor::acceptsMidi() const
-{
-   #if JucePlugin_WantsMidiInput
-    return true;
-   #else
-    return false;
-   #endif
-}
-
-bool ParametricEQAudioProcessor::producesMidi() const
-{
-   #if JucePlugin_ProducesMidiOutput
-    return true;
-   #else
-    return false;
-   #endif
-}
-
-bool ParametricEQAudioProcessor::isMidiEffect() const
-{
-   #if JucePlugin_IsMidiEffect
-    return true;
-   #else
-    return false;
-   #endif
-}
-
-double ParametricEQAudioProcessor::getTailLengthSeconds() const
-{
-    return 0.0;
-}
-
-int ParametricEQAudioProcessor::getNumPrograms()
-{
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
-}
-
-int ParametricEQAudioProcessor::getCurrentProgram()
-{
-    return 0;
-}
-
-void ParametricEQAudioProcessor::setCurrentProgram (int index)
-{
-}
-
-const juce::String ParametricEQAudioProcessor::getProgramName (int index)
-{
-    return {};
-}
-
-void ParametricEQAudioProcessor::changeProgramName (int index, const juce::String& newName)
-{
-}
-
-//==============================================================================
-void ParametricEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
-{
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
-    juce::dsp::ProcessSpec spec;
-    spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = 1;
-    spec.sampleRate = sampleRate;
-    
-    left_chain.prepare(spec);
-    right_chain.prepare(spec);
-    
-    updateFilters();
-    
-}
-
-void ParametricEQAudioProcessor::releaseResources()
-{
-    // When playback stops, you can use this as an opportunity to free up any
-    // spare memory, etc.
-}
-
-#ifndef JucePlugin_PreferredChannelConfigurations
-bool ParametricEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
-{
-  #if JucePlugin_IsMidiEffect
-    juce::ignoreUnused (layouts);
-    return true;
-  #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
-        return false;
-
-    // This checks if the input layout matches the output layout
-   #if ! JucePlugin_IsSynth
-    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
-        return false;
-   #endif
-
-    return true;
-  #endif
-}
-#endif
-
-void ParametricEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
-{
-    juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
-    auto totalNumOutputChannels = getTotalNumOutputChannels();
-
-    // In case we have more outputs than inputs, this code clears any output
-    // channels that didn't contain input data, (because these aren't
-    // guaranteed to be empty - they may contain garbage).
-    // This is here to avoid people getting screaming feedback
-    // when they first compile a plugin, but obviously you don't need to keep
-    // this code if your algorithm always overwrites all the output channels.
-    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
-    
-    // update all filters
-    updateFilters();
-    
-    
-    // audio blocks
-    juce::dsp::AudioBlock<float> block(buffer);
-    auto left_block = block.getSingleChannelBlock(0);
-    auto right_block = block.getSingleChannelBlock(1);
-    
-    // audio contexts
-    juce::dsp::ProcessContextReplacing<float> left_context(left_block);
-    juce::dsp::ProcessContextReplacing<float> right_context(right_block);
-
-    left_chain.process(left_context);
-    right_chain.process(right_context);
-    
-    
-}
-
-//==============================================================================
-bool ParametricEQAudioProcessor::hasEditor() const
-{
-    return true; // (change this to false if you choose to not supply an editor)
-}
-
-juce::AudioProcessorEditor* ParametricEQAudioProcessor::createEditor()
-{
-    //return new ParametricEQAudioProcessorEditor (*this);
-    return new juce::GenericAudioProcessorEditor(*this);
-}
-
-//==============================================================================
-void ParametricEQAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
-{
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-}
-
-void ParametricEQAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
-{
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-}
-
-
-// Chain Settings for parameter layout
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
-{
-    ChainSettings settings;
-    
-    settings.low_cut_freq = apvts.getRawParameterValue("LowCut Freq")->load();
-    settings.high_cut_freq = apvts.getRawParameterValue("HiCut Freq")->load();
-    settings.peak1_freq = apvts.getRawParameterValue("Peak1 Freq")->load();
-    settings.peak1_gain_db = apvts.getRawParameterValue("Peak1 Gain")->load();
-    settings.peak1_q = apvts.getRawParameterValue("Peak1 Q")->load();
-    settings.peak2_freq = apvts.getRawParameterValue("Peak2 Freq")->load();
-    settings.peak2_gain_db = apvts.getRawParameterValue("Peak2 Gain")->load();
-    settings.peak2_q = apvts.getRawParameterValue("Peak2 Q")->load();
-    settings.peak3_freq = apvts.getRawParameterValue("Peak3 Freq")->load();
-    settings.peak3_gain_db = apvts.getRawParameterValue("Peak3 Gain")->load();
-    settings.peak3_q = apvts.getRawParameterValue("Peak3 Q")->load();
-    settings.low_cut_slope = static_cast<Slope>(apvts.getRawParameterValue("LowCut Slope")->load());
-    settings.high_cut_slope = static_cast<Slope>(apvts.getRawParameterValue("HiCut Slope")->load());
-
-    return settings;
-}
-
-// Update filter with chain settings
-void ParametricEQAudioProcessor::updatePeakFilter(const ChainSettings &chain_settings)
-{
-    auto peak1_coefficients = juce::dsp::IIR::Coefficients<float>::makePeakFilter(getSampleRate(), chain_settings.peak1_freq, chain_settings.peak1_q, juce::Decibels::decibelsToGain(chain_settings.peak1_gain_db));
-    
-    auto peak2_coefficients = juce::dsp::IIR::Coefficients<float>::makePeakFilter(getSampleRate(), chain_settings.peak2_freq, chain_settings.peak2_q, juce::Decibels::decibelsToGain(chain_settings.peak2_gain_db));
-    
-    auto peak3_coefficients = juce::dsp::IIR::Coefficients<float>::makePeakFilter(getSampleRate(), chain_settings.peak3_freq, chain_settings.peak3_q, juce::Decibels::decibelsToGain(chain_settings.peak3_gain_db));
-    
-    updateCoefficients(left_chain.get<ChainPositions::Peak1>().coefficients, peak1_coefficients);
-    updateCoefficients(left_chain.get<ChainPositions::Peak2>().coefficients, peak2_coefficients);
-    updateCoefficients(left_chain.get<ChainPositions::Peak3>().coefficients, peak3_coefficients);
-    updateCoefficients(right_chain.get<ChainPositions::Peak1>().coefficients, peak1_coefficients);
-    updateCoefficients(right_chain.get<ChainPositions::Peak2>().coefficients, peak2_coefficients);
-    updateCoefficients(right_chain.get<ChainPositions::Peak3>().coefficients, peak3_coefficients);
-
-}
-
-// Update coefficients helper
-void ParametricEQAudioProcessor::updateCoefficients(Coefficients &old, const Coefficients &replace)
-{
-    *old = *replace;
-}
-
-void ParametricEQAudioProcessor::updateLowCutFilters(const ChainSettings &chain_settings)
-{
-    auto low_cut_coefficients = juce::dsp::FilterDesign<float>::designIIRHighpassHighOrderButterworthMethod(chain_settings.low_cut_freq, getSampleRate(), 2 * (chain_settings.low_cut_slope + 1));
-    
-    // Setup low cut left channel
-    auto& left_low_cut = left_chain.get<ChainPositions::LowCut>();
-    updateCutFilter(left_low_cut, low_cut_coefficients, chain_settings.low_cut_slope);
-    
-    
-    // Setup low cut right channel
-    auto& right_low_cut = right_chain.get<ChainPositions::LowCut>();
-    updateCutFilter(right_low_cut, low_cut_coefficients, chain_settings.low_cut_slope);
-}
-
-
-void ParametricEQAudioProcessor::updateHighCutFilters(const ChainSettings &chain_settings)
-{
-    auto high_cut_coefficients = juce::dsp::FilterDesign<float>::designIIRLowpassHighOrderButterworthMethod(chain_settings.high_cut_freq, getSampleRate(), 2 * (chain_settings.high_cut_slope + 1));
-    
-    // Setup high cut left channel
-    auto& left_high_cut = left_chain.get<ChainPositions::HiCut>();
-    updateCutFilter(left_high_cut, high_cut_coefficients, chain_settings.high_cut_slope);
-    
-    
-    // Setup high cut right channel
-    auto& right_high_cut = right_chain.get<ChainPositions::HiCut>();
-    updateCutFilter(right_high_cut, high_cut_coefficients, chain_settings.high_cut_slope);
-}
-
-void ParametricEQAudioProcessor::updateFilters()
-{
-    auto chain_settings = getChainSettings(apvts);
-    updateLowCutFilters(chain_settings);
-    updatePeakFilter(chain_settings);
-    updateHighCutFilters(chain_settings);
-}
-
-
-
-juce::AudioProcessorValueTreeState::ParameterLayout ParametricEQAudioProcessor::createParameterLayout()
-{
-    juce::AudioProcessorValueTreeState::ParameterLayout layout;
-    
-    // Low Cut
-    layout.add(std::make_unique<juce::AudioParameterFloat>("LowCut Freq",
-                                                           "LowCut Freq",
-                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.2f), 20.f));
-    
-    // High Cut
-    layout.add(std::make_unique<juce::AudioParameterFloat>("HiCut Freq",
-                                                           "HiCut Freq",
-                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.2f), 20000.f));
-    
-    // Peak 1
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak1 Freq",
-                                                           "Peak1 Freq",
-                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.2f), 500.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak1 Gain",
-                                                           "Peak1 Gain",
-                                                           juce::NormalisableRange<float>(-24.f, 24, 0.5f, 1.f), 0.0f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak1 Q",
-                                                           "Peak1 Q",
-                                                           juce::NormalisableRange<float>(0.1f, 10, 0.05f, 1.f), 1.f));
-    
-    // Peak 2
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak2 Freq",
-                                                           "Peak2 Freq",
-                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.2f), 750.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak2 Gain",
-                                                           "Peak2 Gain",
-                                                           juce::NormalisableRange<float>(-24.f, 24, 0.5f, 1.f), 0.0f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak2 Q",
-                                                           "Peak2 Q",
-                                                           juce::NormalisableRange<float>(0.1f, 10, 0.05f, 1.f), 1.f));
-    
-    // Peak 3
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak3 Freq",
-                                                           "Peak3 Freq",
-                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.2f), 1200.f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak3 Gain",
-                                                           "Peak3 Gain",
-                                                           juce::NormalisableRange<float>(-24.f, 24, 0.5f, 1.f), 0.0f));
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Peak3 Q",
-                                                           "Peak3 Q",
-                                                           juce::NormalisableRange<float>(0.1f, 10, 0.05f, 1.f), 1.f));
-    
-
-    // Cut Slope String Array
-    juce::StringArray string_array;
-    for (int i = 0; i < 4; i++)
-    {
-        juce::String string;
-        string << (12 + i * 12);
-        string << " db/Oct";
-        string_array.add(string);
-    }
-    
-    // Cut Slope Choices
-    layout.add(std::make_unique<juce::AudioParameterChoice>("LowCut Slope", "LowCut Slope", string_array, 0));
-    layout.add(std::make_unique<juce::AudioParameterChoice>("HiCut Slope", "HiCut Slope", string_array, 0));
-
-    
-    return layout;
-}
-
-//==============================================================================
-// This creates new instances of the plugin..
-juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
-{
-    return new ParametricEQAudioProcessor();
-}
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin processor.
+
+  ==============================================================================
+*/
+
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+
+//==============================================================================
+ParametricEQAudioProcessor::ParametricEQAudioProcessor()
+#ifndef JucePlugin_PreferredChannelConfigurations
+     : AudioProcessor (BusesProperties()
+                     #if ! JucePlugin_IsMidiEffect
+                      #if ! JucePlugin_IsSynth
+                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
+                      #endif
+                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
+                     #endif
+                       )
+#endif
+{
+    for (auto* parameter : getParameters())
+    {
+        if (auto* with_id = dynamic_cast<juce::AudioProcessorParameterWithID*>(parameter))
+        {
+            parameter_listeners.push_back(std::make_unique<ParameterListener>(*this, with_id->paramID));
+            apvts.addParameterListener(with_id->paramID, parameter_listeners.back().get());
+        }
+        
+        // The binary state stores parameters by ID hash, two IDs must never share one
+        if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*>(parameter))
+        {
+            const auto is_unique = state_parameter_indices.emplace(ranged->paramID.hashCode(), state_parameters.size()).second;
+            jassert(is_unique);
+            juce::ignoreUnused(is_unique);
+            state_parameters.push_back(ranged);
+        }
+    }
+    
+    design_thread->addClient(this);
+}
+
+ParametricEQAudioProcessor::~ParametricEQAudioProcessor()
+{
+    cancelPendingUpdate();
+    design_thread->removeClient(this);
+    
+    for (auto& listener : parameter_listeners)
+        apvts.removeParameterListener(listener->parameter_id, listener.get());
+}
+
+//==============================================================================
+const juce::String ParametricEQAudioProcessor::getName() const
+{
+    return JucePlugin_Name;
+}
+
+bool ParametricEQAudioProcessor::acceptsMidi() const
+{
+   #if JucePlugin_WantsMidiInput
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+bool ParametricEQAudioProcessor::producesMidi() const
+{
+   #if JucePlugin_ProducesMidiOutput
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+bool ParametricEQAudioProcessor::isMidiEffect() const
+{
+   #if JucePlugin_IsMidiEffect
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+double ParametricEQAudioProcessor::getTailLengthSeconds() const
+{
+    // The FIR rings for a whole kernel after the input buffering
+    if (isLinearPhase() && getSampleRate() > 0.0)
+        return (linear_phase_layout.partition_size + linear_phase_layout.kernel_length) / getSampleRate();
+    
+    // Computed from the poles of whatever is in the chain
+    return chain_tail_seconds.load();
+}
+
+int ParametricEQAudioProcessor::getNumPrograms()
+{
+    return preset_bank.size();
+}
+
+int ParametricEQAudioProcessor::getCurrentProgram()
+{
+    return current_program.load();
+}
+
+// Moves the parameters to the preset and asks the design stage for its
+// prebuilt coefficients. Whichever thread the host calls this on, it
+// designs nothing and takes no lock.
+void ParametricEQAudioProcessor::setCurrentProgram (int index)
+{
+    if (! juce::isPositiveAndBelow(index, preset_bank.size()))
+        return;
+    
+    current_program = index;
+    
+    auto settings = chain_parameters.load();
+    applyProgramSettings(preset_bank.getSettings(index), settings);
+    
+    // The design stage holds off while the parameters move, so it never
+    // publishes a set that is half this program and half the last one
+    setting_program = true;
+    setProgramParameters(apvts, settings);
+    requested_program = index;
+    setting_program = false;
+}
+
+// Hands the preset's prebuilt set to the audio thread, with the user's
+// sides. Only designs if the bank is behind the user's topologies or
+// design method (preparePresets is already on its way then).
+void ParametricEQAudioProcessor::loadProgram(int program, double sample_rate)
+{
+    // The parameters already are the program's, this set covers every band
+    dirty_bands = 0;
+    const auto settings = chain_parameters.load();
+    
+    if (preset_bank.isPreparedFor(sample_rate, settings))
+    {
+        designed_coefficients = preset_bank.getCoefficients(program);
+        setStereoLayout(settings, designed_coefficients);
+    }
+    else
+    {
+        designChainCoefficients(settings, sample_rate, designed_coefficients, all_bands, coefficient_cache);
+        instrumentation.countDesignedBands(all_bands);
+    }
+    
+    coefficient_handoff.getWriteBuffer() = designed_coefficients;
+    coefficient_handoff.publish();
+    ++design_generation;
+    
+    if (isLinearPhase())
+        designKernel();
+    
+    pending_program = program;
+}
+
+void ParametricEQAudioProcessor::preparePresets()
+{
+    const auto sample_rate = design_sample_rate.load();
+    const auto settings = chain_parameters.load();
+    
+    // prepareToPlay prepares the bank for the first time
+    if (sample_rate <= 0.0)
+        return;
+    
+    const juce::ScopedLock sl(design_lock);
+    
+    if (! preset_bank.isPreparedFor(sample_rate, settings))
+        preset_bank.prepare(sample_rate, settings, coefficient_cache);
+}
+
+const juce::String ParametricEQAudioProcessor::getProgramName (int index)
+{
+    return juce::isPositiveAndBelow(index, preset_bank.size()) ? preset_bank.getName(index) : juce::String();
+}
+
+void ParametricEQAudioProcessor::changeProgramName (int index, const juce::String& newName)
+{
+    if (juce::isPositiveAndBelow(index, preset_bank.size()))
+        preset_bank.setName(index, newName);
+}
+
+//==============================================================================
+void ParametricEQAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
+{
+    // Use this method as the place to do any pre-playback
+    // initialisation that you need..
+    
+    // Bands coming in or out of the chain crossfade over a few milliseconds
+    fade_length = juce::jmax(1, juce::roundToInt(sampleRate * 0.005));
+    
+    // The host picks the precision before preparing, only that one is allocated
+    if (isUsingDoublePrecision())
+        prepareChains(double_chains, samplesPerBlock);
+    else
+        prepareChains(float_chains, samplesPerBlock);
+    
+    // Linear phase buffers are always allocated so the mode can switch live
+    linear_phase_layout = LinearPhaseLayout::create(sampleRate, linear_phase_partition_size.load());
+    convolver.prepare(getMainBusNumInputChannels(), linear_phase_layout);
+    convolver_buffer.setSize(isUsingDoublePrecision() ? getMainBusNumInputChannels() : 0, samplesPerBlock);
+    
+    dynamics.prepare(sampleRate, samplesPerBlock);
+    
+    {
+        const juce::ScopedLock sl(design_lock);
+        kernel_designer.prepare(sampleRate, linear_phase_layout);
+        kernel_handoff.forEachBuffer([this](LinearPhaseKernels& kernels)
+        {
+            kernels.spectra.assign((size_t) (LinearPhaseKernels::num_kernels * linear_phase_layout.getKernelFloats()), 0.f);
+        });
+        
+        // Split stereo modes only apply to a stereo pair, like FilterChain::setSides
+        linear_phase_stereo = getMainBusNumInputChannels() == 2;
+        
+        // Every preset is ready to switch to before playback starts
+        preset_bank.prepare(sampleRate, chain_parameters.load(), coefficient_cache);
+    }
+    
+    // Design everything for the new sample rate before playback starts
+    design_sample_rate = sampleRate;
+    dirty_bands = all_bands;
+    designPendingBands();
+    applyPendingCoefficients();
+    fade_remaining = 0;
+    
+    // The kernel is only kept up to date in linear phase mode, but start
+    // with a valid one either way
+    if (! isLinearPhase())
+    {
+        const juce::ScopedLock sl(design_lock);
+        designKernel();
+    }
+    
+    if (kernel_handoff.update())
+        convolver.setKernels(kernel_handoff.getReadBuffer());
+    
+    updateLatency();
+    
+    analyzer.prepare(sampleRate);
+    
+    // Smoothing restarts from the current settings
+    was_smoothing = false;
+    was_linear_phase = isLinearPhase();
+    pending_program = -1;
+    silent_samples = 0;
+    idle = false;
+    
+}
+
+template <typename SampleType>
+void ParametricEQAudioProcessor::prepareChains(Chains<SampleType>& chains, int samples_per_block)
+{
+    const auto num_channels = getMainBusNumInputChannels();
+    const auto use_mixed_precision = mixed_precision.load();
+    
+    chains.chain.prepare(num_channels, samples_per_block, use_mixed_precision);
+    chains.fade_chain.prepare(num_channels, fade_length, use_mixed_precision);
+    chains.fade_buffer.setSize(num_channels, fade_length);
+    
+    // Wide buses get helper threads, one per channel group beyond the first
+    float_chains.chain.setWorkerPool(nullptr);
+    double_chains.chain.setWorkerPool(nullptr);
+    worker_pool.reset();
+    
+    if (num_channels >= parallel_channel_threshold.load())
+    {
+        auto num_workers = juce::jmin(chains.chain.getNumChannelGroups() - 1, juce::SystemStats::getNumCpus() - 1);
+        
+        if (num_workers > 0)
+        {
+            worker_pool = std::make_unique<ChannelWorkerPool>(num_workers);
+            chains.chain.setWorkerPool(worker_pool.get());
+        }
+    }
+}
+
+template <typename SampleType>
+ParametricEQAudioProcessor::Chains<SampleType>& ParametricEQAudioProcessor::getChains() noexcept
+{
+    if constexpr (std::is_same<SampleType, double>::value)
+        return double_chains;
+    else
+        return float_chains;
+}
+
+void ParametricEQAudioProcessor::releaseResources()
+{
+    // When playback stops, you can use this as an opportunity to free up any
+    // spare memory, etc.
+    float_chains.chain.setWorkerPool(nullptr);
+    double_chains.chain.setWorkerPool(nullptr);
+    worker_pool.reset();
+}
+
+bool ParametricEQAudioProcessor::supportsDoublePrecisionProcessing() const
+{
+    return true;
+}
+
+#ifndef JucePlugin_PreferredChannelConfigurations
+bool ParametricEQAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
+{
+  #if JucePlugin_IsMidiEffect
+    juce::ignoreUnused (layouts);
+    return true;
+  #else
+    // Any layout from mono up to third order ambisonics, the chain doesn't
+    // care what the channels mean since every channel gets the same EQ
+    const auto num_channels = layouts.getMainOutputChannelSet().size();
+    
+    if (layouts.getMainOutputChannelSet().isDisabled() || num_channels > max_channels)
+        return false;
+    
+    // This checks if the input layout matches the output layout
+   #if ! JucePlugin_IsSynth
+    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
+        return false;
+    
+    // The sidechain only feeds the dynamic bands' detectors, mixed to mono
+    if (layouts.getChannelSet(true, 1).size() > 2)
+        return false;
+   #endif
+    
+    return true;
+  #endif
+}
+#endif
+
+void ParametricEQAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples(buffer);
+}
+
+void ParametricEQAudioProcessor::processBlock (juce::AudioBuffer<double>& buffer, juce::MidiBuffer& midiMessages)
+{
+    processSamples(buffer);
+}
+
+template <typename SampleType>
+void ParametricEQAudioProcessor::processSamples (juce::AudioBuffer<SampleType>& buffer) noexcept
+{
+    // Offline renders may design in place, only live processing must be realtime safe
+    const RealtimeMonitor::ScopedRealtime realtime(instrumentation.monitor, ! isNonRealtime());
+    const DurationHistogram::ScopedTimer block_timer(instrumentation.block_time);
+    
+    juce::ScopedNoDenormals noDenormals;
+    auto totalNumInputChannels  = getTotalNumInputChannels();
+    auto totalNumOutputChannels = getTotalNumOutputChannels();
+    
+    // In case we have more outputs than inputs, this code clears any output
+    // channels that didn't contain input data, (because these aren't
+    // guaranteed to be empty - they may contain garbage).
+    // This is here to avoid people getting screaming feedback
+    // when they first compile a plugin, but obviously you don't need to keep
+    // this code if your algorithm always overwrites all the output channels.
+    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+        buffer.clear (i, 0, buffer.getNumSamples());
+    
+    // The sidechain's channels come after the main bus, only the main bus is filtered
+    const auto num_channels = juce::jmin(getMainBusNumInputChannels(), buffer.getNumChannels());
+    
+    analyzer.pushPre(buffer.getArrayOfReadPointers(), num_channels, buffer.getNumSamples());
+    
+    if (! skipSilence(buffer, num_channels))
+        processFilters(buffer, num_channels);
+    
+    analyzer.pushPost(buffer.getArrayOfReadPointers(), num_channels, buffer.getNumSamples());
+}
+
+// Once the input has been silent for longer than the tail, the output is
+// silent too and nothing needs to run until the input comes back
+template <typename SampleType>
+bool ParametricEQAudioProcessor::skipSilence(juce::AudioBuffer<SampleType>& buffer, int num_channels) noexcept
+{
+    const auto num_samples = buffer.getNumSamples();
+    
+    for (int ch = 0; ch < num_channels; ++ch)
+    {
+        if (buffer.getMagnitude(ch, 0, num_samples) > (SampleType) silence_threshold)
+        {
+            silent_samples = 0;
+            idle = false;
+            return false;
+        }
+    }
+    
+    silent_samples += num_samples;
+    
+    const auto tail_samples = isLinearPhase() ? (juce::int64) (linear_phase_layout.partition_size + linear_phase_layout.kernel_length)
+                                              : (juce::int64) std::ceil(chain_tail_seconds.load() * design_sample_rate.load());
+    
+    if (silent_samples - num_samples < tail_samples)
+        return false;
+    
+    if (! idle)
+    {
+        // Whatever is left in the filters is below the tail's decay threshold
+        idle = true;
+        getChains<SampleType>().chain.reset();
+        convolver.reset();
+        dynamics.reset();
+        fade_remaining = 0;
+    }
+    
+    for (int ch = 0; ch < num_channels; ++ch)
+        buffer.clear(ch, 0, num_samples);
+    
+    return true;
+}
+
+template <typename SampleType>
+void ParametricEQAudioProcessor::processFilters(juce::AudioBuffer<SampleType>& buffer, int num_channels) noexcept
+{
+    const auto num_samples = buffer.getNumSamples();
+    const auto sub_block_size = smoothing_sub_block_size.load();
+    
+    // Offline renders design in place, so a program change lands on this block
+    if (isNonRealtime() && requested_program.load() >= 0)
+        designPendingBands();
+    
+    switchToPendingProgram();
+    
+    if (isLinearPhase())
+    {
+        processLinearPhase(buffer, num_channels);
+        return;
+    }
+    
+    if (was_linear_phase)
+    {
+        // The IIR state is from before the switch
+        was_linear_phase = false;
+        getChains<SampleType>().chain.reset();
+        fade_remaining = 0;
+    }
+    
+    // Dynamic bands move at control rate, so they need sub-blocks even with smoothing off
+    const auto dynamics_settings = dynamics_parameters.load();
+    
+    if (sub_block_size > 0 || dynamics_settings.isAnyBandDynamic())
+    {
+        processSmoothed(buffer, num_channels, sub_block_size > 0 ? sub_block_size : dynamics_sub_block_size, dynamics_settings);
+        return;
+    }
+    
+    if (was_smoothing)
+    {
+        // The design stage may have nothing new, make it redo everything
+        was_smoothing = false;
+        dirty_bands.fetch_or(all_bands);
+    }
+    
+    // pick up coefficients finished by the design stage, offline renders
+    // can afford to design in place so automation stays block accurate
+    if (isNonRealtime())
+        designPendingBands();
+    
+    applyPendingCoefficients();
+    
+    
+    // one fused pass, all channels at once
+    processChain(buffer, num_channels, 0, num_samples);
+}
+
+// Program change, audio thread. The program's set arrives through the
+// handoff, published by loadProgram before the switch, this just makes
+// sure it fades in and the smoother doesn't ramp.
+void ParametricEQAudioProcessor::switchToPendingProgram() noexcept
+{
+    const auto program = pending_program.exchange(-1);
+    
+    if (program < 0)
+        return;
+    
+    // Already picked up by an earlier block, or newer, either way the latest
+    coefficient_handoff.update();
+    const auto& coefficients = coefficient_handoff.getReadBuffer();
+    
+    if (was_smoothing)
+    {
+        smoother.jumpTo(chain_parameters.load());
+        smoothed_coefficients = coefficients;
+    }
+    
+    loadCoefficients(coefficients, true);
+}
+
+// Loads a coefficient set, crossfading if bands come in or out of the chain
+void ParametricEQAudioProcessor::loadCoefficients(const ChainCoefficients& coefficients, bool crossfade) noexcept
+{
+    if (isUsingDoublePrecision())
+        loadCoefficients(double_chains, coefficients, crossfade);
+    else
+        loadCoefficients(float_chains, coefficients, crossfade);
+    
+    chain_tail_seconds.store(getChainTailSeconds(coefficients, design_sample_rate.load()), std::memory_order_relaxed);
+}
+
+template <typename SampleType>
+void ParametricEQAudioProcessor::loadCoefficients(Chains<SampleType>& chains, const ChainCoefficients& coefficients, bool crossfade) noexcept
+{
+    auto& chain = chains.chain;
+    const auto old_mask = chain.getActiveSections();
+    const auto new_mask = getActiveSectionMask(coefficients);
+    const auto switched_topology = chain.getSvfSections() ^ getSvfSectionMask(coefficients);
+    
+    // Sections changing sides, or every section when mid / side goes on or off
+    auto switched_sides = (chain.getSideSections(0) ^ getSideSectionMask(coefficients, 0))
+                        | (chain.getSideSections(1) ^ getSideSectionMask(coefficients, 1));
+    
+    if (chain.isMidSide() != coefficients.mid_side)
+        switched_sides = ~0u;
+    
+    switched_sides &= new_mask | old_mask;
+    
+    if (crossfade || new_mask != old_mask || switched_topology != 0 || switched_sides != 0)
+    {
+        // Fade from what's playing now, or keep going if a fade already is
+        if (fade_remaining == 0)
+        {
+            chains.fade_chain.copyFrom(chain);
+            fade_remaining = fade_length;
+        }
+        
+        // Sections coming back, or moving to the other topology or side, start clean rather than from stale state
+        chain.resetSections((new_mask & ~old_mask) | switched_topology | switched_sides);
+    }
+    
+    applyChainCoefficients(chain, coefficients);
+    instrumentation.countCoefficientLoad();
+}
+
+template <typename SampleType>
+void ParametricEQAudioProcessor::processChain(juce::AudioBuffer<SampleType>& buffer, int num_channels, int start_sample, int num_samples) noexcept
+{
+    auto& chains = getChains<SampleType>();
+    auto& fade_buffer = chains.fade_buffer;
+    auto* const* channels = buffer.getArrayOfWritePointers();
+    const auto fade_samples = juce::jmin(fade_remaining, num_samples);
+    
+    // The chain as it was before the change runs alongside on a copy
+    for (int ch = 0; ch < num_channels && fade_samples > 0; ++ch)
+        fade_buffer.copyFrom(ch, 0, buffer, ch, start_sample, fade_samples);
+    
+    if (fade_samples > 0)
+        chains.fade_chain.process(fade_buffer.getArrayOfWritePointers(), num_channels, 0, fade_samples);
+    
+    if (instrumentation.isStageTiming())
+    {
+        for (int position = LowCut; position <= HiCut; ++position)
+        {
+            const auto band = static_cast<ChainPositions>(position);
+            
+            if ((chains.chain.getActiveSections() & getBandSectionMask(band)) == 0)
+                continue;
+            
+            const DurationHistogram::ScopedTimer stage_timer(instrumentation.stage_time[(size_t) band]);
+            chains.chain.processBand(band, channels, num_channels, start_sample, num_samples);
+        }
+    }
+    else
+    {
+        chains.chain.process(channels, num_channels, start_sample, num_samples);
+    }
+    
+    if (fade_samples <= 0)
+        return;
+    
+    const auto fade_start = fade_length - fade_remaining;
+    
+    for (int ch = 0; ch < num_channels; ++ch)
+    {
+        const auto* old_output = fade_buffer.getReadPointer(ch);
+        auto* output = channels[ch] + start_sample;
+        
+        for (int i = 0; i < fade_samples; ++i)
+        {
+            const auto ramp = (SampleType) (fade_start + i + 1) / (SampleType) fade_length;
+            output[i] = old_output[i] + (output[i] - old_output[i]) * ramp;
+        }
+    }
+    
+    fade_remaining -= fade_samples;
+}
+
+// Smoothing mode: the audio thread designs the ramping bands once per sub-block
+template <typename SampleType>
+void ParametricEQAudioProcessor::processSmoothed(juce::AudioBuffer<SampleType>& buffer, int num_channels, int sub_block_size,
+                                                 const DynamicsSettings& dynamics_settings) noexcept
+{
+    const auto chain_settings = chain_parameters.load();
+    
+    if (! was_smoothing)
+    {
+        was_smoothing = true;
+        smoother.reset(getSampleRate(), chain_settings, smoothed_coefficients);
+        dynamics.reset();
+        loadCoefficients(smoothed_coefficients);
+    }
+    
+    smoother.setTargets(chain_settings);
+    dynamics.setSettings(dynamics_settings, chain_settings);
+    
+    const auto num_samples = buffer.getNumSamples();
+    const auto sidechain = getBusCount(true) > 1 ? getBusBuffer(buffer, true, 1) : juce::AudioBuffer<SampleType>();
+    
+    for (int start = 0; start < num_samples; start += sub_block_size)
+    {
+        const auto length = juce::jmin(sub_block_size, num_samples - start);
+        
+        // Detectors read the sub-block before it's filtered
+        const auto dynamic_bands = dynamics.process(buffer.getArrayOfReadPointers(), num_channels,
+                                                    sidechain.getArrayOfReadPointers(), sidechain.getNumChannels(), start, length);
+        
+        if (dynamic_bands != 0)
+            smoother.setGainOffsets(dynamics.getGainOffsets(), dynamic_bands);
+        
+        if (smoother.isSmoothing())
+        {
+            const auto moved_bands = smoother.advance(length, smoothed_coefficients);
+            instrumentation.countSmoothedBands(moved_bands);
+            
+            if (moved_bands != 0)
+                loadCoefficients(smoothed_coefficients);
+        }
+        
+        processChain(buffer, num_channels, start, length);
+    }
+}
+
+// Linear phase mode: the chain's magnitude response as an FIR, crossfaded on every redesign
+template <typename SampleType>
+void ParametricEQAudioProcessor::processLinearPhase(juce::AudioBuffer<SampleType>& buffer, int num_channels) noexcept
+{
+    if (! was_linear_phase)
+    {
+        was_linear_phase = true;
+        was_smoothing = false;
+        convolver.reset();
+    }
+    
+    if (isNonRealtime())
+        designPendingBands();
+    
+    // Keep the IIR coefficients current too so switching back is seamless
+    applyPendingCoefficients();
+    
+    if (kernel_handoff.update())
+        convolver.setKernels(kernel_handoff.getReadBuffer());
+    
+    if constexpr (std::is_same<SampleType, float>::value)
+    {
+        convolver.process(buffer.getArrayOfWritePointers(), num_channels, buffer.getNumSamples());
+    }
+    else
+    {
+        // juce::dsp::FFT is float only, so the convolution runs on a float copy
+        const auto chunk_size = convolver_buffer.getNumSamples();
+        
+        for (int offset = 0; offset < buffer.getNumSamples(); offset += chunk_size)
+        {
+            const auto chunk = juce::jmin(chunk_size, buffer.getNumSamples() - offset);
+            
+            for (int ch = 0; ch < num_channels; ++ch)
+                std::transform(buffer.getReadPointer(ch, offset), buffer.getReadPointer(ch, offset) + chunk,
+                               convolver_buffer.getWritePointer(ch), [](double v) { return (float) v; });
+            
+            convolver.process(convolver_buffer.getArrayOfWritePointers(), num_channels, chunk);
+            
+            for (int ch = 0; ch < num_channels; ++ch)
+                std::copy(convolver_buffer.getReadPointer(ch), convolver_buffer.getReadPointer(ch) + chunk, buffer.getWritePointer(ch, offset));
+        }
+    }
+}
+
+bool ParametricEQAudioProcessor::isLinearPhase() const noexcept
+{
+    return phase_mode->load() > 0.5f;
+}
+
+// Hosts need the new delay whenever the mode changes
+void ParametricEQAudioProcessor::updateLatency()
+{
+    setLatencySamples(isLinearPhase() ? linear_phase_layout.getLatencySamples() : 0);
+}
+
+void ParametricEQAudioProcessor::handleAsyncUpdate()
+{
+    updateLatency();
+    
+    if (presets_stale.exchange(false))
+        preparePresets();
+}
+
+//==============================================================================
+bool ParametricEQAudioProcessor::hasEditor() const
+{
+    return true; // (change this to false if you choose to not supply an editor)
+}
+
+juce::AudioProcessorEditor* ParametricEQAudioProcessor::createEditor()
+{
+    return new ParametricEQAudioProcessorEditor (*this);
+}
+
+//==============================================================================
+void ParametricEQAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
+{
+    // A few bytes per parameter rather than a kilobyte of XML. IDs are
+    // stored as hashes so parameters can be added or reordered later.
+    juce::MemoryOutputStream stream(destData, false);
+    
+    stream.writeInt((int) state_magic);
+    stream.writeShort((short) state_version);
+    stream.writeShort((short) current_program.load());
+    stream.writeShort((short) state_parameters.size());
+    
+    for (auto* parameter : state_parameters)
+    {
+        stream.writeInt(parameter->paramID.hashCode());
+        stream.writeFloat(parameter->convertFrom0to1(parameter->getValue()));
+    }
+}
+
+void ParametricEQAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    juce::MemoryInputStream stream(data, (size_t) juce::jmax(0, sizeInBytes), false);
+    
+    if (sizeInBytes >= state_header_size && (juce::uint32) stream.readInt() == state_magic)
+    {
+        // A newer build may have changed what the values mean, leave the instance as it is
+        const auto version = (int) stream.readShort();
+        
+        if (version > state_version)
+            return;
+        
+        const auto program = (int) stream.readShort();
+        const auto num_parameters = (int) stream.readShort();
+        
+        // Unknown IDs are skipped and missing ones go back to their default,
+        // so a session recalls the same whatever was touched before loading
+        std::vector<float> values;
+        values.reserve(state_parameters.size());
+        
+        for (auto* parameter : state_parameters)
+            values.push_back(parameter->getDefaultValue());
+        
+        for (int i = 0; i < num_parameters && stream.getNumBytesRemaining() >= 8; ++i)
+        {
+            const auto id_hash = stream.readInt();
+            const auto value = stream.readFloat();
+            const auto found = state_parameter_indices.find(id_hash);
+            
+            if (found != state_parameter_indices.end())
+                values[found->second] = state_parameters[found->second]->convertTo0to1(value);
+        }
+        
+        // Only the parameters that move notify the host
+        for (size_t i = 0; i < state_parameters.size(); ++i)
+            if (values[i] != state_parameters[i]->getValue())
+                state_parameters[i]->setValueNotifyingHost(values[i]);
+        
+        if (juce::isPositiveAndBelow(program, preset_bank.size()))
+            current_program = program;
+        
+        return;
+    }
+    
+    // XML state, as copyXmlToBinary writes it
+    if (auto xml = getXmlFromBinary(data, sizeInBytes))
+        if (xml->hasTagName(apvts.state.getType()))
+            apvts.replaceState(juce::ValueTree::fromXml(*xml));
+}
+
+// Chain Settings for parameter layout
+ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
+{
+    return ChainParameters(apvts).load();
+}
+
+ChainParameters::ChainParameters(juce::AudioProcessorValueTreeState& apvts)
+{
+    low_cut_freq = apvts.getRawParameterValue("LowCut Freq");
+    high_cut_freq = apvts.getRawParameterValue("HiCut Freq");
+    low_cut_slope = apvts.getRawParameterValue("LowCut Slope");
+    high_cut_slope = apvts.getRawParameterValue("HiCut Slope");
+    low_cut_topology = apvts.getRawParameterValue("LowCut Topology");
+    high_cut_topology = apvts.getRawParameterValue("HiCut Topology");
+    design_method = apvts.getRawParameterValue("Filter Design");
+    low_cut_placement = apvts.getRawParameterValue("LowCut Placement");
+    high_cut_placement = apvts.getRawParameterValue("HiCut Placement");
+    stereo_mode = apvts.getRawParameterValue("Stereo Mode");
+    
+    for (int band = 0; band < max_bands; ++band)
+    {
+        const auto i = (size_t) band;
+        band_freq[i] = apvts.getRawParameterValue(getBandParameterID(band, "Freq"));
+        band_gain_db[i] = apvts.getRawParameterValue(getBandParameterID(band, "Gain"));
+        band_q[i] = apvts.getRawParameterValue(getBandParameterID(band, "Q"));
+        band_type[i] = apvts.getRawParameterValue(getBandParameterID(band, "Type"));
+        band_enabled[i] = apvts.getRawParameterValue(getBandParameterID(band, "Enabled"));
+        band_topology[i] = apvts.getRawParameterValue(getBandParameterID(band, "Topology"));
+        band_placement[i] = apvts.getRawParameterValue(getBandParameterID(band, "Placement"));
+    }
+}
+
+DynamicsParameters::DynamicsParameters(juce::AudioProcessorValueTreeState& apvts)
+{
+    for (int band = 0; band < max_bands; ++band)
+    {
+        const auto i = (size_t) band;
+        threshold_db[i] = apvts.getRawParameterValue(getBandParameterID(band, "Threshold"));
+        ratio[i] = apvts.getRawParameterValue(getBandParameterID(band, "Ratio"));
+        attack_ms[i] = apvts.getRawParameterValue(getBandParameterID(band, "Attack"));
+        release_ms[i] = apvts.getRawParameterValue(getBandParameterID(band, "Release"));
+        dynamic[i] = apvts.getRawParameterValue(getBandParameterID(band, "Dynamic"));
+        sidechain[i] = apvts.getRawParameterValue(getBandParameterID(band, "Sidechain"));
+    }
+}
+
+DynamicsSettings DynamicsParameters::load() const noexcept
+{
+    DynamicsSettings settings;
+    
+    for (size_t i = 0; i < (size_t) max_bands; ++i)
+    {
+        settings.threshold_db[i] = threshold_db[i]->load();
+        settings.ratio[i] = ratio[i]->load();
+        settings.attack_ms[i] = attack_ms[i]->load();
+        settings.release_ms[i] = release_ms[i]->load();
+        settings.dynamic[i] = dynamic[i]->load() >= 0.5f;
+        settings.sidechain[i] = sidechain[i]->load() >= 0.5f;
+    }
+    
+    return settings;
+}
+
+ChainSettings ChainParameters::load() const noexcept
+{
+    ChainSettings settings;
+    
+    settings.low_cut_freq = low_cut_freq->load();
+    settings.high_cut_freq = high_cut_freq->load();
+    settings.low_cut_slope = static_cast<Slope>(low_cut_slope->load());
+    settings.high_cut_slope = static_cast<Slope>(high_cut_slope->load());
+    settings.low_cut_topology = (int) low_cut_topology->load();
+    settings.high_cut_topology = (int) high_cut_topology->load();
+    settings.design_method = (int) design_method->load();
+    settings.low_cut_placement = (int) low_cut_placement->load();
+    settings.high_cut_placement = (int) high_cut_placement->load();
+    settings.stereo_mode = (int) stereo_mode->load();
+    
+    for (size_t i = 0; i < (size_t) max_bands; ++i)
+    {
+        settings.band_freq[i] = band_freq[i]->load();
+        settings.band_gain_db[i] = band_gain_db[i]->load();
+        settings.band_q[i] = band_q[i]->load();
+        settings.band_type[i] = (int) band_type[i]->load();
+        settings.band_enabled[i] = band_enabled[i]->load() >= 0.5f;
+        settings.band_topology[i] = (int) band_topology[i]->load();
+        settings.band_placement[i] = (int) band_placement[i]->load();
+    }
+    
+    return settings;
+}
+
+// Moves the parameters a program sets to settings, notifying the host, see applyProgramSettings
+void setProgramParameters(juce::AudioProcessorValueTreeState& apvts, const ChainSettings& settings)
+{
+    // Only the parameters that move notify the host, a program usually
+    // leaves most of the ~125 alone
+    auto set = [&apvts](const juce::String& parameter_id, float value)
+    {
+        auto* parameter = apvts.getParameter(parameter_id);
+        const auto normalised = parameter->convertTo0to1(value);
+        
+        if (normalised != parameter->getValue())
+            parameter->setValueNotifyingHost(normalised);
+    };
+    
+    set("LowCut Freq", settings.low_cut_freq);
+    set("HiCut Freq", settings.high_cut_freq);
+    set("LowCut Slope", (float) settings.low_cut_slope);
+    set("HiCut Slope", (float) settings.high_cut_slope);
+    
+    for (int band = 0; band < max_bands; ++band)
+    {
+        const auto i = (size_t) band;
+        set(getBandParameterID(band, "Freq"), settings.band_freq[i]);
+        set(getBandParameterID(band, "Gain"), settings.band_gain_db[i]);
+        set(getBandParameterID(band, "Q"), settings.band_q[i]);
+        set(getBandParameterID(band, "Type"), (float) settings.band_type[i]);
+        set(getBandParameterID(band, "Enabled"), settings.band_enabled[i] ? 1.f : 0.f);
+    }
+}
+
+// Map a parameter id onto the band(s) it affects, once per parameter at construction
+int ParametricEQAudioProcessor::getBandsForParameter(const juce::String& parameter_id)
+{
+    if (parameter_id.startsWith("LowCut")) return getBandBit(LowCut);
+    if (parameter_id.startsWith("HiCut"))  return getBandBit(HiCut);
+    
+    // Read by the audio thread every block, nothing to design
+    if (isDynamicsParameterID(parameter_id))
+        return 0;
+    
+    const auto band = getBandForParameterID(parameter_id);
+    
+    return band >= 0 ? getBandBit(getBandPosition(band)) : all_bands;
+}
+
+// Called on whichever thread changed the parameter, so only flag the band here
+void ParametricEQAudioProcessor::parameterChanged(int changed_bands, bool is_phase_mode, bool changes_presets) noexcept
+{
+    dirty_bands.fetch_or(changed_bands);
+    
+    // The preset bank is designed for the user's topologies and design
+    // method, it catches up on the message thread
+    if (changes_presets)
+        presets_stale = true;
+    
+    // This can be the audio thread, and hosts may react to a latency change
+    // synchronously, so it is reported from the message thread
+    if (is_phase_mode || changes_presets)
+        triggerAsyncUpdate();
+}
+
+// Redesign the dirty bands and hand the finished set to the audio thread
+void ParametricEQAudioProcessor::designPendingBands()
+{
+    if (dirty_bands.load() == 0 && requested_program.load() < 0)
+        return;
+    
+    // A program change is moving the parameters, it's loaded as a whole once they're done
+    if (setting_program.load())
+        return;
+    
+    // Only reachable from the audio thread in offline renders
+    PARAMETRIC_EQ_NOTE_LOCK();
+    const juce::ScopedLock sl(design_lock);
+    
+    const auto sample_rate = design_sample_rate.load();
+    
+    // Not prepared yet, keep the flags until we know the sample rate
+    if (sample_rate <= 0.0)
+        return;
+    
+    const auto program = requested_program.exchange(-1);
+    
+    if (program >= 0)
+    {
+        loadProgram(program, sample_rate);
+        return;
+    }
+    
+    const auto dirty = dirty_bands.exchange(0);
+    
+    if (dirty == 0)
+        return;
+    
+    designChainCoefficients(chain_parameters.load(), sample_rate, designed_coefficients, dirty, coefficient_cache);
+    instrumentation.countDesignedBands(dirty);
+    
+    coefficient_handoff.getWriteBuffer() = designed_coefficients;
+    coefficient_handoff.publish();
+    ++design_generation;
+    
+    if (isLinearPhase())
+        designKernel();
+}
+
+// Caller holds design_lock
+void ParametricEQAudioProcessor::designKernel() noexcept
+{
+    auto& kernels = kernel_handoff.getWriteBuffer();
+    
+    // Not prepared yet
+    if (kernels.spectra.empty())
+        return;
+    
+    // One kernel per side of a split stereo pair, the same one twice otherwise
+    const auto& sides = designed_coefficients.side_bands;
+    const auto first_bands = linear_phase_stereo ? sides[0] : all_bands;
+    const auto second_bands = linear_phase_stereo ? sides[1] : all_bands;
+    const auto kernel_floats = (size_t) linear_phase_layout.getKernelFloats();
+    
+    kernel_designer.design(designed_coefficients, kernels.spectra.data(), first_bands);
+    
+    if (second_bands == first_bands)
+        std::copy(kernels.spectra.begin(), kernels.spectra.begin() + (std::ptrdiff_t) kernel_floats, kernels.spectra.begin() + (std::ptrdiff_t) kernel_floats);
+    else
+        kernel_designer.design(designed_coefficients, kernels.spectra.data() + kernel_floats, second_bands);
+    
+    kernels.mid_side = linear_phase_stereo && designed_coefficients.mid_side;
+    kernel_handoff.publish();
+}
+
+void ParametricEQAudioProcessor::getDesignedCoefficients(ChainCoefficients& destination) const
+{
+    const juce::ScopedLock sl(design_lock);
+    destination = designed_coefficients;
+}
+
+// Audio thread, wait-free
+void ParametricEQAudioProcessor::applyPendingCoefficients() noexcept
+{
+    if (! coefficient_handoff.update())
+        return;
+    
+    loadCoefficients(coefficient_handoff.getReadBuffer());
+}
+
+
+
+juce::AudioProcessorValueTreeState::ParameterLayout ParametricEQAudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    
+    // Low Cut
+    layout.add(std::make_unique<juce::AudioParameterFloat>("LowCut Freq",
+                                                           "LowCut Freq",
+                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.2f), 20.f));
+    
+    // High Cut
+    layout.add(std::make_unique<juce::AudioParameterFloat>("HiCut Freq",
+                                                           "HiCut Freq",
+                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.2f), 20000.f));
+    
+    // Parametric bands, only the first few are on by default
+    const ChainSettings defaults;
+    const DynamicsSettings dynamics_defaults;
+    const juce::StringArray band_types { "Peak", "Low Shelf", "High Shelf", "Notch", "Tilt" };
+    
+    // State variable filters ramp their coefficients per sample, for fast automation
+    const juce::StringArray topologies { "Biquad", "SVF" };
+    
+    // Which channel a band runs on outside linked mode, see StereoPlacement
+    const juce::StringArray placements { "Both", "Left / Mid", "Right / Side" };
+    
+    for (int band = 0; band < max_bands; ++band)
+    {
+        const auto i = (size_t) band;
+        const auto name = "Band " + juce::String(band + 1) + " ";
+        
+        layout.add(std::make_unique<juce::AudioParameterFloat>(getBandParameterID(band, "Freq"),
+                                                               name + "Freq",
+                                                               juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.2f), defaults.band_freq[i]));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(getBandParameterID(band, "Gain"),
+                                                               name + "Gain",
+                                                               juce::NormalisableRange<float>(-24.f, 24, 0.5f, 1.f), 0.0f));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(getBandParameterID(band, "Q"),
+                                                               name + "Q",
+                                                               juce::NormalisableRange<float>(0.1f, 10, 0.05f, 1.f), 1.f));
+        layout.add(std::make_unique<juce::AudioParameterChoice>(getBandParameterID(band, "Type"), name + "Type", band_types, Band_Peak));
+        layout.add(std::make_unique<juce::AudioParameterBool>(getBandParameterID(band, "Enabled"), name + "Enabled", defaults.band_enabled[i]));
+        layout.add(std::make_unique<juce::AudioParameterChoice>(getBandParameterID(band, "Topology"), name + "Topology", topologies, Topology_Biquad));
+        layout.add(std::make_unique<juce::AudioParameterChoice>(getBandParameterID(band, "Placement"), name + "Placement", placements, Placement_Both));
+        
+        // Dynamics, the band's gain is pulled down while its level is over the threshold
+        layout.add(std::make_unique<juce::AudioParameterBool>(getBandParameterID(band, "Dynamic"), name + "Dynamic", dynamics_defaults.dynamic[i]));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(getBandParameterID(band, "Threshold"),
+                                                               name + "Threshold",
+                                                               juce::NormalisableRange<float>(-60.f, 0.f, 0.5f, 1.f), dynamics_defaults.threshold_db[i]));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(getBandParameterID(band, "Ratio"),
+                                                               name + "Ratio",
+                                                               juce::NormalisableRange<float>(1.f, 20.f, 0.1f, 0.5f), dynamics_defaults.ratio[i]));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(getBandParameterID(band, "Attack"),
+                                                               name + "Attack",
+                                                               juce::NormalisableRange<float>(0.1f, 200.f, 0.1f, 0.4f), dynamics_defaults.attack_ms[i]));
+        layout.add(std::make_unique<juce::AudioParameterFloat>(getBandParameterID(band, "Release"),
+                                                               name + "Release",
+                                                               juce::NormalisableRange<float>(5.f, 2000.f, 1.f, 0.4f), dynamics_defaults.release_ms[i]));
+        layout.add(std::make_unique<juce::AudioParameterBool>(getBandParameterID(band, "Sidechain"), name + "Sidechain", dynamics_defaults.sidechain[i]));
+    }
+    
+    // Cut Slope String Array
+    juce::StringArray string_array;
+    for (int i = 0; i < 4; i++)
+    {
+        juce::String string;
+        string << (12 + i * 12);
+        string << " db/Oct";
+        string_array.add(string);
+    }
+    
+    // Cut Slope Choices
+    layout.add(std::make_unique<juce::AudioParameterChoice>("LowCut Slope", "LowCut Slope", string_array, 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("HiCut Slope", "HiCut Slope", string_array, 0));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("LowCut Topology", "LowCut Topology", topologies, Topology_Biquad));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("HiCut Topology", "HiCut Topology", topologies, Topology_Biquad));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("LowCut Placement", "LowCut Placement", placements, Placement_Both));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("HiCut Placement", "HiCut Placement", placements, Placement_Both));
+    
+    // Matched peaks and cuts keep their analog shape up to Nyquist, see DesignMethod
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Filter Design", "Filter Design", juce::StringArray { "Bilinear", "Matched" }, Design_Bilinear));
+    
+    // Linear phase adds latency, see setLinearPhasePartitionSize
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Phase Mode", "Phase Mode", juce::StringArray { "Minimum", "Linear" }, 0));
+    
+    // Stereo buses only, anything else always runs linked
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Stereo Mode", "Stereo Mode", juce::StringArray { "Linked", "Left / Right", "Mid / Side" }, Stereo_Linked));
+    
+    
+    return layout;
+}
+
+//==============================================================================
+// This creates new instances of the plugin..
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new ParametricEQAudioProcessor();
+}
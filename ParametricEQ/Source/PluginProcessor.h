@@ -1,163 +1,305 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin processor.
-
-  ==============================================================================
-*/
-
-#pragma once
-
-#include <JuceHeader.h>
-
-// To help with slope int expressions
-enum Slope
-{
-    Slope_12,
-    Slope_24,
-    Slope_36,
-    Slope_48
-};
-
-// Get plugin parameters
-struct ChainSettings
-{
-    float peak1_freq { 0 }, peak1_gain_db { 0 }, peak1_q { 1.f};
-    float peak2_freq { 0 }, peak2_gain_db { 0 }, peak2_q { 1.f};
-    float peak3_freq { 0 }, peak3_gain_db { 0 }, peak3_q { 1.f};
-    float low_cut_freq { 0 }, high_cut_freq { 0 };
-    int low_cut_slope { Slope::Slope_12 }, high_cut_slope { Slope::Slope_12 };
-};
-
-
-
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
-
-//==============================================================================
-/**
-*/
-class ParametricEQAudioProcessor  : public juce::AudioProcessor
-                            #if JucePlugin_Enable_ARA
-                             , public juce::AudioProcessorARAExtension
-                            #endif
-{
-public:
-    //==============================================================================
-    ParametricEQAudioProcessor();
-    ~ParametricEQAudioProcessor() override;
-
-    //==============================================================================
-    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
-    void releaseResources() override;
-
-   #ifndef JucePlugin_PreferredChannelConfigurations
-    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
-   #endif
-
-    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
-
-    //==============================================================================
-    juce::AudioProcessorEditor* createEditor() override;
-    bool hasEditor() const override;
-
-    //==============================================================================
-    const juce::String getName() const override;
-
-    bool acceptsMidi() const override;
-    bool producesMidi() const override;
-    bool isMidiEffect() const override;
-    double getTailLengthSeconds() const override;
-
-    //==============================================================================
-    int getNumPrograms() override;
-    int getCurrentProgram() override;
-    void setCurrentProgram (int index) override;
-    const juce::String getProgramName (int index) override;
-    void changeProgramName (int index, const juce::String& newName) override;
-
-    //==============================================================================
-    void getStateInformation (juce::MemoryBlock& destData) override;
-    void setStateInformation (const void* data, int sizeInBytes) override;
-    
-    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
-    
-    juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
-
-private:
-    
-    using Filter = juce::dsp::IIR::Filter<float>;
-    
-    using CutFilter = juce::dsp::ProcessorChain<Filter, Filter, Filter, Filter>;
-    
-    using MonoChain = juce::dsp::ProcessorChain<CutFilter, Filter, Filter, Filter, CutFilter>;
-    
-    MonoChain left_chain, right_chain;
-    
-    // Order of audio chain
-    enum ChainPositions
-    {
-        LowCut,
-        Peak1,
-        Peak2,
-        Peak3,
-        HiCut
-    };
-    
-    
-    void updatePeakFilter(const ChainSettings& chain_settings);
-    
-    using Coefficients = Filter::CoefficientsPtr;
-    static void updateCoefficients(Coefficients& old, const Coefficients& replace);
-    
-    // Update cut filter coefficients and setbypassed
-    template<int Index, typename ChainType, typename CoefficientType>
-    void update(ChainType& chain, const CoefficientType& coefficients)
-    {
-        updateCoefficients(chain.template get<Index>().coefficients, coefficients[Index]);
-        chain.template setBypassed<Index>(false);
-    }
-    
-    
-    // Update low cut filter based on slope
-    template<typename ChainType, typename CoefficientType>
-    void updateCutFilter(ChainType& chain, const CoefficientType& coefficients, const int& slope)
-    {
-
-        // Setup low cut channel
-        chain.template setBypassed<0>(true);
-        chain.template setBypassed<1>(true);
-        chain.template setBypassed<2>(true);
-        chain.template setBypassed<3>(true);
-        
-        switch (slope)
-        {
-            case Slope_48:
-            {
-                update<3>(chain, coefficients);
-            }
-                
-            case Slope_36:
-            {
-                update<2>(chain, coefficients);
-            }
-            
-            case Slope_24:
-            {
-                update<1>(chain, coefficients);
-            }
-                
-            case Slope_12:
-            {
-                update<0>(chain, coefficients);
-            }
-        }
-    }
-    
-    void updateLowCutFilters(const ChainSettings& chain_settings);
-    void updateHighCutFilters(const ChainSettings& chain_settings);
-    void updateFilters();
-    
-    
-    //==============================================================================
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParametricEQAudioProcessor)
-};
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin processor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BandDynamics.h"
+#include "ChainSmoother.h"
+#include "CoefficientDesigner.h"
+#include "FilterChain.h"
+#include "Instrumentation.h"
+#include "LinearPhaseConvolver.h"
+#include "PresetBank.h"
+#include "SpectrumAnalyzer.h"
+#include "TripleBuffer.h"
+
+// Looks every parameter up by ID, which builds strings. The processor
+// reads its settings through ChainParameters instead.
+ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts);
+void setProgramParameters(juce::AudioProcessorValueTreeState& apvts, const ChainSettings& settings);
+
+// The chain's raw parameter values, looked up once so reading the settings
+// is a few atomic loads and safe on the audio thread. One array per band
+// parameter, like ChainSettings.
+struct ChainParameters
+{
+    explicit ChainParameters(juce::AudioProcessorValueTreeState& apvts);
+    
+    ChainSettings load() const noexcept;
+    
+    std::atomic<float>* low_cut_freq, * high_cut_freq, * low_cut_slope, * high_cut_slope;
+    std::atomic<float>* low_cut_topology, * high_cut_topology, * design_method;
+    std::atomic<float>* low_cut_placement, * high_cut_placement, * stereo_mode;
+    std::array<std::atomic<float>*, max_bands> band_freq, band_gain_db, band_q, band_type, band_enabled, band_topology, band_placement;
+};
+
+// Same for the dynamics of each band
+struct DynamicsParameters
+{
+    explicit DynamicsParameters(juce::AudioProcessorValueTreeState& apvts);
+    
+    DynamicsSettings load() const noexcept;
+    
+    std::array<std::atomic<float>*, max_bands> threshold_db, ratio, attack_ms, release_ms, dynamic, sidechain;
+};
+
+//==============================================================================
+/**
+*/
+class ParametricEQAudioProcessor  : public juce::AudioProcessor,
+                                    private CoefficientDesignClient,
+                                    private juce::AsyncUpdater
+                            #if JucePlugin_Enable_ARA
+                             , public juce::AudioProcessorARAExtension
+                            #endif
+{
+public:
+    //==============================================================================
+    ParametricEQAudioProcessor();
+    ~ParametricEQAudioProcessor() override;
+
+    //==============================================================================
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
+    void releaseResources() override;
+
+   #ifndef JucePlugin_PreferredChannelConfigurations
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
+   #endif
+
+    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock (juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
+
+    //==============================================================================
+    juce::AudioProcessorEditor* createEditor() override;
+    bool hasEditor() const override;
+
+    //==============================================================================
+    const juce::String getName() const override;
+
+    bool acceptsMidi() const override;
+    bool producesMidi() const override;
+    bool isMidiEffect() const override;
+    double getTailLengthSeconds() const override;
+
+    //==============================================================================
+    int getNumPrograms() override;
+    int getCurrentProgram() override;
+    void setCurrentProgram (int index) override;
+    const juce::String getProgramName (int index) override;
+    void changeProgramName (int index, const juce::String& newName) override;
+
+    //==============================================================================
+    void getStateInformation (juce::MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
+    
+    static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    
+    // Widest bus we accept, third order ambisonics
+    static constexpr int max_channels = 16;
+    
+    // Buses with at least this many channels spread channel groups over worker
+    // threads, takes effect on the next prepareToPlay
+    void setParallelChannelThreshold(int num_channels) noexcept { parallel_channel_threshold = num_channels; }
+    int getParallelChannelThreshold() const noexcept            { return parallel_channel_threshold; }
+    
+    // Control rate smoothing: parameters ramp and the moving bands are
+    // redesigned once every sub_block_size samples, on the audio thread and
+    // without the coefficient cache. 0 (the default) leaves design to the
+    // design thread and coefficients change once per host block instead,
+    // unless a band is dynamic, which keeps the control rate at
+    // dynamics_sub_block_size.
+    void setSmoothingSubBlockSize(int sub_block_size) noexcept { smoothing_sub_block_size = juce::jmax(0, sub_block_size); }
+    int getSmoothingSubBlockSize() const noexcept              { return smoothing_sub_block_size; }
+    
+    static constexpr int dynamics_sub_block_size = 32;
+    
+    // Linear phase partition size in samples, a power of two from 64 to 4096.
+    // Smaller partitions mean less latency and more CPU. Takes effect on the
+    // next prepareToPlay.
+    void setLinearPhasePartitionSize(int num_samples) noexcept { linear_phase_partition_size = num_samples; }
+    int getLinearPhasePartitionSize() const noexcept           { return linear_phase_partition_size; }
+    
+    bool isLinearPhase() const noexcept;
+    
+    // Float processing with the sections closest to DC (low cuts and low
+    // peaks) running in double, see FilterChain. Has no effect when the host
+    // processes in double. Takes effect on the next prepareToPlay.
+    void setMixedPrecision(bool should_use_mixed_precision) noexcept { mixed_precision = should_use_mixed_precision; }
+    bool isMixedPrecision() const noexcept                           { return mixed_precision; }
+    
+    // Pre / post EQ spectrum, fed from processBlock while an editor is open
+    SpectrumAnalyzer& getAnalyzer() noexcept { return analyzer; }
+    
+    // Counters of the process wide coefficient cache, for tuning its capacity
+    CoefficientCache::Stats getCoefficientCacheStats() const noexcept { return coefficient_cache->getStats(); }
+    
+    // Block and per band timings, redesign counts and realtime violations.
+    // Only records in builds with PARAMETRIC_EQ_INSTRUMENTATION=1, query
+    // with getInstrumentation().getSnapshot().
+    ProcessorInstrumentation& getInstrumentation() noexcept { return instrumentation; }
+    
+    juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
+    
+    // Current parameter values, without any string lookups
+    ChainSettings getCurrentChainSettings() const noexcept { return chain_parameters.load(); }
+    
+    // Moves on whenever the design stage publishes a coefficient set, so
+    // editors can poll it and only fetch the set when it changed
+    juce::uint32 getDesignGeneration() const noexcept { return design_generation.load(); }
+    
+    // The latest published set, message thread
+    void getDesignedCoefficients(ChainCoefficients& destination) const;
+
+private:
+    
+    // The chains for one host sample type, only the one in use gets prepared
+    template <typename SampleType>
+    struct Chains
+    {
+        FilterChain<SampleType> chain, fade_chain;
+        juce::AudioBuffer<SampleType> fade_buffer;
+    };
+    
+    template <typename SampleType> Chains<SampleType>& getChains() noexcept;
+    template <typename SampleType> void prepareChains(Chains<SampleType>& chains, int samples_per_block);
+    
+    Chains<float> float_chains;
+    Chains<double> double_chains;
+    std::atomic<bool> mixed_precision { false };
+    
+    std::atomic<int> parallel_channel_threshold { 12 };
+    std::unique_ptr<ChannelWorkerPool> worker_pool;
+    
+    ChainParameters chain_parameters { apvts };
+    DynamicsParameters dynamics_parameters { apvts };
+    std::atomic<float>* phase_mode { apvts.getRawParameterValue("Phase Mode") };
+    
+    static int getBandsForParameter(const juce::String& parameter_id);
+    
+    // One per parameter, knowing the bands it affects, so a change never
+    // has to look at the ID (it may come in on the audio thread)
+    struct ParameterListener : juce::AudioProcessorValueTreeState::Listener
+    {
+        ParameterListener(ParametricEQAudioProcessor& p, const juce::String& id)
+            : processor(p), parameter_id(id), bands(getBandsForParameter(id)), is_phase_mode(id == "Phase Mode"),
+              changes_presets(id == "Filter Design" || id.endsWith("Topology")) {}
+        
+        void parameterChanged(const juce::String&, float) override { processor.parameterChanged(bands, is_phase_mode, changes_presets); }
+        
+        ParametricEQAudioProcessor& processor;
+        const juce::String parameter_id;
+        const int bands;
+        const bool is_phase_mode, changes_presets;
+    };
+    
+    std::vector<std::unique_ptr<ParameterListener>> parameter_listeners;
+    
+    // Design stage, runs on the design thread (or the message thread in prepareToPlay)
+    void parameterChanged(int changed_bands, bool is_phase_mode, bool changes_presets) noexcept;
+    void designPendingBands() override;
+    
+    std::atomic<int> dirty_bands { all_bands };
+    std::atomic<double> design_sample_rate { 0.0 };
+    juce::CriticalSection design_lock;
+    ChainCoefficients designed_coefficients;
+    std::atomic<juce::uint32> design_generation { 0 };
+    TripleBuffer<ChainCoefficients> coefficient_handoff;
+    juce::SharedResourcePointer<CoefficientDesignThread> design_thread;
+    juce::SharedResourcePointer<CoefficientCache> coefficient_cache;
+    
+    // Audio thread side, copies a finished set into the chain without allocating
+    void applyPendingCoefficients() noexcept;
+    
+    // processBlock for either sample type
+    template <typename SampleType>
+    void processSamples(juce::AudioBuffer<SampleType>& buffer) noexcept;
+    
+    // Runs whichever processing mode is active
+    template <typename SampleType>
+    void processFilters(juce::AudioBuffer<SampleType>& buffer, int num_channels) noexcept;
+    
+    // Neutral bands are left out of the chain, changes to which bands run
+    // crossfade, as does any set loaded with crossfade (program changes)
+    void loadCoefficients(const ChainCoefficients& coefficients, bool crossfade = false) noexcept;
+    
+    template <typename SampleType>
+    void loadCoefficients(Chains<SampleType>& chains, const ChainCoefficients& coefficients, bool crossfade) noexcept;
+    
+    template <typename SampleType>
+    void processChain(juce::AudioBuffer<SampleType>& buffer, int num_channels, int start_sample, int num_samples) noexcept;
+    
+    int fade_length { 1 }, fade_remaining { 0 };
+    std::atomic<double> chain_tail_seconds { 0.0 };
+    
+    // Silent input stops processing once the tail has rung out
+    template <typename SampleType>
+    bool skipSilence(juce::AudioBuffer<SampleType>& buffer, int num_channels) noexcept;
+    
+    static constexpr float silence_threshold = 1.0e-7f;   // -140 dBFS
+    juce::int64 silent_samples { 0 };
+    bool idle { false };
+    
+    // Smoothing mode, audio thread only. Dynamic bands run here too, their
+    // detectors see each sub-block before it's filtered.
+    template <typename SampleType>
+    void processSmoothed(juce::AudioBuffer<SampleType>& buffer, int num_channels, int sub_block_size,
+                         const DynamicsSettings& dynamics_settings) noexcept;
+    
+    std::atomic<int> smoothing_sub_block_size { 0 };
+    bool was_smoothing { false };
+    ChainSmoother smoother;
+    ChainCoefficients smoothed_coefficients;
+    BandDynamics dynamics;
+    
+    // Linear phase mode, the kernel is designed next to the coefficients
+    void designKernel() noexcept;
+    void updateLatency();
+    void handleAsyncUpdate() override;   // Latency and preset designs, from the message thread
+    template <typename SampleType>
+    void processLinearPhase(juce::AudioBuffer<SampleType>& buffer, int num_channels) noexcept;
+    
+    std::atomic<int> linear_phase_partition_size { 512 };
+    LinearPhaseLayout linear_phase_layout;
+    LinearPhaseKernelDesigner kernel_designer;
+    TripleBuffer<LinearPhaseKernels> kernel_handoff;
+    UniformPartitionedConvolver convolver;
+    juce::AudioBuffer<float> convolver_buffer;   // double processing, the FFT only runs in float
+    bool linear_phase_stereo { false };          // Written under design_lock
+    bool was_linear_phase { false };
+    
+    SpectrumAnalyzer analyzer;
+    
+    ProcessorInstrumentation instrumentation;
+    static_assert(ProcessorInstrumentation::num_stages == HiCut + 1, "one timed stage per band");
+    
+    // Programs, a switch loads the preset's prebuilt coefficients with a
+    // crossfade. setCurrentProgram only moves the parameters and requests
+    // the program, the design stage publishes its set and the audio thread
+    // fades to it.
+    void loadProgram(int program, double sample_rate);   // Design stage, caller holds design_lock
+    void preparePresets();                               // Message thread, after a topology or design method change
+    void switchToPendingProgram() noexcept;
+    
+    PresetBank preset_bank;   // Written under design_lock
+    std::atomic<int> current_program { 0 }, requested_program { -1 }, pending_program { -1 };
+    std::atomic<bool> setting_program { false }, presets_stale { false };
+    
+    // Binary state: magic, version, program, then (ID hash, value) per parameter
+    std::vector<juce::RangedAudioParameter*> state_parameters;
+    std::unordered_map<int, size_t> state_parameter_indices;   // By ID hash, built once
+    
+    static constexpr juce::uint32 state_magic = 0x53514550;   // "PEQS"
+    static constexpr int state_version = 1;
+    static constexpr int state_header_size = 10;
+    
+    
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ParametricEQAudioProcessor)
+};
@@ -0,0 +1,126 @@
+/*
+  ==============================================================================
+
+    PresetBank.cpp
+
+  ==============================================================================
+*/
+
+#include "PresetBank.h"
+
+// Plugin defaults, see ParametricEQAudioProcessor::createParameterLayout
+static ChainSettings makeFlatSettings()
+{
+    return ChainSettings();
+}
+
+// Enables band and sets it up
+static void setBand(ChainSettings& settings, int band, int type, float freq, float gain_db, float q)
+{
+    const auto i = (size_t) band;
+    settings.band_enabled[i] = true;
+    settings.band_type[i] = type;
+    settings.band_freq[i] = freq;
+    settings.band_gain_db[i] = gain_db;
+    settings.band_q[i] = q;
+}
+
+PresetBank::PresetBank()
+{
+    // Values sit on the parameter grid so they match what the host sees
+    auto settings = makeFlatSettings();
+    add("Flat", settings);
+    
+    settings = makeFlatSettings();
+    settings.low_cut_freq = 40.f;
+    settings.low_cut_slope = Slope_24;
+    add("Rumble Filter", settings);
+    
+    settings = makeFlatSettings();
+    settings.low_cut_freq = 100.f;
+    settings.low_cut_slope = Slope_24;
+    setBand(settings, 0, Band_Peak, 250.f, -2.f, 1.f);
+    setBand(settings, 1, Band_Peak, 3000.f, 3.f, 0.8f);
+    setBand(settings, 2, Band_Peak, 10000.f, 2.f, 0.7f);
+    add("Vocal Presence", settings);
+    
+    settings = makeFlatSettings();
+    settings.low_cut_freq = 30.f;
+    setBand(settings, 0, Band_Peak, 60.f, 4.f, 1.2f);
+    setBand(settings, 1, Band_Peak, 350.f, -4.f, 1.5f);
+    setBand(settings, 2, Band_Peak, 4000.f, 3.f, 2.f);
+    add("Kick Punch", settings);
+    
+    settings = makeFlatSettings();
+    settings.low_cut_freq = 30.f;
+    setBand(settings, 0, Band_Peak, 300.f, -4.f, 1.4f);
+    add("De-Mud", settings);
+    
+    settings = makeFlatSettings();
+    setBand(settings, 2, Band_Peak, 12000.f, 4.f, 0.5f);
+    add("Air", settings);
+    
+    settings = makeFlatSettings();
+    settings.low_cut_freq = 400.f;
+    settings.low_cut_slope = Slope_48;
+    settings.high_cut_freq = 3400.f;
+    settings.high_cut_slope = Slope_48;
+    setBand(settings, 1, Band_Peak, 1500.f, 4.f, 1.f);
+    add("Telephone", settings);
+    
+    settings = makeFlatSettings();
+    setBand(settings, 3, Band_LowShelf, 100.f, 3.f, 0.7f);
+    setBand(settings, 4, Band_HighShelf, 8000.f, 3.f, 0.7f);
+    add("Smile", settings);
+    
+    settings = makeFlatSettings();
+    setBand(settings, 3, Band_Tilt, 1000.f, 3.f, 0.7f);
+    add("Bright Tilt", settings);
+    
+    settings = makeFlatSettings();
+    setBand(settings, 3, Band_Notch, 50.f, 0.f, 8.f);
+    setBand(settings, 4, Band_Notch, 100.f, 0.f, 8.f);
+    setBand(settings, 5, Band_Notch, 150.f, 0.f, 8.f);
+    setBand(settings, 6, Band_Notch, 200.f, 0.f, 8.f);
+    add("Hum Removal", settings);
+}
+
+void PresetBank::add(const juce::String& name, const ChainSettings& settings)
+{
+    presets.push_back({ name, settings, {} });
+}
+
+void PresetBank::prepare(double sample_rate, const ChainSettings& settings, CoefficientCache* cache)
+{
+    for (auto& preset : presets)
+    {
+        auto program_settings = settings;
+        applyProgramSettings(preset.settings, program_settings);
+        designChainCoefficients(program_settings, sample_rate, preset.coefficients, all_bands, cache);
+    }
+    
+    prepared_sample_rate = sample_rate;
+    prepared_settings = settings;
+}
+
+bool PresetBank::isPreparedFor(double sample_rate, const ChainSettings& settings) const noexcept
+{
+    return sample_rate > 0.0 && sample_rate == prepared_sample_rate
+        && settings.design_method == prepared_settings.design_method
+        && settings.low_cut_topology == prepared_settings.low_cut_topology
+        && settings.high_cut_topology == prepared_settings.high_cut_topology
+        && settings.band_topology == prepared_settings.band_topology;
+}
+
+void applyProgramSettings(const ChainSettings& program, ChainSettings& settings) noexcept
+{
+    settings.low_cut_freq = program.low_cut_freq;
+    settings.high_cut_freq = program.high_cut_freq;
+    settings.low_cut_slope = program.low_cut_slope;
+    settings.high_cut_slope = program.high_cut_slope;
+    settings.band_freq = program.band_freq;
+    settings.band_gain_db = program.band_gain_db;
+    settings.band_q = program.band_q;
+    settings.band_type = program.band_type;
+    settings.band_enabled = program.band_enabled;
+}
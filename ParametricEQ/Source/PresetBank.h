@@ -0,0 +1,59 @@
+/*
+  ==============================================================================
+
+    PresetBank.h
+
+    The plugin's programs. Every preset's coefficients are designed when the
+    bank is prepared for a sample rate and the user's design method and
+    topologies, so switching programs never designs anything, it only hands
+    a ready made set to the chain. A program only sets the bands and cuts;
+    topologies, placements, the design method and stereo mode are the user's
+    and carry over.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterChain.h"
+
+class PresetBank
+{
+public:
+    // Factory presets
+    PresetBank();
+    
+    // Designs every preset for sample_rate with the design method and
+    // topologies of settings, message thread
+    void prepare(double sample_rate, const ChainSettings& settings, CoefficientCache* cache = nullptr);
+    
+    // Whether the prebuilt sets are what settings would design, the sides
+    // aside (see setStereoLayout)
+    bool isPreparedFor(double sample_rate, const ChainSettings& settings) const noexcept;
+    
+    int size() const noexcept { return (int) presets.size(); }
+    
+    const juce::String& getName(int index) const noexcept       { return presets[(size_t) index].name; }
+    void setName(int index, const juce::String& new_name)       { presets[(size_t) index].name = new_name; }
+    
+    const ChainSettings& getSettings(int index) const noexcept         { return presets[(size_t) index].settings; }
+    const ChainCoefficients& getCoefficients(int index) const noexcept { return presets[(size_t) index].coefficients; }
+    
+private:
+    struct Preset
+    {
+        juce::String name;
+        ChainSettings settings;
+        ChainCoefficients coefficients;
+    };
+    
+    void add(const juce::String& name, const ChainSettings& settings);
+    
+    std::vector<Preset> presets;
+    double prepared_sample_rate { 0 };
+    ChainSettings prepared_settings;   // Only the design method and topologies
+};
+
+// Moves settings to a program, keeping everything a program doesn't set
+void applyProgramSettings(const ChainSettings& program, ChainSettings& settings) noexcept;
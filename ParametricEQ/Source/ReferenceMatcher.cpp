@@ -0,0 +1,424 @@
+/*
+  ==============================================================================
+
+    ReferenceMatcher.cpp
+
+  ==============================================================================
+*/
+
+#include "ReferenceMatcher.h"
+
+LongTermSpectrum::LongTermSpectrum(double new_sample_rate)
+    : sample_rate(new_sample_rate),
+      fft(std::make_unique<juce::dsp::FFT>(fft_order))
+{
+    fft_buffer.assign((size_t) (2 * fft_size), 0.f);
+    power.assign((size_t) num_bins, 0.0);
+    
+    // Hann, scaled so a full scale sine reads 0 dB like the analyzer
+    window.resize((size_t) fft_size);
+    auto sum = 0.f;
+    
+    for (int i = 0; i < fft_size; ++i)
+    {
+        window[(size_t) i] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * (float) i / (float) fft_size);
+        sum += window[(size_t) i];
+    }
+    
+    window_gain = 2.f / sum;
+}
+
+void LongTermSpectrum::addSamples(const float* const* channels, int num_channels, int num_samples)
+{
+    // The channel count is set by the first call
+    if (history.empty())
+        history.assign((size_t) juce::jmax(1, num_channels), std::vector<float>((size_t) fft_size, 0.f));
+    
+    jassert(num_channels == (int) history.size());
+    num_channels = juce::jmin(num_channels, (int) history.size());
+    
+    for (int position = 0; position < num_samples;)
+    {
+        const auto wanted = juce::jmin(num_samples - position, fft_size - filled);
+        
+        for (int ch = 0; ch < num_channels; ++ch)
+            std::copy(channels[ch] + position, channels[ch] + position + wanted, history[(size_t) ch].begin() + filled);
+        
+        filled += wanted;
+        position += wanted;
+        
+        if (filled < fft_size)
+            break;
+        
+        for (auto& samples : history)
+        {
+            runFFT(samples.data());
+            std::copy(samples.begin() + hop_size, samples.end(), samples.begin());
+        }
+        
+        filled = fft_size - hop_size;
+    }
+}
+
+void LongTermSpectrum::runFFT(const float* samples)
+{
+    for (int i = 0; i < fft_size; ++i)
+        fft_buffer[(size_t) i] = samples[i] * window[(size_t) i];
+    
+    std::fill(fft_buffer.begin() + fft_size, fft_buffer.end(), 0.f);
+    fft->performFrequencyOnlyForwardTransform(fft_buffer.data(), true);
+    
+    for (int k = 0; k < num_bins; ++k)
+    {
+        const auto magnitude = (double) (fft_buffer[(size_t) k] * window_gain);
+        power[(size_t) k] += magnitude * magnitude;
+    }
+    
+    ++num_frames;
+}
+
+void LongTermSpectrum::merge(const LongTermSpectrum& other)
+{
+    jassert(other.sample_rate == sample_rate);
+    
+    for (int k = 0; k < num_bins; ++k)
+        power[(size_t) k] += other.power[(size_t) k];
+    
+    num_frames += other.num_frames;
+}
+
+double LongTermSpectrum::getLevelDb(double freq, double octave_width) const noexcept
+{
+    const auto bin_width = sample_rate / fft_size;
+    const auto edge = std::exp2(0.5 * octave_width);
+    
+    auto first = juce::jmax(1, (int) std::ceil(freq / edge / bin_width));
+    auto last = juce::jmin(num_bins - 1, (int) std::floor(freq * edge / bin_width));
+    
+    // Narrower than a bin at the bottom, take the nearest one
+    if (first > last)
+        first = last = juce::jlimit(1, num_bins - 1, juce::roundToInt(freq / bin_width));
+    
+    auto sum = 0.0;
+    
+    for (int k = first; k <= last; ++k)
+        sum += power[(size_t) k];
+    
+    const auto mean = sum / ((double) (last - first + 1) * (double) juce::jmax((juce::int64) 1, num_frames));
+    return 10.0 * std::log10(mean + 1.0e-30);
+}
+
+//==============================================================================
+// Starting step sizes, scaled down as the search closes in
+static constexpr double freq_step_octaves = 0.5;
+static constexpr double gain_step_db = 2.0;
+static constexpr double q_step_octaves = 0.5;
+static constexpr double min_scale = 1.0 / 64.0;
+
+// Points more than this far below the loudest are left out of the comparison
+static constexpr float level_floor_db = 80.f;
+
+int ReferenceMatcher::getMovedBand(const Move& move) noexcept
+{
+    switch (move.parameter)
+    {
+        case LowCutFreq:
+        case LowCutSlope:   return LowCut;
+        case HighCutFreq:
+        case HighCutSlope:  return HiCut;
+        case PeakFreq:
+        case PeakGain:
+        case PeakQ:         return getBandPosition(move.band);
+    }
+    
+    return LowCut;
+}
+
+// False if the move changes nothing, e.g. a parameter already at its limit
+bool ReferenceMatcher::applyMove(ChainSettings& settings, const Move& move) const noexcept
+{
+    auto nudge = [](float& value, double amount, bool logarithmic, double low, double high)
+    {
+        const auto old = value;
+        value = (float) juce::jlimit(low, high, logarithmic ? value * std::exp2(amount) : value + amount);
+        return value != old;
+    };
+    
+    auto shift = [](int& slope, int direction)
+    {
+        const auto old = slope;
+        slope = juce::jlimit((int) Slope_12, (int) Slope_48, slope + direction);
+        return slope != old;
+    };
+    
+    const auto direction = (double) move.direction;
+    const auto i = (size_t) move.band;
+    
+    switch (move.parameter)
+    {
+        case LowCutFreq:
+            return nudge(settings.low_cut_freq, direction * freq_step_octaves * scale, true, neutral_low_cut_freq, top_freq);
+        
+        case HighCutFreq:
+            return nudge(settings.high_cut_freq, direction * freq_step_octaves * scale, true, bottom_freq, neutral_high_cut_freq);
+        
+        // A cut out of the chain sounds the same at any slope
+        case LowCutSlope:
+            return shift(settings.low_cut_slope, move.direction) && ! isBandNeutral(settings, LowCut);
+        
+        case HighCutSlope:
+            return shift(settings.high_cut_slope, move.direction) && ! isBandNeutral(settings, HiCut);
+        
+        case PeakFreq:
+            return nudge(settings.band_freq[i], direction * freq_step_octaves * scale, true, bottom_freq, top_freq);
+        
+        case PeakGain:
+            return nudge(settings.band_gain_db[i], direction * gain_step_db * scale, false, -24.0, 24.0);
+        
+        case PeakQ:
+            return nudge(settings.band_q[i], direction * q_step_octaves * scale, true, 0.1, 10.0);
+    }
+    
+    return false;
+}
+
+// Weighted variance of the error, so the overall level doesn't count
+double ReferenceMatcher::getCost(const ResponseCurve& curve) const noexcept
+{
+    const auto* response_db = curve.getMagnitudesDb();
+    auto sum_weights = 0.0, sum = 0.0, sum_squares = 0.0;
+    
+    for (size_t i = 0; i < target_db.size(); ++i)
+    {
+        const auto error = (double) (response_db[i] - target_db[i]);
+        sum_weights += weights[i];
+        sum += weights[i] * error;
+        sum_squares += weights[i] * error * error;
+    }
+    
+    if (sum_weights <= 0.0)
+        return 0.0;
+    
+    const auto mean = sum / sum_weights;
+    return juce::jmax(0.0, sum_squares / sum_weights - mean * mean);
+}
+
+void ReferenceMatcher::score(Candidate& candidate) noexcept
+{
+    designChainCoefficients(candidate.settings, sample_rate, candidate.coefficients, candidate.stale_bands);
+    candidate.stale_bands = 0;
+    candidate.curve.update(candidate.coefficients);
+    candidate.cost = getCost(candidate.curve);
+}
+
+void ReferenceMatcher::scoreJob(void* context, int index) noexcept
+{
+    auto& matcher = *static_cast<ReferenceMatcher*>(context);
+    auto& candidate = matcher.candidates[(size_t) index];
+    
+    if (candidate.changed)
+        matcher.score(candidate);
+}
+
+// Starts a peak where the error is largest, with the gain that takes it out
+void ReferenceMatcher::placePeak(Candidate& base, int band) noexcept
+{
+    const auto* response_db = base.curve.getMagnitudesDb();
+    const auto num_points = (int) target_db.size();
+    auto sum_weights = 0.0, sum = 0.0;
+    
+    for (int i = 0; i < num_points; ++i)
+    {
+        sum_weights += weights[(size_t) i];
+        sum += weights[(size_t) i] * (target_db[(size_t) i] - response_db[i]);
+    }
+    
+    const auto mean = sum_weights > 0.0 ? sum / sum_weights : 0.0;
+    auto worst = -1;
+    auto worst_error = 0.0;
+    
+    for (int i = 0; i < num_points; ++i)
+    {
+        const auto error = target_db[(size_t) i] - response_db[i] - mean;
+        
+        if (weights[(size_t) i] > 0.f && std::abs(error) > std::abs(worst_error))
+        {
+            worst = i;
+            worst_error = error;
+        }
+    }
+    
+    if (worst < 0)
+        return;
+    
+    base.settings.band_freq[(size_t) band] = (float) base.curve.getFrequency(worst);
+    base.settings.band_gain_db[(size_t) band] = (float) juce::jlimit(-24.0, 24.0, worst_error);
+    base.stale_bands |= getBandBit(getBandPosition(band));
+    score(base);
+}
+
+// Pattern search over the cuts and / or num_bands peaks from first_band, one
+// candidate per parameter and direction
+void ReferenceMatcher::search(Candidate& base, bool cuts, int first_band, int num_bands, ChannelWorkerPool* pool)
+{
+    moves.clear();
+    
+    for (auto direction : { 1, -1 })
+    {
+        if (cuts)
+            for (auto parameter : { LowCutFreq, LowCutSlope, HighCutFreq, HighCutSlope })
+                moves.push_back({ parameter, 0, direction });
+        
+        for (int band = first_band; band < first_band + num_bands; ++band)
+            for (auto parameter : { PeakFreq, PeakGain, PeakQ })
+                moves.push_back({ parameter, band, direction });
+    }
+    
+    candidates.resize(moves.size());
+    
+    for (auto& candidate : candidates)
+    {
+        if (candidate.curve.getNumPoints() != (int) target_db.size())
+            candidate.curve.setFrequencies(options.num_points, (float) bottom_freq, (float) top_freq, sample_rate);
+        
+        candidate.stale_bands = all_bands;
+    }
+    
+    scale = 1.0;
+    
+    while (scale >= min_scale && iterations < options.max_iterations)
+    {
+        ++iterations;
+        
+        // Each candidate always moves the same band, so only that band and
+        // whatever the base changed since it was last scored need designing
+        for (size_t i = 0; i < moves.size(); ++i)
+        {
+            auto& candidate = candidates[i];
+            candidate.settings = base.settings;
+            candidate.changed = applyMove(candidate.settings, moves[i]);
+            candidate.stale_bands |= getBandBit(static_cast<ChainPositions>(getMovedBand(moves[i])));
+        }
+        
+        if (pool != nullptr)
+            pool->run((int) candidates.size(), scoreJob, this);
+        else
+            for (int i = 0; i < (int) candidates.size(); ++i)
+                scoreJob(this, i);
+        
+        auto best = -1;
+        auto best_cost = base.cost - 1.0e-6;
+        
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            if (candidates[i].changed && candidates[i].cost < best_cost)
+            {
+                best = (int) i;
+                best_cost = candidates[i].cost;
+            }
+        }
+        
+        if (best < 0)
+        {
+            scale *= 0.5;
+            continue;
+        }
+        
+        const auto moved_bit = getBandBit(static_cast<ChainPositions>(getMovedBand(moves[(size_t) best])));
+        base.settings = candidates[(size_t) best].settings;
+        base.stale_bands |= moved_bit;
+        score(base);
+        
+        for (auto& candidate : candidates)
+            candidate.stale_bands |= moved_bit;
+    }
+}
+
+ReferenceMatcher::Result ReferenceMatcher::fit(const LongTermSpectrum& source, const LongTermSpectrum& reference,
+                                               const Options& new_options, ChannelWorkerPool* pool)
+{
+    options = new_options;
+    iterations = 0;
+    options.num_peaks = juce::jlimit(0, max_bands, options.num_peaks);
+    sample_rate = source.getSampleRate();
+    top_freq = juce::jmin((double) options.max_freq, 0.45 * juce::jmin(sample_rate, reference.getSampleRate()));
+    bottom_freq = juce::jlimit(1.0, top_freq * 0.5, (double) options.min_freq);
+    
+    // The model starts flat: cuts out of the chain, peaks at 0 dB, every other band off
+    Candidate base;
+    base.settings.band_enabled.fill(false);
+    
+    for (int band = 0; band < options.num_peaks; ++band)
+    {
+        base.settings.band_enabled[(size_t) band] = true;
+        base.settings.band_type[(size_t) band] = Band_Peak;
+        base.settings.band_gain_db[(size_t) band] = 0.f;
+        base.settings.band_q[(size_t) band] = 1.f;
+    }
+    
+    base.curve.setFrequencies(options.num_points, (float) bottom_freq, (float) top_freq, sample_rate);
+    
+    // The difference curve, left out where either file has next to nothing
+    const auto num_points = base.curve.getNumPoints();
+    std::vector<double> source_db((size_t) num_points), reference_db((size_t) num_points);
+    
+    for (int i = 0; i < num_points; ++i)
+    {
+        source_db[(size_t) i] = source.getLevelDb(base.curve.getFrequency(i), options.smoothing_octaves);
+        reference_db[(size_t) i] = reference.getLevelDb(base.curve.getFrequency(i), options.smoothing_octaves);
+    }
+    
+    const auto source_floor = *std::max_element(source_db.begin(), source_db.end()) - level_floor_db;
+    const auto reference_floor = *std::max_element(reference_db.begin(), reference_db.end()) - level_floor_db;
+    target_db.resize((size_t) num_points);
+    weights.resize((size_t) num_points);
+    
+    for (size_t i = 0; i < (size_t) num_points; ++i)
+    {
+        target_db[i] = (float) (reference_db[i] - source_db[i]);
+        weights[i] = source_db[i] > source_floor && reference_db[i] > reference_floor ? 1.f : 0.f;
+    }
+    
+    score(base);
+    
+    Result result;
+    result.target_rms_db = (float) std::sqrt(base.cost);
+    
+    // The cuts alone, then each peak where the error is largest, then everything together
+    if (options.fit_cuts)
+        search(base, true, 0, 0, pool);
+    
+    for (int band = 0; band < options.num_peaks; ++band)
+    {
+        placePeak(base, band);
+        search(base, false, band, 1, pool);
+    }
+    
+    search(base, options.fit_cuts, 0, options.num_peaks, pool);
+    
+    // Onto the parameters' steps
+    auto snap = [](float value, float step, float low, float high)
+    {
+        return juce::jlimit(low, high, step * (float) juce::roundToInt(value / step));
+    };
+    
+    auto& settings = base.settings;
+    settings.low_cut_freq = snap(settings.low_cut_freq, 1.f, 20.f, 20000.f);
+    settings.high_cut_freq = snap(settings.high_cut_freq, 1.f, 20.f, 20000.f);
+    
+    for (int band = 0; band < options.num_peaks; ++band)
+    {
+        const auto i = (size_t) band;
+        settings.band_freq[i] = snap(settings.band_freq[i], 1.f, 20.f, 20000.f);
+        settings.band_gain_db[i] = snap(settings.band_gain_db[i], 0.5f, -24.f, 24.f);
+        settings.band_q[i] = snap(settings.band_q[i], 0.05f, 0.1f, 10.f);
+    }
+    
+    base.stale_bands = all_bands;
+    score(base);
+    
+    result.settings = settings;
+    result.iterations = iterations;
+    result.residual_rms_db = (float) std::sqrt(base.cost);
+    return result;
+}
@@ -0,0 +1,140 @@
+/*
+  ==============================================================================
+
+    ReferenceMatcher.h
+
+    Offline reference matching. LongTermSpectrum averages the power
+    spectrum of a whole file; separate instances can take separate chunks
+    of it on separate threads and be merged afterwards. ReferenceMatcher
+    fits the EQ's own band model (the two cuts and a number of peaks) to
+    the difference between a source's and a reference's spectrum, so the
+    result is a set of parameter values rather than a curve.
+
+    The fit is a pattern search. Each step proposes one candidate per
+    parameter and direction, scores them all on a worker pool and keeps
+    the best, halving the step sizes when none helps. Every candidate has
+    its own ResponseCurve, so scoring one only re-evaluates the bands
+    that differ from what that candidate scored last time.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "ChannelWorkerPool.h"
+#include "ResponseCurve.h"
+
+class LongTermSpectrum
+{
+public:
+    static constexpr int fft_order = 15;
+    static constexpr int fft_size = 1 << fft_order;
+    static constexpr int hop_size = fft_size / 2;
+    static constexpr int num_bins = fft_size / 2 + 1;
+    
+    explicit LongTermSpectrum(double sample_rate);
+    
+    // Hann frames with 50% overlap, whatever doesn't fill a frame carries
+    // over to the next call. Channels are averaged in power, so anything
+    // that would cancel in a mono sum still counts.
+    void addSamples(const float* const* channels, int num_channels, int num_samples);
+    
+    // Adds another chunk's frames in, both at the same sample rate. Frames
+    // don't straddle chunks, each chunk drops less than one frame at its end.
+    void merge(const LongTermSpectrum& other);
+    
+    double getSampleRate() const noexcept     { return sample_rate; }
+    juce::int64 getNumFrames() const noexcept { return num_frames; }
+    
+    // Mean power in dB over a band octave_width wide centred on freq
+    double getLevelDb(double freq, double octave_width) const noexcept;
+    
+private:
+    void runFFT(const float* samples);
+    
+    double sample_rate;
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> window, fft_buffer;
+    std::vector<std::vector<float>> history;   // Per channel
+    std::vector<double> power;                 // Summed over every frame
+    float window_gain { 1.f };
+    int filled { 0 };
+    juce::int64 num_frames { 0 };
+};
+
+class ReferenceMatcher
+{
+public:
+    struct Options
+    {
+        int num_peaks { default_num_bands };          // Fitted into the first bands, the rest are switched off
+        bool fit_cuts { true };
+        float min_freq { 20.f }, max_freq { 20000.f };
+        int num_points { 128 };                       // Log spaced, where the curves are compared
+        double smoothing_octaves { 1.0 / 3.0 };
+        int max_iterations { 1000 };
+    };
+    
+    struct Result
+    {
+        ChainSettings settings;
+        float target_rms_db { 0 };     // Spread of the difference curve before and after the EQ,
+        float residual_rms_db { 0 };   // ignoring overall level
+        int iterations { 0 };   // Steps of every search so far
+    };
+    
+    // Settings that move the source's balance towards the reference's, for
+    // the source's sample rate. Values are rounded onto the parameters' steps
+    // so they can be set as they are. Allocates. Runs on the calling thread
+    // when pool is null.
+    Result fit(const LongTermSpectrum& source, const LongTermSpectrum& reference, const Options& options,
+               ChannelWorkerPool* pool = nullptr);
+    
+private:
+    enum Parameter
+    {
+        LowCutFreq,
+        LowCutSlope,
+        HighCutFreq,
+        HighCutSlope,
+        PeakFreq,
+        PeakGain,
+        PeakQ
+    };
+    
+    struct Move
+    {
+        Parameter parameter;
+        int band;         // For the peak parameters
+        int direction;    // +1 or -1
+    };
+    
+    struct Candidate
+    {
+        ChainSettings settings;
+        ChainCoefficients coefficients;
+        ResponseCurve curve;
+        int stale_bands { all_bands };   // ChainPositions bits to design before scoring
+        bool changed { true };           // False when the move had nothing to change
+        double cost { 0 };
+    };
+    
+    static int getMovedBand(const Move& move) noexcept;
+    bool applyMove(ChainSettings& settings, const Move& move) const noexcept;
+    double getCost(const ResponseCurve& curve) const noexcept;
+    
+    void score(Candidate& candidate) noexcept;
+    static void scoreJob(void* context, int index) noexcept;
+    
+    void placePeak(Candidate& base, int band) noexcept;
+    void search(Candidate& base, bool cuts, int first_band, int num_bands, ChannelWorkerPool* pool);
+    
+    Options options;
+    double sample_rate { 44100.0 }, bottom_freq { 20.0 }, top_freq { 20000.0 };
+    std::vector<float> target_db, weights;
+    std::vector<Move> moves;
+    std::vector<Candidate> candidates;
+    double scale { 1.0 };   // Of the step sizes, halved whenever no move helps
+    int iterations { 0 };   // Steps of every search so far
+};
@@ -0,0 +1,137 @@
+/*
+  ==============================================================================
+
+    ResponseCurve.cpp
+
+  ==============================================================================
+*/
+
+#include "ResponseCurve.h"
+
+void ResponseCurve::setFrequencies(int new_num_points, float min_freq, float max_freq, double sample_rate)
+{
+    num_points = juce::jmax(1, new_num_points);
+    num_vectors = (num_points + width - 1) / width;
+    
+    for (auto* table : { &phi, &phi_squared, &numerator, &denominator })
+        table->assign((size_t) num_vectors, Vector {});
+    
+    frequencies.resize((size_t) num_points);
+    
+    // Tables are stored as whole registers, lanes past num_points just repeat the last point
+    auto* p1 = reinterpret_cast<double*>(phi.data());
+    auto* p2 = reinterpret_cast<double*>(phi_squared.data());
+    
+    for (int i = 0; i < num_vectors * width; ++i)
+    {
+        const auto position = (float) juce::jmin(i, num_points - 1) / (float) juce::jmax(1, num_points - 1);
+        const auto freq = juce::jmin((double) min_freq * std::pow((double) max_freq / min_freq, (double) position), sample_rate * 0.5);
+        const auto half_sine = std::sin(juce::MathConstants<double>::pi * freq / sample_rate);
+        
+        p1[i] = 4.0 * half_sine * half_sine;
+        p2[i] = p1[i] * p1[i];
+        
+        if (i < num_points)
+            frequencies[(size_t) i] = freq;
+    }
+    
+    for (auto& band : band_db)
+        band.assign((size_t) num_points, 0.f);
+    
+    total_db.assign((size_t) num_points, 0.f);
+    valid.fill(false);
+}
+
+ResponseCurve::BandSections ResponseCurve::getBandSections(const ChainCoefficients& coefficients, int band) noexcept
+{
+    BandSections result;
+    
+    // Neutral bands are out of the chain, they draw flat
+    if (! coefficients.isActive(static_cast<ChainPositions>(band)))
+        return result;
+    
+    auto copy_cut = [&result](const CutCoefficients<double>& cut, int slope)
+    {
+        result.num_sections = getNumCutSections(slope);
+        std::copy(cut.begin(), cut.begin() + result.num_sections, result.sections.begin());
+    };
+    
+    if (band == LowCut)
+        copy_cut(coefficients.low_cut, coefficients.low_cut_slope);
+    else if (band == HiCut)
+        copy_cut(coefficients.high_cut, coefficients.high_cut_slope);
+    else
+    {
+        result.num_sections = 1;
+        result.sections[0] = coefficients.bands[(size_t) (band - Band1)];
+    }
+    
+    return result;
+}
+
+// |H|^2 of every section, numerator and denominator kept apart so the
+// vector loop needs no division. The products run in double since a steep
+// cut's stopband underflows float.
+void ResponseCurve::evaluateBand(int band, const BandSections& band_sections) noexcept
+{
+    if (band_sections.num_sections == 0)
+    {
+        std::fill(band_db[(size_t) band].begin(), band_db[(size_t) band].end(), 0.f);
+        return;
+    }
+    
+    std::fill(numerator.begin(), numerator.end(), Vector(1.0));
+    std::fill(denominator.begin(), denominator.end(), Vector(1.0));
+    
+    for (int s = 0; s < band_sections.num_sections; ++s)
+    {
+        const auto& c = band_sections.sections[(size_t) s];
+        const auto num = getPowerResponseTerms(c.b0, c.b1, c.b2);
+        const auto den = getPowerResponseTerms(1.0, c.a1, c.a2);
+        
+        for (int i = 0; i < num_vectors; ++i)
+        {
+            const auto p1 = phi[(size_t) i], p2 = phi_squared[(size_t) i];
+            
+            numerator[(size_t) i] = numerator[(size_t) i] * (p1 * num.linear + p2 * num.quadratic + num.constant);
+            denominator[(size_t) i] = denominator[(size_t) i] * (p1 * den.linear + p2 * den.quadratic + den.constant);
+        }
+    }
+    
+    const auto* num = reinterpret_cast<const double*>(numerator.data());
+    const auto* den = reinterpret_cast<const double*>(denominator.data());
+    auto& db = band_db[(size_t) band];
+    
+    for (int i = 0; i < num_points; ++i)
+        db[(size_t) i] = (float) (10.0 * std::log10(juce::jmax(num[i], 1.0e-300) / juce::jmax(den[i], 1.0e-300)));
+}
+
+bool ResponseCurve::update(const ChainCoefficients& coefficients) noexcept
+{
+    bool changed = false;
+    
+    for (int band = 0; band < num_bands; ++band)
+    {
+        const auto band_sections = getBandSections(coefficients, band);
+        
+        if (valid[(size_t) band] && band_sections == cached_sections[(size_t) band])
+            continue;
+        
+        evaluateBand(band, band_sections);
+        cached_sections[(size_t) band] = band_sections;
+        valid[(size_t) band] = true;
+        changed = true;
+    }
+    
+    if (changed)
+    {
+        std::copy(band_db[0].begin(), band_db[0].end(), total_db.begin());
+        
+        // Bands out of the chain are flat, most of them usually are
+        for (int band = 1; band < num_bands; ++band)
+            if (cached_sections[(size_t) band].num_sections > 0)
+                juce::FloatVectorOperations::add(total_db.data(), band_db[(size_t) band].data(), num_points);
+    }
+    
+    return changed;
+}
@@ -0,0 +1,71 @@
+/*
+  ==============================================================================
+
+    ResponseCurve.h
+
+    The chain's magnitude response at a fixed set of display frequencies.
+    Each band's response is cached and only recomputed when that band's
+    coefficients change. Sections are evaluated across all frequencies at
+    once in SIMD registers, so moving one peak costs one band's worth of
+    maths, however wide the display is.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "FilterChain.h"
+
+class ResponseCurve
+{
+public:
+    static constexpr int num_bands = HiCut + 1;
+    
+    // Log spaced points from min_freq to max_freq. Allocates, call when the
+    // display width, range or sample rate changes.
+    void setFrequencies(int num_points, float min_freq, float max_freq, double sample_rate);
+    
+    // Recomputes the bands whose coefficients changed, returns true if the curve moved
+    bool update(const ChainCoefficients& coefficients) noexcept;
+    
+    int getNumPoints() const noexcept             { return num_points; }
+    double getFrequency(int point) const noexcept { return frequencies[(size_t) point]; }
+    
+    // Combined response, and each band on its own
+    const float* getMagnitudesDb() const noexcept             { return total_db.data(); }
+    const float* getBandMagnitudesDb(int band) const noexcept { return band_db[(size_t) band].data(); }
+    
+private:
+   #if JUCE_USE_SIMD
+    using Vector = juce::dsp::SIMDRegister<double>;
+    static constexpr int width = (int) Vector::SIMDNumElements;
+   #else
+    using Vector = double;
+    static constexpr int width = 1;
+   #endif
+    
+    // The sections a band contributes, used to tell whether it changed
+    struct BandSections
+    {
+        std::array<BiquadCoefficients<double>, max_cut_sections> sections {};
+        int num_sections { 0 };
+        
+        bool operator== (const BandSections& other) const noexcept
+        {
+            return num_sections == other.num_sections
+                && std::memcmp(sections.data(), other.sections.data(), sizeof(sections[0]) * (size_t) num_sections) == 0;
+        }
+    };
+    
+    static BandSections getBandSections(const ChainCoefficients& coefficients, int band) noexcept;
+    void evaluateBand(int band, const BandSections& band_sections) noexcept;
+    
+    int num_points { 0 }, num_vectors { 0 };
+    std::vector<Vector> phi, phi_squared, numerator, denominator;
+    std::vector<double> frequencies;
+    std::array<std::vector<float>, num_bands> band_db;
+    std::vector<float> total_db;
+    std::array<BandSections, num_bands> cached_sections;
+    std::array<bool, num_bands> valid {};
+};
@@ -0,0 +1,234 @@
+/*
+  ==============================================================================
+
+    SpectrumAnalyzer.cpp
+
+  ==============================================================================
+*/
+
+#include "SpectrumAnalyzer.h"
+
+template <typename SampleType>
+void SpectrumAnalyzer::SampleFifo::push(const SampleType* const* channels, int num_channels, int num_samples) noexcept
+{
+    if (num_channels <= 0)
+        return;
+    
+    const auto scope = fifo.write(num_samples);
+    const auto gain = 1.f / (float) num_channels;
+    
+    auto mix = [&](int start, int size, int offset)
+    {
+        for (int i = 0; i < size; ++i)
+        {
+            auto sum = SampleType();
+            
+            for (int ch = 0; ch < num_channels; ++ch)
+                sum += channels[ch][offset + i];
+            
+            buffer[(size_t) (start + i)] = (float) sum * gain;
+        }
+    };
+    
+    mix(scope.startIndex1, scope.blockSize1, 0);
+    mix(scope.startIndex2, scope.blockSize2, scope.blockSize1);
+}
+
+int SpectrumAnalyzer::SampleFifo::read(float* destination, int num_samples) noexcept
+{
+    const auto scope = fifo.read(num_samples);
+    
+    std::copy(buffer.begin() + scope.startIndex1, buffer.begin() + scope.startIndex1 + scope.blockSize1, destination);
+    std::copy(buffer.begin() + scope.startIndex2, buffer.begin() + scope.startIndex2 + scope.blockSize2, destination + scope.blockSize1);
+    
+    return scope.blockSize1 + scope.blockSize2;
+}
+
+void SpectrumAnalyzer::SampleFifo::discard(int num_samples) noexcept
+{
+    fifo.finishedRead(juce::jmin(num_samples, fifo.getNumReady()));
+}
+
+//==============================================================================
+SpectrumAnalyzer::SpectrumAnalyzer()
+    : juce::Thread("EQ Spectrum Analyzer")
+{
+    frames.forEachBuffer([](Frame& frame)
+    {
+        frame.pre_db.resize((size_t) max_bins);
+        frame.post_db.resize((size_t) max_bins);
+    });
+}
+
+SpectrumAnalyzer::~SpectrumAnalyzer()
+{
+    stopThread(1000);
+}
+
+void SpectrumAnalyzer::prepare(double new_sample_rate) noexcept
+{
+    sample_rate = new_sample_rate;
+}
+
+void SpectrumAnalyzer::pushPre(const float* const* channels, int num_channels, int num_samples) noexcept
+{
+    if (accepting.load(std::memory_order_relaxed))
+        pre.fifo.push(channels, num_channels, num_samples);
+}
+
+void SpectrumAnalyzer::pushPost(const float* const* channels, int num_channels, int num_samples) noexcept
+{
+    if (accepting.load(std::memory_order_relaxed))
+        post.fifo.push(channels, num_channels, num_samples);
+}
+
+void SpectrumAnalyzer::pushPre(const double* const* channels, int num_channels, int num_samples) noexcept
+{
+    if (accepting.load(std::memory_order_relaxed))
+        pre.fifo.push(channels, num_channels, num_samples);
+}
+
+void SpectrumAnalyzer::pushPost(const double* const* channels, int num_channels, int num_samples) noexcept
+{
+    if (accepting.load(std::memory_order_relaxed))
+        post.fifo.push(channels, num_channels, num_samples);
+}
+
+void SpectrumAnalyzer::attachDisplay()
+{
+    if (++num_displays == 1)
+        startThread(juce::Thread::Priority::low);
+}
+
+void SpectrumAnalyzer::detachDisplay()
+{
+    jassert(num_displays > 0);
+    
+    if (--num_displays == 0)
+    {
+        accepting = false;
+        stopThread(1000);
+    }
+}
+
+// Allocates, analysis thread only
+void SpectrumAnalyzer::configure(int order)
+{
+    fft_size = 1 << order;
+    fft = std::make_unique<juce::dsp::FFT>(order);
+    fft_buffer.assign((size_t) (2 * fft_size), 0.f);
+    
+    // Hann, scaled so a full scale sine reads 0 dB
+    window.resize((size_t) fft_size);
+    auto sum = 0.f;
+    
+    for (int i = 0; i < fft_size; ++i)
+    {
+        window[(size_t) i] = 0.5f - 0.5f * std::cos(juce::MathConstants<float>::twoPi * (float) i / (float) fft_size);
+        sum += window[(size_t) i];
+    }
+    
+    window_gain = 2.f / sum;
+    
+    for (auto* channel : { &pre, &post })
+    {
+        channel->history.assign((size_t) fft_size, 0.f);
+        channel->power.assign((size_t) (fft_size / 2 + 1), 0.f);
+        channel->pending = 0;
+    }
+}
+
+void SpectrumAnalyzer::run()
+{
+    // Whatever queued up before the display attached is stale
+    for (auto* channel : { &pre, &post })
+        channel->fifo.discard(channel->fifo.getNumReady());
+    
+    accepting = true;
+    fft_size = 0;
+    
+    while (! threadShouldExit())
+    {
+        const auto order = fft_order.load();
+        
+        if (fft_size != 1 << order)
+            configure(order);
+        
+        hop_size = juce::jmax(1, juce::roundToInt((float) fft_size * (1.f - overlap_amount.load())));
+        
+        const auto time = averaging_time.load();
+        decay = time > 0.f ? std::exp(-(float) hop_size / ((float) sample_rate.load() * time)) : 0.f;
+        
+        const auto pre_changed = analyse(pre);
+        const auto post_changed = analyse(post);
+        
+        if (pre_changed || post_changed)
+        {
+            auto& frame = frames.getWriteBuffer();
+            frame.num_bins = fft_size / 2 + 1;
+            frame.fft_size = fft_size;
+            frame.sample_rate = sample_rate.load();
+            
+            auto to_db = [](const std::vector<float>& power, std::vector<float>& db, int num_bins)
+            {
+                for (int k = 0; k < num_bins; ++k)
+                    db[(size_t) k] = 10.f * std::log10(power[(size_t) k] + 1.0e-12f);
+            };
+            
+            to_db(pre.power, frame.pre_db, frame.num_bins);
+            to_db(post.power, frame.post_db, frame.num_bins);
+            frames.publish();
+        }
+        
+        wait(1000 / refresh_rate.load());
+    }
+}
+
+// Runs the FFTs this display frame can afford, returns true if any ran
+bool SpectrumAnalyzer::analyse(Channel& channel)
+{
+    // Only the newest hops matter, skip anything older
+    const auto budget = max_ffts_per_frame * hop_size + fft_size;
+    const auto backlog = channel.fifo.getNumReady() - budget;
+    
+    if (backlog > 0)
+    {
+        channel.fifo.discard(backlog);
+        channel.pending = 0;
+    }
+    
+    bool ran = false;
+    
+    while (channel.fifo.getNumReady() > 0)
+    {
+        const auto wanted = juce::jlimit(0, channel.fifo.getNumReady(), hop_size - channel.pending);
+        
+        std::copy(channel.history.begin() + wanted, channel.history.end(), channel.history.begin());
+        channel.pending += channel.fifo.read(channel.history.data() + fft_size - wanted, wanted);
+        
+        if (channel.pending >= hop_size)
+        {
+            runFFT(channel);
+            channel.pending = 0;
+            ran = true;
+        }
+    }
+    
+    return ran;
+}
+
+void SpectrumAnalyzer::runFFT(Channel& channel)
+{
+    for (int i = 0; i < fft_size; ++i)
+        fft_buffer[(size_t) i] = channel.history[(size_t) i] * window[(size_t) i];
+    
+    std::fill(fft_buffer.begin() + fft_size, fft_buffer.end(), 0.f);
+    fft->performFrequencyOnlyForwardTransform(fft_buffer.data(), true);
+    
+    for (int k = 0; k <= fft_size / 2; ++k)
+    {
+        const auto magnitude = fft_buffer[(size_t) k] * window_gain;
+        auto& power = channel.power[(size_t) k];
+        power = power * decay + magnitude * magnitude * (1.f - decay);
+    }
+}
@@ -0,0 +1,115 @@
+/*
+  ==============================================================================
+
+    SpectrumAnalyzer.h
+
+    Pre / post EQ spectrum for the editor. The audio thread pushes a mono
+    sum of each block into a wait-free single producer / single consumer
+    FIFO (nothing is pushed while no display is attached). A background
+    thread wakes once per display frame, runs windowed FFTs over what
+    arrived with the configured size and overlap, and publishes averaged
+    magnitude frames through a triple buffer.
+
+    The number of FFTs per display frame is capped and any older backlog
+    is skipped, so the analysis cost follows the display refresh rate
+    rather than the host's block rate.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "TripleBuffer.h"
+
+class SpectrumAnalyzer : private juce::Thread
+{
+public:
+    static constexpr int min_fft_order = 9, max_fft_order = 14;
+    static constexpr int max_bins = (1 << max_fft_order) / 2 + 1;
+    
+    // Magnitudes in dB, bin k is at k * sample_rate / fft_size
+    struct Frame
+    {
+        std::vector<float> pre_db, post_db;
+        int num_bins { 0 }, fft_size { 0 };
+        double sample_rate { 0 };
+    };
+    
+    SpectrumAnalyzer();
+    ~SpectrumAnalyzer() override;
+    
+    void prepare(double sample_rate) noexcept;
+    
+    // Audio thread, wait-free and allocation free
+    void pushPre(const float* const* channels, int num_channels, int num_samples) noexcept;
+    void pushPost(const float* const* channels, int num_channels, int num_samples) noexcept;
+    void pushPre(const double* const* channels, int num_channels, int num_samples) noexcept;
+    void pushPost(const double* const* channels, int num_channels, int num_samples) noexcept;
+    
+    // Picked up by the analysis thread on its next frame
+    void setFFTOrder(int order) noexcept          { fft_order = juce::jlimit(min_fft_order, max_fft_order, order); }
+    void setOverlap(float overlap) noexcept       { overlap_amount = juce::jlimit(0.f, 0.875f, overlap); }
+    void setRefreshRate(int hz) noexcept          { refresh_rate = juce::jlimit(1, 120, hz); }
+    void setAveragingTime(float seconds) noexcept { averaging_time = juce::jmax(0.f, seconds); }
+    
+    int getRefreshRate() const noexcept { return refresh_rate; }
+    
+    // Message thread. Analysis only runs while at least one display is attached.
+    void attachDisplay();
+    void detachDisplay();
+    
+    // Display side (a single reader), returns true if a new frame arrived
+    bool updateFrame() noexcept                 { return frames.update(); }
+    const Frame& getFrame() const noexcept      { return frames.getReadBuffer(); }
+    
+private:
+    // Mono sum of the channels, drops samples rather than block if it's full
+    class SampleFifo
+    {
+    public:
+        SampleFifo() : fifo(capacity) { buffer.resize((size_t) capacity); }
+        
+        template <typename SampleType>
+        void push(const SampleType* const* channels, int num_channels, int num_samples) noexcept;
+        int read(float* destination, int num_samples) noexcept;
+        void discard(int num_samples) noexcept;
+        int getNumReady() const noexcept { return fifo.getNumReady(); }
+        
+    private:
+        static constexpr int capacity = 2 << max_fft_order;
+        
+        juce::AbstractFifo fifo;
+        std::vector<float> buffer;
+    };
+    
+    struct Channel
+    {
+        SampleFifo fifo;
+        std::vector<float> history, power;
+        int pending { 0 };
+    };
+    
+    void run() override;
+    void configure(int order);
+    bool analyse(Channel& channel);
+    void runFFT(Channel& channel);
+    
+    static constexpr int max_ffts_per_frame = 8;
+    
+    std::atomic<int> fft_order { 12 }, refresh_rate { 30 }, num_displays { 0 };
+    std::atomic<float> overlap_amount { 0.75f }, averaging_time { 0.2f };
+    std::atomic<double> sample_rate { 44100.0 };
+    std::atomic<bool> accepting { false };
+    
+    // Analysis thread only
+    Channel pre, post;
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::vector<float> window, fft_buffer;
+    int fft_size { 0 }, hop_size { 0 };
+    float window_gain { 1.f }, decay { 0.f };
+    
+    TripleBuffer<Frame> frames;
+    
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SpectrumAnalyzer)
+};
@@ -0,0 +1,434 @@
+/*
+  ==============================================================================
+
+    StateVariableFilter.h
+
+    Topology preserving transform (trapezoidal) state variable filters, the
+    alternative to the biquad cascade for bands that get modulated. A
+    section is described by g = tan(pi f / sample_rate), the damping k and
+    three output mixes, so a redesign is one tan and a few multiplies, and
+    the structure stays stable and click free while its coefficients move.
+    The cascade below ramps every section's coefficients sample by sample
+    from the last set it was given to the new one.
+
+    With fixed coefficients a section has exactly the response of the RBJ /
+    Butterworth biquad of the same settings (both are the bilinear transform
+    of the same analog prototype), see toBiquadCoefficients.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "BiquadDesign.h"
+
+// y = m0 * input + m1 * band pass + m2 * low pass. The defaults pass the input through.
+template <typename SampleType>
+struct SvfCoefficients
+{
+    SampleType g { 0 }, k { 1 }, m0 { 1 }, m1 { 0 }, m2 { 0 };
+    
+    bool operator== (const SvfCoefficients& other) const noexcept
+    {
+        return g == other.g && k == other.k && m0 == other.m0 && m1 == other.m1 && m2 == other.m2;
+    }
+    
+    bool operator!= (const SvfCoefficients& other) const noexcept { return ! operator== (other); }
+};
+
+template <typename SampleType>
+using CutSvfCoefficients = std::array<SvfCoefficients<SampleType>, max_cut_sections>;
+
+// The transfer function is (m0 s^2 + (m0 k + m1) s + m0 + m2) / (s^2 + k s + 1)
+// with s = (1 / g) (1 - z^-1) / (1 + z^-1)
+inline BiquadCoefficients<double> toBiquadCoefficients(const SvfCoefficients<double>& c) noexcept
+{
+    const auto g = c.g, g_squared = g * g;
+    const auto n2 = c.m0, n1 = (c.m0 * c.k + c.m1) * g, n0 = (c.m0 + c.m2) * g_squared;
+    const auto inv_a0 = 1.0 / (1.0 + c.k * g + g_squared);
+    
+    return { (n2 + n1 + n0) * inv_a0,
+             2.0 * (n0 - n2) * inv_a0,
+             (n2 - n1 + n0) * inv_a0,
+             2.0 * (g_squared - 1.0) * inv_a0,
+             (1.0 - c.k * g + g_squared) * inv_a0 };
+}
+
+// The other way round, for sections designed as biquads (e.g. matched
+// designs). Any stable biquad has an SVF form: g and k come from the poles,
+// the mixes from the zeros.
+inline SvfCoefficients<double> toSvfCoefficients(const BiquadCoefficients<double>& c) noexcept
+{
+    // (1 + a1 + a2) and (1 - a1 + a2) are the denominator at DC and Nyquist, both positive when stable
+    const auto dc = 1.0 + c.a1 + c.a2, nyquist = 1.0 - c.a1 + c.a2;
+    jassert(dc > 0 && nyquist > 0);
+    
+    const auto g = std::sqrt(dc / nyquist);
+    const auto k = 2.0 * g * (1.0 - c.a2) / dc;
+    const auto m0 = g * g * (c.b0 - c.b1 + c.b2) / dc;
+    
+    return { g, k, m0, 2.0 * g * (c.b0 - c.b2) / dc - m0 * k, (c.b0 + c.b1 + c.b2) / dc - m0 };
+}
+
+inline double getSvfG(double sample_rate, double freq) noexcept
+{
+    jassert(sample_rate > 0 && freq > 0 && freq <= sample_rate * 0.5);
+    return std::tan(juce::MathConstants<double>::pi * freq / sample_rate);
+}
+
+inline void makeSvfPeakCoefficients(SvfCoefficients<double>& c, double sample_rate, double freq, double q, double gain_db) noexcept
+{
+    const auto a = std::pow(10.0, gain_db / 40.0);
+    c = { getSvfG(sample_rate, freq), 1.0 / (q * a), 1.0, 0.0, 0.0 };
+    c.m1 = c.k * (a * a - 1.0);
+}
+
+inline void makeSvfLowShelfCoefficients(SvfCoefficients<double>& c, double sample_rate, double freq, double q, double gain_db) noexcept
+{
+    const auto a = std::pow(10.0, gain_db / 40.0);
+    c = { getSvfG(sample_rate, freq) / std::sqrt(a), 1.0 / q, 1.0, (a - 1.0) / q, a * a - 1.0 };
+}
+
+inline void makeSvfHighShelfCoefficients(SvfCoefficients<double>& c, double sample_rate, double freq, double q, double gain_db) noexcept
+{
+    const auto a = std::pow(10.0, gain_db / 40.0);
+    c = { getSvfG(sample_rate, freq) * std::sqrt(a), 1.0 / q, a * a, (1.0 - a) * a / q, 1.0 - a * a };
+}
+
+inline void makeSvfNotchCoefficients(SvfCoefficients<double>& c, double sample_rate, double freq, double q) noexcept
+{
+    c = { getSvfG(sample_rate, freq), 1.0 / q, 1.0, -1.0 / q, 0.0 };
+}
+
+// Same as makeTiltCoefficients: a high shelf turned down by half its gain
+inline void makeSvfTiltCoefficients(SvfCoefficients<double>& c, double sample_rate, double freq, double q, double gain_db) noexcept
+{
+    makeSvfHighShelfCoefficients(c, sample_rate, freq, q, gain_db);
+    
+    const auto trim = std::pow(10.0, -gain_db / 40.0);
+    c.m0 *= trim;
+    c.m1 *= trim;
+    c.m2 *= trim;
+}
+
+// Any BandType, a notch ignores gain_db
+inline void makeSvfBandCoefficients(SvfCoefficients<double>& c, int type, double sample_rate, double freq, double q, double gain_db) noexcept
+{
+    switch (type)
+    {
+        case Band_LowShelf:  makeSvfLowShelfCoefficients(c, sample_rate, freq, q, gain_db);  break;
+        case Band_HighShelf: makeSvfHighShelfCoefficients(c, sample_rate, freq, q, gain_db); break;
+        case Band_Notch:     makeSvfNotchCoefficients(c, sample_rate, freq, q);               break;
+        case Band_Tilt:      makeSvfTiltCoefficients(c, sample_rate, freq, q, gain_db);      break;
+        default:             makeSvfPeakCoefficients(c, sample_rate, freq, q, gain_db);      break;
+    }
+}
+
+// Butterworth high pass cascade, fills the first getNumCutSections(slope) entries.
+// g is the same for every section, so the whole cut costs one tan.
+inline void makeSvfLowCutCoefficients(CutSvfCoefficients<double>& sections, double sample_rate, double freq, int slope) noexcept
+{
+    const auto g = getSvfG(sample_rate, freq);
+    
+    for (int i = 0; i < getNumCutSections(slope); ++i)
+    {
+        const auto k = 1.0 / getButterworthQ(slope, i);
+        sections[(size_t) i] = { g, k, 1.0, -k, -1.0 };
+    }
+}
+
+// Butterworth low pass cascade, fills the first getNumCutSections(slope) entries
+inline void makeSvfHighCutCoefficients(CutSvfCoefficients<double>& sections, double sample_rate, double freq, int slope) noexcept
+{
+    const auto g = getSvfG(sample_rate, freq);
+    
+    for (int i = 0; i < getNumCutSections(slope); ++i)
+        sections[(size_t) i] = { g, 1.0 / getButterworthQ(slope, i), 0.0, 0.0, 1.0 };
+}
+
+//==============================================================================
+// A chain of SVF sections over every channel. Like BiquadCascade, sections
+// are switched on by a mask and inactive ones keep their state. Sections
+// run one after another over the whole block, each channel in turn. The
+// first two channels can run different sections, or run as mid / side,
+// see setSides.
+template <int MaxSections, typename SampleType>
+class StateVariableCascade
+{
+public:
+    static constexpr int max_sections = MaxSections;
+    
+    // Allocates state and the ramp scratch, call from prepareToPlay
+    void prepare(int num_channels, int max_block_size)
+    {
+        prepared_channels = num_channels;
+        prepared_block_size = juce::jmax(1, max_block_size);
+        state.assign((size_t) (max_sections * num_channels * 2), SampleType());
+        ramp.assign((size_t) (prepared_block_size * num_ramp_values), SampleType());
+    }
+    
+    void reset() noexcept
+    {
+        std::fill(state.begin(), state.end(), SampleType());
+    }
+    
+    void resetSections(juce::uint32 mask) noexcept
+    {
+        for (int section = 0; section < max_sections; ++section)
+            if (mask & (1u << section))
+                std::fill_n(state.begin() + section * prepared_channels * 2, prepared_channels * 2, SampleType());
+    }
+    
+    // Both must be prepared with the same channel count, never allocates
+    void copyFrom(const StateVariableCascade& other) noexcept
+    {
+        jassert(other.state.size() == state.size());
+        
+        current = other.current;
+        target = other.target;
+        active_mask = other.active_mask;
+        side_masks = other.side_masks;
+        mid_side = other.mid_side;
+        std::copy(other.state.begin(), other.state.end(), state.begin());
+    }
+    
+    // The section ramps to these over the next process call. A section that
+    // isn't running yet, or ramp_to_them false, takes them straight away.
+    void setCoefficients(int section, const SvfCoefficients<double>& new_coefficients, bool ramp_to_them = true) noexcept
+    {
+        jassert(section >= 0 && section < max_sections);
+        const auto converted = convert(new_coefficients);
+        
+        target[(size_t) section] = converted;
+        
+        if (! ramp_to_them || (active_mask & (1u << section)) == 0)
+            current[(size_t) section] = converted;
+    }
+    
+    void setActiveSections(juce::uint32 mask) noexcept  { active_mask = mask; }
+    juce::uint32 getActiveSections() const noexcept     { return active_mask; }
+    
+    // Like BiquadCascade::setSides. Mid / side is encoded as the first
+    // running section reads the pair and decoded as the last one writes it.
+    void setSides(juce::uint32 first_mask, juce::uint32 second_mask, bool use_mid_side) noexcept
+    {
+        side_masks = { first_mask, second_mask };
+        mid_side = use_mid_side;
+    }
+    
+    void process(SampleType* const* channels, int num_channels, int start_sample, int num_samples) noexcept
+    {
+        jassert(num_channels <= prepared_channels);
+        
+        if (active_mask == 0)
+            return;
+        
+        const auto pair_mid_side = mid_side && num_channels >= 2;
+        const auto first_section = juce::findHighestSetBit(active_mask & (~active_mask + 1));
+        const auto last_section = juce::findHighestSetBit(active_mask);
+        
+        // A ramp spans the whole call, however it's chunked
+        for (int offset = start_sample; offset < start_sample + num_samples; offset += prepared_block_size)
+        {
+            const auto remaining = start_sample + num_samples - offset;
+            const auto chunk = juce::jmin(prepared_block_size, remaining);
+            
+            for (int section = 0; section < max_sections; ++section)
+                if (active_mask & (1u << section))
+                    processSection(section, channels, num_channels, offset, chunk, remaining,
+                                   pair_mid_side && section == first_section, pair_mid_side && section == last_section);
+        }
+    }
+    
+private:
+    using Coefficients = SvfCoefficients<SampleType>;
+    
+    // Per sample a1, a2, a3, m0, m1, m2 of a ramping section
+    static constexpr int num_ramp_values = 6;
+    
+    static Coefficients convert(const SvfCoefficients<double>& c) noexcept
+    {
+        return { (SampleType) c.g, (SampleType) c.k, (SampleType) c.m0, (SampleType) c.m1, (SampleType) c.m2 };
+    }
+    
+    bool runsOnChannel(int section, int channel) const noexcept
+    {
+        return channel >= 2 || (side_masks[(size_t) channel] & (1u << section)) != 0;
+    }
+    
+    void processSection(int section, SampleType* const* channels, int num_channels, int offset, int num_samples, int ramp_remaining,
+                        bool encode_mid_side, bool decode_mid_side) noexcept
+    {
+        auto& from = current[(size_t) section];
+        const auto& to = target[(size_t) section];
+        auto* section_state = state.data() + section * prepared_channels * 2;
+        const auto ramping = ! (from == to);
+        int first_channel = 0;
+        
+        if (ramping)
+            fillRamp(section, num_samples, ramp_remaining);
+        
+        if (encode_mid_side || decode_mid_side)
+        {
+            processMidSidePair(section, channels[0] + offset, channels[1] + offset, num_samples, ramping, encode_mid_side, decode_mid_side);
+            first_channel = 2;
+        }
+        
+        if (! ramping)
+        {
+            const auto a1 = SampleType(1) / (SampleType(1) + to.g * (to.g + to.k));
+            const auto a2 = to.g * a1, a3 = to.g * a2;
+            
+            for (int ch = first_channel; ch < num_channels; ++ch)
+            {
+                if (! runsOnChannel(section, ch))
+                    continue;
+                
+                auto ic1eq = section_state[ch * 2], ic2eq = section_state[ch * 2 + 1];
+                auto* data = channels[ch] + offset;
+                
+                for (int n = 0; n < num_samples; ++n)
+                {
+                    const auto v0 = data[n];
+                    const auto v3 = v0 - ic2eq;
+                    const auto v1 = a1 * ic1eq + a2 * v3;
+                    const auto v2 = ic2eq + a2 * ic1eq + a3 * v3;
+                    ic1eq = SampleType(2) * v1 - ic1eq;
+                    ic2eq = SampleType(2) * v2 - ic2eq;
+                    data[n] = to.m0 * v0 + to.m1 * v1 + to.m2 * v2;
+                }
+                
+                section_state[ch * 2] = ic1eq;
+                section_state[ch * 2 + 1] = ic2eq;
+            }
+            
+            return;
+        }
+        
+        for (int ch = first_channel; ch < num_channels; ++ch)
+        {
+            if (! runsOnChannel(section, ch))
+                continue;
+            
+            auto ic1eq = section_state[ch * 2], ic2eq = section_state[ch * 2 + 1];
+            auto* data = channels[ch] + offset;
+            const auto* r = ramp.data();
+            
+            for (int n = 0; n < num_samples; ++n, r += num_ramp_values)
+                data[n] = processRampSample(data[n], ic1eq, ic2eq, r);
+            
+            section_state[ch * 2] = ic1eq;
+            section_state[ch * 2 + 1] = ic2eq;
+        }
+        
+        // Land exactly on the target rather than on accumulated steps
+        if (num_samples == ramp_remaining)
+            from = to;
+    }
+    
+    // Linear steps towards the target, worked out once for all channels
+    void fillRamp(int section, int num_samples, int ramp_remaining) noexcept
+    {
+        auto& from = current[(size_t) section];
+        const auto& to = target[(size_t) section];
+        const auto steps = (SampleType) ramp_remaining;
+        const auto dg = (to.g - from.g) / steps, dk = (to.k - from.k) / steps;
+        const auto dm0 = (to.m0 - from.m0) / steps, dm1 = (to.m1 - from.m1) / steps, dm2 = (to.m2 - from.m2) / steps;
+        auto* r = ramp.data();
+        
+        for (int n = 0; n < num_samples; ++n, r += num_ramp_values)
+        {
+            from.g += dg;
+            from.k += dk;
+            from.m0 += dm0;
+            from.m1 += dm1;
+            from.m2 += dm2;
+            
+            r[0] = SampleType(1) / (SampleType(1) + from.g * (from.g + from.k));
+            r[1] = from.g * r[0];
+            r[2] = from.g * r[1];
+            r[3] = from.m0;
+            r[4] = from.m1;
+            r[5] = from.m2;
+        }
+    }
+    
+    static SampleType processRampSample(SampleType v0, SampleType& ic1eq, SampleType& ic2eq, const SampleType* r) noexcept
+    {
+        const auto v3 = v0 - ic2eq;
+        const auto v1 = r[0] * ic1eq + r[1] * v3;
+        const auto v2 = ic2eq + r[1] * ic1eq + r[2] * v3;
+        ic1eq = SampleType(2) * v1 - ic1eq;
+        ic2eq = SampleType(2) * v2 - ic2eq;
+        return r[3] * v0 + r[4] * v1 + r[5] * v2;
+    }
+    
+    // The first and last section of a mid / side pass read and write the
+    // pair together, converting it on the way. Ramping or not, the per
+    // sample values come from the ramp scratch, a fixed section just
+    // doesn't step through it.
+    void processMidSidePair(int section, SampleType* first, SampleType* second, int num_samples, bool ramping,
+                            bool encode, bool decode) noexcept
+    {
+        const auto& to = target[(size_t) section];
+        const auto stride = ramping ? num_ramp_values : 0;
+        const auto runs_first = runsOnChannel(section, 0), runs_second = runsOnChannel(section, 1);
+        auto* section_state = state.data() + section * prepared_channels * 2;
+        auto* r = ramp.data();
+        
+        if (! ramping)
+        {
+            r[0] = SampleType(1) / (SampleType(1) + to.g * (to.g + to.k));
+            r[1] = to.g * r[0];
+            r[2] = to.g * r[1];
+            r[3] = to.m0;
+            r[4] = to.m1;
+            r[5] = to.m2;
+        }
+        
+        const SampleType half (0.5);
+        auto first_ic1eq = section_state[0], first_ic2eq = section_state[1];
+        auto second_ic1eq = section_state[2], second_ic2eq = section_state[3];
+        
+        for (int n = 0; n < num_samples; ++n, r += stride)
+        {
+            auto a = first[n], b = second[n];
+            
+            if (encode)
+            {
+                const auto left = a;
+                a = half * (left + b);
+                b = half * (left - b);
+            }
+            
+            if (runs_first)
+                a = processRampSample(a, first_ic1eq, first_ic2eq, r);
+            
+            if (runs_second)
+                b = processRampSample(b, second_ic1eq, second_ic2eq, r);
+            
+            if (decode)
+            {
+                const auto mid = a;
+                a = mid + b;
+                b = mid - b;
+            }
+            
+            first[n] = a;
+            second[n] = b;
+        }
+        
+        section_state[0] = first_ic1eq;
+        section_state[1] = first_ic2eq;
+        section_state[2] = second_ic1eq;
+        section_state[3] = second_ic2eq;
+    }
+    
+    std::array<Coefficients, max_sections> current {}, target {};
+    std::vector<SampleType> state, ramp;
+    juce::uint32 active_mask { 0 };
+    std::array<juce::uint32, 2> side_masks { ~0u, ~0u };
+    bool mid_side { false };
+    int prepared_channels { 0 }, prepared_block_size { 0 };
+};
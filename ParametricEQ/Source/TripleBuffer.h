@@ -0,0 +1,63 @@
+/*
+  ==============================================================================
+
+    TripleBuffer.h
+
+    Wait-free single producer / single consumer handoff of the latest value.
+    The writer fills getWriteBuffer() and calls publish(), the reader calls
+    update() and then reads getReadBuffer(). Neither side ever blocks, and
+    the reader always sees the most recently published value.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+
+template <typename Type>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+
+    // Writer side. The write buffer holds stale data, so fill it completely.
+    Type& getWriteBuffer() noexcept { return buffers[write_index]; }
+
+    void publish() noexcept
+    {
+        auto previous = shared_index.exchange(write_index | new_data_flag, std::memory_order_acq_rel);
+        write_index = previous & index_mask;
+    }
+
+    // Reader side. Returns true if a new value was picked up.
+    bool update() noexcept
+    {
+        if ((shared_index.load(std::memory_order_relaxed) & new_data_flag) == 0)
+            return false;
+
+        auto previous = shared_index.exchange(read_index, std::memory_order_acq_rel);
+        read_index = previous & index_mask;
+        return true;
+    }
+
+    const Type& getReadBuffer() const noexcept { return buffers[read_index]; }
+
+    // Setup only, while neither side is running (e.g. to size all three buffers)
+    template <typename Function>
+    void forEachBuffer(Function&& function)
+    {
+        for (auto& buffer : buffers)
+            function(buffer);
+    }
+
+private:
+    static constexpr int index_mask = 3;
+    static constexpr int new_data_flag = 4;
+
+    std::array<Type, 3> buffers {};
+    std::atomic<int> shared_index { 1 };
+    int write_index { 0 }, read_index { 2 };
+
+    JUCE_DECLARE_NON_COPYABLE (TripleBuffer)
+};
@@ -0,0 +1,499 @@
+/*
+  ==============================================================================
+
+    Headless batch renderer: runs audio files through the ParametricEQ
+    filter chain without a host.
+
+    BatchRenderer --preset settings.json [--output-dir dir] [--block-size n]
+                  [--threads n] file1.wav file2.flac ...
+
+    The preset is a JSON object keyed on the plugin's parameter IDs, e.g.
+    { "LowCut Freq": 40, "LowCut Slope": 2, "Peak1 Gain": -3.5 }. Bands go
+    up to Peak24, each with Freq, Gain, Q, Type, Enabled, Topology and
+    Placement. "Stereo Mode" only matters for stereo files. Anything left
+    out keeps the plugin's default. Each file is written as <name>_eq.<ext>
+    (numbered when two inputs would get the same output) and only replaces
+    an existing file once it has rendered completely.
+
+    BatchRenderer --match-reference reference.wav [--write-preset matched.json]
+                  [--peaks n] [--threads n] source1.wav source2.flac ...
+
+    Fits the cuts and n peaks (3 by default) so the sources, taken together,
+    get the reference's long term tonal balance, see ReferenceMatcher. The
+    result is written as a preset in the format above, or printed.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/FilterChain.h"
+#include "../../../Source/ReferenceMatcher.h"
+#include "WorkStealingScheduler.h"
+
+static bool loadPreset(const juce::File& file, ChainSettings& settings, juce::String& error)
+{
+    auto json = juce::JSON::parse(file.loadFileAsString());
+
+    if (! json.isObject())
+    {
+        error = "Couldn't parse preset " + file.getFullPathName();
+        return false;
+    }
+
+    auto read = [&json](const char* parameter_id, auto& value)
+    {
+        if (json.hasProperty(parameter_id))
+            value = static_cast<std::remove_reference_t<decltype(value)>>((double) json[parameter_id]);
+    };
+
+    read("LowCut Freq", settings.low_cut_freq);
+    read("HiCut Freq", settings.high_cut_freq);
+    read("LowCut Slope", settings.low_cut_slope);
+    read("HiCut Slope", settings.high_cut_slope);
+    read("LowCut Topology", settings.low_cut_topology);
+    read("HiCut Topology", settings.high_cut_topology);
+    read("Filter Design", settings.design_method);
+    read("LowCut Placement", settings.low_cut_placement);
+    read("HiCut Placement", settings.high_cut_placement);
+    read("Stereo Mode", settings.stereo_mode);
+
+    for (int band = 0; band < max_bands; ++band)
+    {
+        const auto i = (size_t) band;
+        read(getBandParameterID(band, "Freq").toRawUTF8(), settings.band_freq[i]);
+        read(getBandParameterID(band, "Gain").toRawUTF8(), settings.band_gain_db[i]);
+        read(getBandParameterID(band, "Q").toRawUTF8(), settings.band_q[i]);
+        read(getBandParameterID(band, "Type").toRawUTF8(), settings.band_type[i]);
+        read(getBandParameterID(band, "Enabled").toRawUTF8(), settings.band_enabled[i]);
+        read(getBandParameterID(band, "Topology").toRawUTF8(), settings.band_topology[i]);
+        read(getBandParameterID(band, "Placement").toRawUTF8(), settings.band_placement[i]);
+
+        settings.band_type[i] = juce::jlimit(0, num_band_types - 1, settings.band_type[i]);
+        settings.band_topology[i] = juce::jlimit((int) Topology_Biquad, (int) Topology_Svf, settings.band_topology[i]);
+        settings.band_placement[i] = juce::jlimit((int) Placement_Both, (int) Placement_Second, settings.band_placement[i]);
+    }
+
+    settings.low_cut_topology = juce::jlimit((int) Topology_Biquad, (int) Topology_Svf, settings.low_cut_topology);
+    settings.high_cut_topology = juce::jlimit((int) Topology_Biquad, (int) Topology_Svf, settings.high_cut_topology);
+    settings.design_method = juce::jlimit((int) Design_Bilinear, (int) Design_Matched, settings.design_method);
+    settings.low_cut_placement = juce::jlimit((int) Placement_Both, (int) Placement_Second, settings.low_cut_placement);
+    settings.high_cut_placement = juce::jlimit((int) Placement_Both, (int) Placement_Second, settings.high_cut_placement);
+    settings.stereo_mode = juce::jlimit((int) Stereo_Linked, (int) Stereo_MidSide, settings.stereo_mode);
+    settings.low_cut_slope = juce::jlimit(0, 3, settings.low_cut_slope);
+    settings.high_cut_slope = juce::jlimit(0, 3, settings.high_cut_slope);
+    return true;
+}
+
+struct RenderJob
+{
+    juce::File input, output;
+    bool succeeded = false;
+    juce::String error;
+    double audio_seconds = 0, wall_seconds = 0;
+};
+
+static int pickBitDepth(juce::AudioFormat& format, const juce::AudioFormatReader& reader)
+{
+    auto depths = format.getPossibleBitDepths();
+    const auto wanted = reader.usesFloatingPointData ? 32 : (int) reader.bitsPerSample;
+
+    if (depths.contains(wanted))
+        return wanted;
+
+    return depths.isEmpty() ? 16 : depths.getLast();
+}
+
+static void render(RenderJob& job, const ChainSettings& settings, int block_size)
+{
+    juce::ScopedNoDenormals no_denormals;
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(job.input));
+
+    if (reader == nullptr)
+    {
+        job.error = "Unsupported or unreadable file";
+        return;
+    }
+
+    auto* format = formats.findFormatForFileExtension(job.output.getFileExtension());
+
+    if (format == nullptr)
+    {
+        job.error = "No writer for " + job.output.getFileExtension();
+        return;
+    }
+
+    const auto num_channels = (int) reader->numChannels;
+    const auto sample_rate = reader->sampleRate;
+
+    // Rendered next to the output and moved over it once complete, so a
+    // failed render never leaves a truncated file or loses an older one
+    juce::TemporaryFile temp(job.output);
+    auto stream = temp.getFile().createOutputStream();
+
+    if (stream == nullptr)
+    {
+        job.error = "Can't write " + temp.getFile().getFullPathName();
+        return;
+    }
+
+    std::unique_ptr<juce::AudioFormatWriter> writer(format->createWriterFor(stream.get(), sample_rate, (unsigned int) num_channels,
+                                                                            pickBitDepth(*format, *reader), reader->metadataValues, 0));
+
+    if (writer == nullptr)
+    {
+        job.error = "Can't create a writer for this channel count / sample rate";
+        return;
+    }
+
+    stream.release(); // the writer owns it now
+
+    FilterChain<float> chain;
+    chain.prepare(num_channels, block_size);
+
+    ChainCoefficients coefficients;
+    designChainCoefficients(settings, sample_rate, coefficients);
+    applyChainCoefficients(chain, coefficients);
+
+    juce::AudioBuffer<float> buffer(num_channels, block_size);
+
+    for (juce::int64 position = 0; position < reader->lengthInSamples; position += block_size)
+    {
+        const auto num_samples = (int) juce::jmin((juce::int64) block_size, reader->lengthInSamples - position);
+
+        reader->read(&buffer, 0, num_samples, position, true, true);
+        chain.process(buffer.getArrayOfWritePointers(), num_channels, num_samples);
+
+        if (! writer->writeFromAudioSampleBuffer(buffer, 0, num_samples))
+        {
+            job.error = "Write failed";
+            return;
+        }
+    }
+
+    // Flushes and closes the file
+    writer.reset();
+
+    if (! temp.overwriteTargetFileWithTemporary())
+    {
+        job.error = "Can't replace " + job.output.getFullPathName();
+        return;
+    }
+
+    job.audio_seconds = (double) reader->lengthInSamples / sample_rate;
+    job.wall_seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+    job.succeeded = true;
+}
+
+// <stem>_eq.<ext> next to the input or in output_dir. Two jobs never share
+// an output (a/kick.wav and b/kick.wav into one directory, or the same
+// input twice) and no output is an input, later ones get _eq_2, _eq_3...
+static void assignOutputFiles(std::vector<RenderJob>& jobs, const juce::File& output_dir)
+{
+    // Compared ignoring case, some file systems do
+    std::set<juce::String> used;
+
+    for (auto& job : jobs)
+        used.insert(job.input.getFullPathName().toLowerCase());
+
+    for (auto& job : jobs)
+    {
+        const auto directory = output_dir != juce::File() ? output_dir : job.input.getParentDirectory();
+        const auto stem = job.input.getFileNameWithoutExtension() + "_eq";
+
+        job.output = directory.getChildFile(stem + job.input.getFileExtension());
+
+        for (int suffix = 2; used.count(job.output.getFullPathName().toLowerCase()) != 0; ++suffix)
+            job.output = directory.getChildFile(stem + "_" + juce::String(suffix) + job.input.getFileExtension());
+
+        used.insert(job.output.getFullPathName().toLowerCase());
+    }
+}
+
+// Files are analysed in chunks of this long, so a single long file still
+// spreads over every core
+static constexpr double analysis_chunk_seconds = 20.0;
+
+struct AnalysisChunk
+{
+    juce::File file;
+    juce::int64 start = 0, length = 0;
+    std::unique_ptr<LongTermSpectrum> spectrum;
+    juce::String error;
+};
+
+static void analyse(AnalysisChunk& chunk, int block_size)
+{
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(chunk.file));
+
+    if (reader == nullptr)
+    {
+        chunk.error = "Unsupported or unreadable file";
+        return;
+    }
+
+    const auto num_channels = (int) reader->numChannels;
+    juce::AudioBuffer<float> buffer(num_channels, block_size);
+    chunk.spectrum = std::make_unique<LongTermSpectrum>(reader->sampleRate);
+
+    for (auto position = chunk.start; position < chunk.start + chunk.length; position += block_size)
+    {
+        const auto num_samples = (int) juce::jmin((juce::int64) block_size, chunk.start + chunk.length - position);
+
+        reader->read(&buffer, 0, num_samples, position, true, true);
+        chunk.spectrum->addSamples(buffer.getArrayOfReadPointers(), num_channels, num_samples);
+    }
+}
+
+// Long term spectrum of a set of files taken together, all at one sample rate
+static std::unique_ptr<LongTermSpectrum> analyseFiles(const juce::Array<juce::File>& files, int num_threads, int block_size,
+                                                      juce::String& error)
+{
+    juce::AudioFormatManager formats;
+    formats.registerBasicFormats();
+
+    std::vector<AnalysisChunk> chunks;
+    double sample_rate = 0;
+
+    for (auto& file : files)
+    {
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(file));
+
+        if (reader == nullptr)
+        {
+            error = file.getFullPathName() + ": Unsupported or unreadable file";
+            return {};
+        }
+
+        if (sample_rate == 0)
+            sample_rate = reader->sampleRate;
+
+        if (reader->sampleRate != sample_rate)
+        {
+            error = file.getFullPathName() + ": Sample rate differs from " + files.getFirst().getFileName();
+            return {};
+        }
+
+        const auto chunk_length = (juce::int64) (analysis_chunk_seconds * sample_rate);
+
+        for (juce::int64 start = 0; start < reader->lengthInSamples; start += chunk_length)
+        {
+            AnalysisChunk chunk;
+            chunk.file = file;
+            chunk.start = start;
+            chunk.length = juce::jmin(chunk_length, reader->lengthInSamples - start);
+            chunks.push_back(std::move(chunk));
+        }
+    }
+
+    WorkStealingScheduler scheduler(juce::jmin(num_threads, (int) chunks.size()));
+    scheduler.run((int) chunks.size(), [&](int index) { analyse(chunks[(size_t) index], block_size); });
+
+    auto spectrum = std::make_unique<LongTermSpectrum>(sample_rate);
+
+    for (auto& chunk : chunks)
+    {
+        if (chunk.spectrum == nullptr)
+        {
+            error = chunk.file.getFullPathName() + ": " + chunk.error;
+            return {};
+        }
+
+        spectrum->merge(*chunk.spectrum);
+    }
+
+    if (spectrum->getNumFrames() == 0)
+    {
+        error = "Too little audio to analyse in " + files.getFirst().getFullPathName();
+        return {};
+    }
+
+    return spectrum;
+}
+
+// The fitted parameters in loadPreset's format. Only the fitted bands are
+// enabled, the others are written disabled so the preset says it all.
+static juce::String makePreset(const ChainSettings& settings)
+{
+    auto* json = new juce::DynamicObject();
+    juce::var preset(json);
+
+    json->setProperty("LowCut Freq", settings.low_cut_freq);
+    json->setProperty("LowCut Slope", settings.low_cut_slope);
+    json->setProperty("HiCut Freq", settings.high_cut_freq);
+    json->setProperty("HiCut Slope", settings.high_cut_slope);
+
+    for (int band = 0; band < max_bands; ++band)
+    {
+        const auto i = (size_t) band;
+        json->setProperty(getBandParameterID(band, "Enabled"), settings.band_enabled[i]);
+
+        if (! settings.band_enabled[i])
+            continue;
+
+        json->setProperty(getBandParameterID(band, "Freq"), settings.band_freq[i]);
+        json->setProperty(getBandParameterID(band, "Gain"), settings.band_gain_db[i]);
+        json->setProperty(getBandParameterID(band, "Q"), settings.band_q[i]);
+        json->setProperty(getBandParameterID(band, "Type"), settings.band_type[i]);
+    }
+
+    return juce::JSON::toString(preset);
+}
+
+static int matchReference(const juce::File& reference_file, const juce::Array<juce::File>& sources, const juce::File& preset_file,
+                          int num_peaks, int num_threads, int block_size)
+{
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+    juce::String error;
+
+    auto reference = analyseFiles({ reference_file }, num_threads, block_size, error);
+    std::unique_ptr<LongTermSpectrum> source;
+
+    if (reference != nullptr)
+        source = analyseFiles(sources, num_threads, block_size, error);
+
+    if (source == nullptr)
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    const auto analysis_seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+    // The calling thread scores candidates too
+    ChannelWorkerPool pool(num_threads - 1);
+    ReferenceMatcher::Options options;
+    options.num_peaks = num_peaks;
+
+    ReferenceMatcher matcher;
+    const auto result = matcher.fit(*source, *reference, options, &pool);
+    const auto preset = makePreset(result.settings);
+
+    std::cout << "Analysed in " << juce::String(analysis_seconds, 2) << " s, fitted in "
+              << juce::String((juce::Time::getMillisecondCounterHiRes() - start) / 1000.0 - analysis_seconds, 2) << " s ("
+              << result.iterations << " steps). Difference " << juce::String(result.target_rms_db, 2) << " dB rms, "
+              << juce::String(result.residual_rms_db, 2) << " dB rms after the EQ" << std::endl;
+
+    if (preset_file == juce::File())
+    {
+        std::cout << preset << std::endl;
+    }
+    else if (! preset_file.replaceWithText(preset))
+    {
+        std::cerr << "Can't write " << preset_file.getFullPathName() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+static void printUsage()
+{
+    std::cout << "Usage: BatchRenderer --preset settings.json [--output-dir dir] [--block-size n] [--threads n] files..." << std::endl
+              << "       BatchRenderer --match-reference reference.wav [--write-preset matched.json] [--peaks n] [--threads n] files..."
+              << std::endl;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::File preset_file, output_dir, reference_file, matched_preset_file;
+    int block_size = 65536;
+    int num_peaks = default_num_bands;
+    int num_threads = juce::SystemStats::getNumCpus();
+    juce::StringArray inputs;
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg(argv[i]);
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--preset" && has_value)                preset_file = cwd.getChildFile(argv[++i]);
+        else if (arg == "--output-dir" && has_value)       output_dir = cwd.getChildFile(argv[++i]);
+        else if (arg == "--block-size" && has_value)       block_size = juce::jmax(64, juce::String(argv[++i]).getIntValue());
+        else if (arg == "--threads" && has_value)          num_threads = juce::jmax(1, juce::String(argv[++i]).getIntValue());
+        else if (arg == "--match-reference" && has_value)  reference_file = cwd.getChildFile(argv[++i]);
+        else if (arg == "--write-preset" && has_value)     matched_preset_file = cwd.getChildFile(argv[++i]);
+        else if (arg == "--peaks" && has_value)            num_peaks = juce::jlimit(0, max_bands, juce::String(argv[++i]).getIntValue());
+        else if (arg.startsWith("-"))                      { printUsage(); return 1; }
+        else                                               inputs.add(arg);
+    }
+
+    if (reference_file != juce::File() && ! inputs.isEmpty())
+    {
+        juce::Array<juce::File> sources;
+
+        for (auto& input : inputs)
+            sources.add(cwd.getChildFile(input));
+
+        return matchReference(reference_file, sources, matched_preset_file, num_peaks, num_threads, block_size);
+    }
+
+    if (! preset_file.existsAsFile() || inputs.isEmpty())
+    {
+        printUsage();
+        return 1;
+    }
+
+    // Same defaults as ParametricEQAudioProcessor::createParameterLayout
+    ChainSettings settings;
+    juce::String error;
+
+    if (! loadPreset(preset_file, settings, error))
+    {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    if (output_dir != juce::File())
+        output_dir.createDirectory();
+
+    std::vector<RenderJob> jobs(inputs.size());
+
+    for (int i = 0; i < inputs.size(); ++i)
+        jobs[(size_t) i].input = cwd.getChildFile(inputs[i]);
+
+    assignOutputFiles(jobs, output_dir);
+
+    std::cout << "Rendering " << jobs.size() << " file(s) on " << num_threads << " thread(s), "
+              << getBestCascadeKernels<float>().name << " kernels" << std::endl;
+
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+
+    WorkStealingScheduler scheduler(juce::jmin(num_threads, (int) jobs.size()));
+    scheduler.run((int) jobs.size(), [&](int index) { render(jobs[(size_t) index], settings, block_size); });
+
+    const auto wall_seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+    double total_audio_seconds = 0;
+    int failures = 0;
+
+    for (auto& job : jobs)
+    {
+        if (job.succeeded)
+        {
+            total_audio_seconds += job.audio_seconds;
+            std::cout << job.output.getFullPathName() << "  "
+                      << juce::String(job.audio_seconds / juce::jmax(job.wall_seconds, 1.0e-9), 1) << "x realtime" << std::endl;
+        }
+        else
+        {
+            ++failures;
+            std::cerr << job.input.getFullPathName() << ": " << job.error << std::endl;
+        }
+    }
+
+    std::cout << "Rendered " << juce::String(total_audio_seconds, 1) << " s of audio in " << juce::String(wall_seconds, 2) << " s, "
+              << juce::String(total_audio_seconds / juce::jmax(wall_seconds, 1.0e-9), 1) << "x realtime" << std::endl;
+
+    return failures == 0 ? 0 : 1;
+}
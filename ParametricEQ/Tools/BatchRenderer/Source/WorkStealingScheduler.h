@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    WorkStealingScheduler.h
+
+    Runs a fixed list of jobs on one thread per core. Jobs are dealt out
+    round robin up front; each thread works through its own queue from the
+    back and, once that is empty, steals from the front of the others, so
+    a few long files don't leave the other cores idle.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include <deque>
+
+class WorkStealingScheduler
+{
+public:
+    using Job = std::function<void(int job_index)>;
+
+    explicit WorkStealingScheduler(int num_threads_to_use)
+        : num_threads(juce::jmax(1, num_threads_to_use))
+    {
+    }
+
+    // Blocks until every job has run
+    void run(int num_jobs, Job job)
+    {
+        juce::OwnedArray<Queue> queues;
+
+        for (int i = 0; i < num_threads; ++i)
+            queues.add(new Queue());
+
+        for (int i = 0; i < num_jobs; ++i)
+            queues[i % num_threads]->jobs.push_back(i);
+
+        juce::OwnedArray<Worker> workers;
+
+        for (int i = 0; i < num_threads; ++i)
+            workers.add(new Worker(i, queues, job));
+
+        for (auto* worker : workers)
+            worker->startThread();
+
+        for (auto* worker : workers)
+            worker->waitForThreadToExit(-1);
+    }
+
+private:
+    struct Queue
+    {
+        juce::SpinLock lock;
+        std::deque<int> jobs;
+    };
+
+    class Worker : public juce::Thread
+    {
+    public:
+        Worker(int worker_index, juce::OwnedArray<Queue>& all_queues, Job& job_to_run)
+            : juce::Thread("Batch Worker " + juce::String(worker_index)),
+              index(worker_index), queues(all_queues), job(job_to_run)
+        {
+        }
+
+    private:
+        void run() override
+        {
+            int next;
+
+            while (popOwn(next) || steal(next))
+                job(next);
+        }
+
+        bool popOwn(int& next)
+        {
+            auto& own = *queues[index];
+            const juce::SpinLock::ScopedLockType sl(own.lock);
+
+            if (own.jobs.empty())
+                return false;
+
+            next = own.jobs.back();
+            own.jobs.pop_back();
+            return true;
+        }
+
+        bool steal(int& next)
+        {
+            for (int offset = 1; offset < queues.size(); ++offset)
+            {
+                auto& victim = *queues[(index + offset) % queues.size()];
+                const juce::SpinLock::ScopedLockType sl(victim.lock);
+
+                if (! victim.jobs.empty())
+                {
+                    next = victim.jobs.front();
+                    victim.jobs.pop_front();
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        const int index;
+        juce::OwnedArray<Queue>& queues;
+        Job& job;
+    };
+
+    const int num_threads;
+};
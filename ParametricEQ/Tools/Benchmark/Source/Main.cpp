@@ -0,0 +1,599 @@
+/*
+  ==============================================================================
+
+    ParametricEQ benchmark. Drives ParametricEQAudioProcessor through
+    prepareToPlay / processBlock like a host would and times it across
+    block sizes, sample rates, every cut slope combination and with static
+    or continuously automated parameters. The coefficient design stage
+    (what updateFilters() used to do every block) is timed on its own, and
+    so is EqEngine with many independent mono streams, and the matched high
+    frequency designs against running the chain oversampled.
+
+    Benchmark [--quick] [--channels n] [--bands n] [--dynamic]
+              [--precision float|mixed|double] [--stereo linked|lr|ms]
+              [--smoothing n] [--offline] [--realtime-check]
+              [--output results.json] [--verify]
+
+    --bands sets how many EQ bands are switched on (3 by default, up to 24),
+    so the cost of the bands actually in use can be tracked. --dynamic makes
+    them dynamic bands with a threshold the test noise keeps crossing.
+    --stereo picks the stereo mode, outside linked the bands take turns
+    running on both channels, the first and the second. --smoothing n turns
+    on control rate smoothing with n sample sub-blocks (off by default, as
+    in the plugin).
+
+    Static and automated scenarios run as a live host would, with designs
+    on the design thread and the realtime checks on. --offline adds
+    automated runs in non-realtime mode, where redesigns happen in place
+    on the processing thread as in a bounce.
+
+    Results are written as JSON so runs can be compared between releases.
+    Built with PARAMETRIC_EQ_INSTRUMENTATION=1, every scenario also reports
+    heap and lock activity on the processing thread, and --realtime-check
+    aborts on the first one.
+
+    --verify runs the correctness checks in Verify.h instead and exits
+    non-zero if any fail.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "../../../Source/PluginProcessor.h"
+#include "../../../Source/EqEngine.h"
+#include "Verify.h"
+
+#if JUCE_INTEL
+ #if JUCE_MSVC
+  #include <intrin.h>
+ #else
+  #include <x86intrin.h>
+ #endif
+#endif
+
+// Cycle counter where the CPU has a cheap one, otherwise derived from time
+static double readCycles() noexcept
+{
+   #if JUCE_INTEL
+    return (double) __rdtsc();
+   #else
+    return juce::Time::getHighResolutionTicks() * (juce::SystemStats::getCpuSpeedInMegahertz() * 1.0e6)
+             / (double) juce::Time::getHighResolutionTicksPerSecond();
+   #endif
+}
+
+static double readNanoseconds() noexcept
+{
+    return juce::Time::getHighResolutionTicks() * 1.0e9 / (double) juce::Time::getHighResolutionTicksPerSecond();
+}
+
+struct Timing
+{
+    double ns_per_sample = 0, cycles_per_sample = 0;
+    juce::uint64 allocations = 0, locks = 0;
+};
+
+static void setParameter(ParametricEQAudioProcessor& processor, const juce::String& parameter_id, float value)
+{
+    auto* parameter = processor.apvts.getParameter(parameter_id);
+    parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+}
+
+enum class Precision { Float, Mixed, Double };
+
+static Precision parsePrecision(const juce::String& name)
+{
+    if (name == "double") return Precision::Double;
+    if (name == "mixed")  return Precision::Mixed;
+    
+    return Precision::Float;
+}
+
+static int parseStereoMode(const juce::String& name)
+{
+    if (name == "lr") return Stereo_LeftRight;
+    if (name == "ms") return Stereo_MidSide;
+    
+    return Stereo_Linked;
+}
+
+struct Scenario
+{
+    int block_size;
+    double sample_rate;
+    int low_cut_slope, high_cut_slope;
+    bool automated;
+    bool offline;
+};
+
+// Settings shared by every scenario of a run, from the command line
+struct RunOptions
+{
+    Precision precision = Precision::Float;
+    int num_channels = 2;
+    int num_bands = default_num_bands;
+    bool dynamic = false;
+    int stereo_mode = Stereo_Linked;
+    int smoothing_sub_block = 0;
+    bool offline = false;
+    int samples_per_run = 1 << 17;
+    int repetitions = 5;
+};
+
+template <typename SampleType>
+static Timing runScenario(const Scenario& scenario, const RunOptions& options)
+{
+    const auto num_channels = options.num_channels;
+    const auto num_bands = options.num_bands;
+    ParametricEQAudioProcessor processor;
+    processor.setProcessingPrecision(std::is_same<SampleType, double>::value ? juce::AudioProcessor::doublePrecision
+                                                                              : juce::AudioProcessor::singlePrecision);
+    processor.setMixedPrecision(options.precision == Precision::Mixed);
+    processor.setSmoothingSubBlockSize(options.smoothing_sub_block);
+    
+    const auto layout = juce::AudioChannelSet::canonicalChannelSet(num_channels);
+    juce::AudioProcessor::BusesLayout buses;
+    buses.inputBuses.add(layout);
+    buses.inputBuses.add(juce::AudioChannelSet::disabled());   // Sidechain
+    buses.outputBuses.add(layout);
+    processor.setBusesLayout(buses);
+    
+    // Offline runs design in place on the processing thread, so the
+    // redesign cost is part of the measurement rather than hidden on the
+    // design thread. Realtime checks only apply to live runs.
+    processor.setNonRealtime(scenario.offline);
+    
+    // Time the fused chain as it ships, not the band by band passes
+    processor.getInstrumentation().setStageTiming(false);
+    
+    setParameter(processor, "LowCut Freq", 80.f);
+    setParameter(processor, "HiCut Freq", 12000.f);
+    // The first three keep the gains earlier results were measured with
+    static constexpr float band_gains[] = { 3.f, -4.5f, 2.f };
+    
+    for (int band = 0; band < max_bands; ++band)
+    {
+        setParameter(processor, getBandParameterID(band, "Enabled"), band < num_bands ? 1.f : 0.f);
+        setParameter(processor, getBandParameterID(band, "Gain"), band < num_bands ? band_gains[band % 3] : 0.f);
+        setParameter(processor, getBandParameterID(band, "Dynamic"), band < num_bands && options.dynamic ? 1.f : 0.f);
+        setParameter(processor, getBandParameterID(band, "Threshold"), -30.f);
+        setParameter(processor, getBandParameterID(band, "Placement"), (float) (band % 3));
+    }
+    
+    setParameter(processor, "Stereo Mode", (float) options.stereo_mode);
+    
+    setParameter(processor, "LowCut Slope", (float) scenario.low_cut_slope);
+    setParameter(processor, "HiCut Slope", (float) scenario.high_cut_slope);
+    
+    processor.prepareToPlay(scenario.sample_rate, scenario.block_size);
+    
+    juce::AudioBuffer<SampleType> buffer(num_channels, scenario.block_size);
+    juce::MidiBuffer midi;
+    juce::Random random(1);
+    
+    auto fill = [&]
+    {
+        for (int ch = 0; ch < num_channels; ++ch)
+            for (int i = 0; i < scenario.block_size; ++i)
+                buffer.setSample(ch, i, (SampleType) (random.nextFloat() * 2.f - 1.f));
+    };
+    
+    const auto num_blocks = juce::jmax(1, options.samples_per_run / scenario.block_size);
+    Timing best { std::numeric_limits<double>::max(), std::numeric_limits<double>::max() };
+    float sweep = 0.f;
+    
+    for (int repetition = 0; repetition <= options.repetitions; ++repetition)
+    {
+        double ns = 0, cycles = 0;
+        
+        for (int block = 0; block < num_blocks; ++block)
+        {
+            fill();
+            
+            // Host automation: a peak sweep and a cut frequency moving every block
+            if (scenario.automated)
+            {
+                sweep = std::fmod(sweep + 0.01f, 1.f);
+                setParameter(processor, "Peak2 Freq", 200.f + 4000.f * sweep);
+                setParameter(processor, "LowCut Freq", 30.f + 200.f * sweep);
+            }
+            
+            const auto start_ns = readNanoseconds();
+            const auto start_cycles = readCycles();
+            
+            processor.processBlock(buffer, midi);
+            
+            cycles += readCycles() - start_cycles;
+            ns += readNanoseconds() - start_ns;
+        }
+        
+        // First pass only warms up caches and the design thread
+        if (repetition == 0)
+            continue;
+        
+        const auto num_samples = (double) num_blocks * scenario.block_size;
+        best.ns_per_sample = juce::jmin(best.ns_per_sample, ns / num_samples);
+        best.cycles_per_sample = juce::jmin(best.cycles_per_sample, cycles / num_samples);
+    }
+    
+    const auto instrumentation = processor.getInstrumentation().getSnapshot();
+    best.allocations = instrumentation.allocations;
+    best.locks = instrumentation.locks;
+    
+    processor.releaseResources();
+    return best;
+}
+
+// The full design a parameter change costs: read the settings, design every band, load the chain
+static juce::var timeDesign(int iterations)
+{
+    ParametricEQAudioProcessor processor;
+    FilterChain<float> chain;
+    ChainCoefficients coefficients;
+    chain.prepare(2, 512);
+    
+    CoefficientCache cache;
+    double read_ns = 0, design_ns = 0, cached_ns = 0, apply_ns = 0;
+    ChainSettings settings;
+    
+    for (int i = 0; i < iterations; ++i)
+    {
+        auto start = readNanoseconds();
+        settings = getChainSettings(processor.apvts);
+        read_ns += readNanoseconds() - start;
+        
+        settings.band_freq[0] = 200.f + (float) (i % 1000);
+        settings.low_cut_slope = i % 4;
+        settings.high_cut_slope = (i / 4) % 4;
+        
+        start = readNanoseconds();
+        designChainCoefficients(settings, 48000.0, coefficients);
+        design_ns += readNanoseconds() - start;
+        
+        // Same sweep again through the cache, mostly hits after the first pass
+        start = readNanoseconds();
+        designChainCoefficients(settings, 48000.0, coefficients, all_bands, &cache);
+        cached_ns += readNanoseconds() - start;
+        
+        start = readNanoseconds();
+        applyChainCoefficients(chain, coefficients);
+        apply_ns += readNanoseconds() - start;
+    }
+    
+    auto* result = new juce::DynamicObject();
+    result->setProperty("iterations", iterations);
+    result->setProperty("read_settings_ns", read_ns / iterations);
+    result->setProperty("design_all_bands_ns", design_ns / iterations);
+    result->setProperty("design_all_bands_cached_ns", cached_ns / iterations);
+    result->setProperty("cache_hit_rate", (double) cache.getStats().hits / juce::jmax((juce::uint64) 1, cache.getStats().hits + cache.getStats().misses));
+    result->setProperty("apply_to_chain_ns", apply_ns / iterations);
+    result->setProperty("update_filters_equivalent_ns", (read_ns + design_ns + apply_ns) / iterations);
+    return juce::var(result);
+}
+
+// Many unrelated mono streams, each with its own settings: one FilterChain
+// per stream against EqEngine packing them into lanes
+static juce::var timeEngine(int num_streams, int block_size, int num_blocks)
+{
+    juce::Random random(1);
+    std::vector<ChainSettings> settings((size_t) num_streams);
+    
+    for (auto& s : settings)
+    {
+        s.low_cut_freq = 40.f + 100.f * random.nextFloat();
+        s.low_cut_slope = random.nextInt(4);
+        s.high_cut_freq = 6000.f + 10000.f * random.nextFloat();
+        
+        for (int band = 0; band < default_num_bands; ++band)
+            s.band_gain_db[(size_t) band] = 12.f * random.nextFloat() - 6.f;
+    }
+    
+    juce::AudioBuffer<float> buffer(num_streams, block_size);
+    
+    auto fill = [&]
+    {
+        for (int stream = 0; stream < num_streams; ++stream)
+            for (int i = 0; i < block_size; ++i)
+                buffer.setSample(stream, i, random.nextFloat() * 2.f - 1.f);
+    };
+    
+    auto time = [&](auto&& process)
+    {
+        double ns = 0;
+        
+        for (int block = 0; block < num_blocks; ++block)
+        {
+            fill();
+            const auto start = readNanoseconds();
+            process();
+            ns += readNanoseconds() - start;
+        }
+        
+        return ns / ((double) num_blocks * block_size * num_streams);
+    };
+    
+    std::vector<std::unique_ptr<FilterChain<float>>> chains;
+    ChainCoefficients coefficients;
+    
+    for (auto& s : settings)
+    {
+        chains.push_back(std::make_unique<FilterChain<float>>());
+        chains.back()->prepare(1, block_size);
+        designChainCoefficients(s, 48000.0, coefficients);
+        applyChainCoefficients(*chains.back(), coefficients);
+    }
+    
+    const auto chains_ns = time([&]
+    {
+        for (int stream = 0; stream < num_streams; ++stream)
+        {
+            auto* channel = buffer.getWritePointer(stream);
+            chains[(size_t) stream]->process(&channel, 1, block_size);
+        }
+    });
+    
+    EqEngine<float> engine;
+    engine.prepare(48000.0, num_streams, block_size);
+    
+    for (auto& s : settings)
+        engine.addStream(s);
+    
+    const auto engine_ns = time([&] { engine.process(buffer.getArrayOfWritePointers(), block_size); });
+    
+    ChannelWorkerPool pool(juce::jmax(1, juce::SystemStats::getNumCpus() - 1));
+    engine.setWorkerPool(&pool);
+    const auto pooled_ns = time([&] { engine.process(buffer.getArrayOfWritePointers(), block_size); });
+    
+    auto* result = new juce::DynamicObject();
+    result->setProperty("streams", num_streams);
+    result->setProperty("block_size", block_size);
+    result->setProperty("kernels", engine.getInstructionSetName());
+    result->setProperty("filter_chain_per_stream_ns", chains_ns);
+    result->setProperty("engine_ns", engine_ns);
+    result->setProperty("engine_pooled_ns", pooled_ns);
+    result->setProperty("per_sample_means", "per sample, per stream");
+    return juce::var(result);
+}
+
+// Worst deviation in dB of the designed peaks and high cut from their analog
+// prototypes between 20 Hz and 20 kHz
+static double getAnalogError(const ChainSettings& settings, const ChainCoefficients& coefficients, double sample_rate)
+{
+    double worst = 0;
+    
+    for (double freq = 20.0; freq <= 20000.0; freq *= 1.01)
+    {
+        const auto z = std::polar(1.0, -juce::MathConstants<double>::twoPi * freq / sample_rate);
+        std::complex<double> digital(1.0);
+        
+        forEachActiveSection(coefficients, [&](const BiquadCoefficients<double>& c)
+        {
+            digital *= (c.b0 + z * (c.b1 + z * c.b2)) / (1.0 + z * (c.a1 + z * c.a2));
+        });
+        
+        // RBJ peaks, (s^2 + s a / q + 1) / (s^2 + s / (a q) + 1), and an order n Butterworth low pass
+        auto analog_db = 0.0;
+        
+        for (int band = 0; band < max_bands; ++band)
+        {
+            if (isBandNeutral(settings, getBandPosition(band)))
+                continue;
+            
+            const auto a = std::pow(10.0, settings.band_gain_db[(size_t) band] / 40.0);
+            const auto q = (double) settings.band_q[(size_t) band];
+            const std::complex<double> s(0.0, freq / settings.band_freq[(size_t) band]);
+            analog_db += 20.0 * std::log10(std::abs((s * s + s * (a / q) + 1.0) / (s * s + s / (a * q) + 1.0)));
+        }
+        
+        if (! isBandNeutral(settings, HiCut))
+        {
+            const auto order = 2.0 * getNumCutSections(settings.high_cut_slope);
+            analog_db -= 10.0 * std::log10(1.0 + std::pow(freq / settings.high_cut_freq, 2.0 * order));
+        }
+        
+        worst = juce::jmax(worst, std::abs(20.0 * std::log10(std::abs(digital)) - analog_db));
+    }
+    
+    return worst;
+}
+
+// High bands at 48 kHz: bilinear and matched designs at the base rate against
+// bilinear designs run 2x and 4x oversampled through juce::dsp::Oversampling
+static juce::var timeHighFrequencyDesigns(int block_size, int num_blocks)
+{
+    const auto sample_rate = 48000.0;
+    ChainSettings settings;
+    settings.band_freq[0] = 16000.f;
+    settings.band_gain_db[0] = 6.f;
+    settings.band_freq[1] = 10000.f;
+    settings.band_gain_db[1] = -4.f;
+    settings.band_q[1] = 2.f;
+    settings.high_cut_freq = 18000.f;
+    settings.high_cut_slope = Slope_24;
+    
+    juce::AudioBuffer<float> buffer(2, block_size);
+    juce::Random random(1);
+    juce::Array<juce::var> results;
+    
+    auto run = [&](const char* name, int method, int oversampling_order)
+    {
+        const auto factor = 1 << oversampling_order;
+        const auto rate = sample_rate * factor;
+        
+        std::unique_ptr<juce::dsp::Oversampling<float>> oversampling;
+        
+        if (oversampling_order > 0)
+        {
+            oversampling = std::make_unique<juce::dsp::Oversampling<float>>(2, oversampling_order, juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR, true);
+            oversampling->initProcessing((size_t) block_size);
+        }
+        
+        auto chain_settings = settings;
+        chain_settings.design_method = method;
+        ChainCoefficients coefficients;
+        designChainCoefficients(chain_settings, rate, coefficients);
+        
+        FilterChain<float> chain;
+        chain.prepare(2, block_size * factor);
+        applyChainCoefficients(chain, coefficients);
+        
+        double ns = 0;
+        
+        for (int block = 0; block < num_blocks; ++block)
+        {
+            for (int ch = 0; ch < 2; ++ch)
+                for (int i = 0; i < block_size; ++i)
+                    buffer.setSample(ch, i, random.nextFloat() * 2.f - 1.f);
+            
+            const auto start = readNanoseconds();
+            
+            if (oversampling != nullptr)
+            {
+                juce::dsp::AudioBlock<float> audio_block(buffer);
+                auto up = oversampling->processSamplesUp(audio_block);
+                float* channels[] = { up.getChannelPointer(0), up.getChannelPointer(1) };
+                chain.process(channels, 2, (int) up.getNumSamples());
+                oversampling->processSamplesDown(audio_block);
+            }
+            else
+            {
+                chain.process(buffer.getArrayOfWritePointers(), 2, block_size);
+            }
+            
+            ns += readNanoseconds() - start;
+        }
+        
+        auto* result = new juce::DynamicObject();
+        result->setProperty("variant", name);
+        result->setProperty("ns_per_sample", ns / ((double) num_blocks * block_size));
+        result->setProperty("max_error_db", getAnalogError(chain_settings, coefficients, rate));
+        result->setProperty("latency_samples", oversampling != nullptr ? (double) oversampling->getLatencyInSamples() : 0.0);
+        results.add(juce::var(result));
+    };
+    
+    run("bilinear", Design_Bilinear, 0);
+    run("matched", Design_Matched, 0);
+    run("bilinear_2x", Design_Bilinear, 1);
+    run("bilinear_4x", Design_Bilinear, 2);
+    
+    // The error excludes the oversampling filters' own ripple and droop
+    return juce::var(results);
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI juce_initialiser;
+    
+    bool quick = false, verify = false;
+    RunOptions options;
+    juce::File output;
+    
+    for (int i = 1; i < argc; ++i)
+    {
+        const juce::String arg(argv[i]);
+        
+        if (arg == "--quick")                          quick = true;
+        else if (arg == "--channels" && i + 1 < argc)  options.num_channels = juce::jlimit(1, ParametricEQAudioProcessor::max_channels, juce::String(argv[++i]).getIntValue());
+        else if (arg == "--bands" && i + 1 < argc)     options.num_bands = juce::jlimit(0, max_bands, juce::String(argv[++i]).getIntValue());
+        else if (arg == "--dynamic")                   options.dynamic = true;
+        else if (arg == "--precision" && i + 1 < argc) options.precision = parsePrecision(argv[++i]);
+        else if (arg == "--stereo" && i + 1 < argc)    options.stereo_mode = parseStereoMode(argv[++i]);
+        else if (arg == "--smoothing" && i + 1 < argc) options.smoothing_sub_block = juce::jmax(0, juce::String(argv[++i]).getIntValue());
+        else if (arg == "--offline")                   options.offline = true;
+        else if (arg == "--realtime-check")            RealtimeMonitor::setFailOnViolation(true);
+        else if (arg == "--output" && i + 1 < argc)    output = juce::File::getCurrentWorkingDirectory().getChildFile(argv[++i]);
+        else if (arg == "--verify")                    verify = true;
+        else
+        {
+            std::cout << "Usage: Benchmark [--quick] [--channels n] [--bands n] [--dynamic] [--precision float|mixed|double] [--stereo linked|lr|ms] [--smoothing n] [--offline] [--realtime-check] [--output results.json] [--verify]" << std::endl;
+            return 1;
+        }
+    }
+    
+    if (RealtimeMonitor::isFailingOnViolation() && ! instrumentation_enabled)
+    {
+        std::cout << "--realtime-check needs a build with PARAMETRIC_EQ_INSTRUMENTATION=1" << std::endl;
+        return 1;
+    }
+    
+    if (verify)
+        return runVerification() == 0 ? 0 : 1;
+    
+    const juce::Array<int> block_sizes = quick ? juce::Array<int> { 32, 512, 4096 }
+                                               : juce::Array<int> { 16, 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+    const juce::Array<double> sample_rates = quick ? juce::Array<double> { 48000.0, 192000.0 }
+                                                   : juce::Array<double> { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0, 352800.0, 384000.0 };
+    const auto precision = options.precision;
+    options.samples_per_run = quick ? 1 << 15 : 1 << 17;
+    options.repetitions = quick ? 2 : 5;
+    
+    juce::Array<juce::var> results;
+    
+    for (auto sample_rate : sample_rates)
+    {
+        for (auto block_size : block_sizes)
+        {
+            for (int slopes = 0; slopes < 16; ++slopes)
+            {
+                // Static, automated, then automated offline if asked for
+                for (int mode = 0; mode < (options.offline ? 3 : 2); ++mode)
+                {
+                    const auto automated = mode > 0;
+                    const Scenario scenario { block_size, sample_rate, slopes % 4, slopes / 4, automated, mode == 2 };
+                    const auto timing = precision == Precision::Double ? runScenario<double>(scenario, options)
+                                                                       : runScenario<float>(scenario, options);
+                    
+                    auto* result = new juce::DynamicObject();
+                    result->setProperty("block_size", block_size);
+                    result->setProperty("sample_rate", sample_rate);
+                    result->setProperty("low_cut_slope", scenario.low_cut_slope);
+                    result->setProperty("high_cut_slope", scenario.high_cut_slope);
+                    result->setProperty("automated", automated);
+                    result->setProperty("offline", scenario.offline);
+                    result->setProperty("ns_per_sample", timing.ns_per_sample);
+                    result->setProperty("cycles_per_sample", timing.cycles_per_sample);
+                    
+                    if (instrumentation_enabled)
+                    {
+                        result->setProperty("allocations", (juce::int64) timing.allocations);
+                        result->setProperty("locks", (juce::int64) timing.locks);
+                    }
+                    
+                    results.add(juce::var(result));
+                }
+            }
+            
+            std::cerr << "." << std::flush;
+        }
+    }
+    
+    std::cerr << std::endl;
+    
+    auto* root = new juce::DynamicObject();
+    root->setProperty("format_version", 1);
+    root->setProperty("cpu", juce::SystemStats::getCpuModel());
+    root->setProperty("cpu_mhz", juce::SystemStats::getCpuSpeedInMegahertz());
+    root->setProperty("kernels", precision == Precision::Double ? getBestCascadeKernels<double>().name : getBestCascadeKernels<float>().name);
+    root->setProperty("channels", options.num_channels);
+    root->setProperty("bands", options.num_bands);
+    root->setProperty("dynamic", options.dynamic);
+    root->setProperty("stereo_mode", juce::StringArray { "linked", "lr", "ms" }[options.stereo_mode]);
+    root->setProperty("instrumentation", instrumentation_enabled);
+    root->setProperty("precision", precision == Precision::Double ? "double" : precision == Precision::Mixed ? "mixed" : "float");
+    root->setProperty("smoothing_sub_block", options.smoothing_sub_block);
+    root->setProperty("per_sample_means", "per sample frame, all channels");
+    root->setProperty("design", timeDesign(quick ? 10000 : 100000));
+    root->setProperty("engine", timeEngine(256, 512, quick ? 50 : 500));
+    root->setProperty("high_frequency_designs", timeHighFrequencyDesigns(512, quick ? 500 : 5000));
+    root->setProperty("process", results);
+    
+    const auto json = juce::JSON::toString(juce::var(root));
+    
+    if (output != juce::File())
+        output.replaceWithText(json);
+    else
+        std::cout << json << std::endl;
+    
+    return 0;
+}
@@ -0,0 +1,570 @@
+/*
+  ==============================================================================
+
+    Verify.cpp
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "Verify.h"
+#include "../../../Source/FilterChain.h"
+#include "../../../Source/LinearPhaseConvolver.h"
+
+struct Results
+{
+    // A NaN error fails too
+    void check(const juce::String& name, double error, double tolerance)
+    {
+        const auto passed = error <= tolerance;
+        
+        if (! passed)
+            ++failures;
+        
+        std::cout << (passed ? "ok      " : "FAILED  ") << name << "  (error " << error << ", tolerance " << tolerance << ")" << std::endl;
+    }
+    
+    int failures = 0;
+};
+
+// The larger of two errors, NaN if either is (juce::jmax would drop a NaN second argument)
+static double getWorse(double a, double b)
+{
+    return std::isnan(a) || std::isnan(b) ? std::numeric_limits<double>::quiet_NaN() : juce::jmax(a, b);
+}
+
+static std::vector<std::vector<double>> makeNoise(juce::Random& random, int num_channels, int num_samples)
+{
+    std::vector<std::vector<double>> channels((size_t) num_channels, std::vector<double>((size_t) num_samples));
+    
+    for (auto& channel : channels)
+        for (auto& sample : channel)
+            sample = random.nextDouble() * 2.0 - 1.0;
+    
+    return channels;
+}
+
+// Largest difference relative to the reference's peak
+template <typename SampleType>
+static double getError(const std::vector<std::vector<SampleType>>& output, const std::vector<std::vector<SampleType>>& reference)
+{
+    double error = 0, peak = 1.0e-30;
+    
+    for (size_t ch = 0; ch < reference.size(); ++ch)
+    {
+        for (size_t i = 0; i < reference[ch].size(); ++i)
+        {
+            const auto difference = std::abs((double) output[ch][i] - (double) reference[ch][i]);
+            
+            if (! std::isfinite(difference))
+                return std::numeric_limits<double>::quiet_NaN();
+            
+            error = juce::jmax(error, difference);
+            peak = juce::jmax(peak, std::abs((double) reference[ch][i]));
+        }
+    }
+    
+    return error / peak;
+}
+
+template <typename SampleType>
+static std::vector<SampleType*> getPointers(std::vector<std::vector<SampleType>>& channels)
+{
+    std::vector<SampleType*> pointers;
+    
+    for (auto& channel : channels)
+        pointers.push_back(channel.data());
+    
+    return pointers;
+}
+
+// Both cuts at 48 dB/Oct and a band of random shape in every other section
+static std::array<BiquadCoefficients<double>, num_chain_sections> makeTestSections(juce::Random& random, double sample_rate)
+{
+    std::array<BiquadCoefficients<double>, num_chain_sections> sections;
+    CutCoefficients<double> cut;
+    
+    makeLowCutCoefficients(cut, sample_rate, 60.0, Slope_48);
+    std::copy(cut.begin(), cut.end(), sections.begin() + low_cut_section);
+    
+    makeHighCutCoefficients(cut, sample_rate, 15000.0, Slope_48);
+    std::copy(cut.begin(), cut.end(), sections.begin() + high_cut_section);
+    
+    for (int band = 0; band < max_bands; ++band)
+        makeBandCoefficients(sections[(size_t) (band_section + band)], random.nextInt(num_band_types), sample_rate,
+                             40.0 * std::pow(400.0, random.nextDouble()), 0.3 + 4.0 * random.nextDouble(),
+                             24.0 * random.nextDouble() - 12.0, random.nextBool() ? Design_Matched : Design_Bilinear);
+    
+    return sections;
+}
+
+// num_sections distinct random bits out of the chain's sections
+static juce::uint32 makeMask(juce::Random& random, int num_sections)
+{
+    juce::uint32 mask = 0;
+    
+    while (juce::countNumberOfBits(mask) < num_sections)
+        mask |= 1u << random.nextInt(num_chain_sections);
+    
+    return mask;
+}
+
+// One juce::dsp::IIR::Filter per channel and section. The first two channels
+// run their side's sections, encoded to mid and side first if asked to.
+template <typename SampleType>
+static void processReference(std::vector<std::vector<SampleType>>& channels, const std::array<BiquadCoefficients<double>, num_chain_sections>& sections,
+                             juce::uint32 mask, std::array<juce::uint32, 2> side_masks, bool mid_side)
+{
+    using Coefficients = juce::dsp::IIR::Coefficients<SampleType>;
+    const auto pair_mid_side = mid_side && channels.size() >= 2;
+    const SampleType half (0.5);
+    
+    if (pair_mid_side)
+    {
+        for (size_t i = 0; i < channels[0].size(); ++i)
+        {
+            const auto left = channels[0][i], right = channels[1][i];
+            channels[0][i] = half * (left + right);
+            channels[1][i] = half * (left - right);
+        }
+    }
+    
+    for (size_t ch = 0; ch < channels.size(); ++ch)
+    {
+        const auto channel_mask = ch < 2 ? mask & side_masks[ch] : mask;
+        
+        for (int section = 0; section < num_chain_sections; ++section)
+        {
+            if ((channel_mask & (1u << section)) == 0)
+                continue;
+            
+            const auto c = convertCoefficients<SampleType>(sections[(size_t) section]);
+            juce::dsp::IIR::Filter<SampleType> filter(typename Coefficients::Ptr(new Coefficients(c.b0, c.b1, c.b2, SampleType (1), c.a1, c.a2)));
+            
+            for (auto& sample : channels[ch])
+                sample = filter.processSample(sample);
+        }
+    }
+    
+    if (pair_mid_side)
+    {
+        for (size_t i = 0; i < channels[0].size(); ++i)
+        {
+            const auto mid = channels[0][i], side = channels[1][i];
+            channels[0][i] = mid + side;
+            channels[1][i] = mid - side;
+        }
+    }
+}
+
+template <typename TargetType, typename SourceType>
+static std::vector<std::vector<TargetType>> convertChannels(const std::vector<std::vector<SourceType>>& channels)
+{
+    std::vector<std::vector<TargetType>> converted;
+    
+    for (auto& channel : channels)
+        converted.emplace_back(channel.begin(), channel.end());
+    
+    return converted;
+}
+
+struct StereoLayout
+{
+    int num_channels;
+    bool split, mid_side;
+    
+    juce::String getName() const
+    {
+        return juce::String(num_channels) + " ch" + (split ? ", split sides" : "") + (mid_side ? ", mid / side" : "");
+    }
+};
+
+// Every active section count (each has a kernel of its own), processed in
+// blocks of random length so the chunking is covered too
+template <typename SampleType>
+static void verifyKernelSet(Results& results, const CascadeKernelSet<SampleType>& kernel_set)
+{
+    constexpr auto is_float = std::is_same<SampleType, float>::value;
+    const auto tolerance = is_float ? 1.0e-5 : 1.0e-12;
+    const auto sample_rate = 48000.0;
+    const int num_samples = 2048, max_block_size = 256;
+    
+    juce::Random random(1);
+    const auto sections = makeTestSections(random, sample_rate);
+    
+    const StereoLayout layouts[] = { { 1, false, false }, { 2, false, false }, { kernel_set.width * 2 + 1, false, false },
+                                     { 2, true, false }, { 2, false, true }, { 2, true, true }, { 3, true, true } };
+    
+    for (const auto& layout : layouts)
+    {
+        double error = 0;
+        
+        for (int num_sections = 0; num_sections <= num_chain_sections; ++num_sections)
+        {
+            const auto mask = makeMask(random, num_sections);
+            const std::array<juce::uint32, 2> side_masks { layout.split ? (juce::uint32) random.nextInt() : ~0u,
+                                                           layout.split ? (juce::uint32) random.nextInt() : ~0u };
+            
+            BiquadCascade<num_chain_sections, SampleType> cascade;
+            cascade.prepare(layout.num_channels, max_block_size, kernel_set);
+            
+            for (int section = 0; section < num_chain_sections; ++section)
+                cascade.setCoefficients(section, convertCoefficients<SampleType>(sections[(size_t) section]));
+            
+            cascade.setActiveSections(mask);
+            cascade.setSides(side_masks[0], side_masks[1], layout.mid_side);
+            
+            auto output = convertChannels<SampleType>(makeNoise(random, layout.num_channels, num_samples));
+            auto reference = output;
+            auto pointers = getPointers(output);
+            
+            for (int start = 0; start < num_samples;)
+            {
+                const auto length = juce::jmin(num_samples - start, 1 + random.nextInt(max_block_size));
+                cascade.process(pointers.data(), layout.num_channels, start, length);
+                start += length;
+            }
+            
+            processReference(reference, sections, mask, side_masks, layout.mid_side);
+            error = getWorse(error, getError(output, reference));
+        }
+        
+        results.check(juce::String("cascade ") + kernel_set.name + (is_float ? " float, " : " double, ") + layout.getName(), error, tolerance);
+    }
+}
+
+template <typename SampleType>
+static void verifyKernelSets(Results& results)
+{
+    verifyKernelSet(results, getScalarCascadeKernels<SampleType>());
+    
+    if (auto* simd = getSIMDRegisterCascadeKernels<SampleType>())
+        verifyKernelSet(results, *simd);
+    
+    if (juce::SystemStats::hasAVX())
+        if (auto* avx = getAVXCascadeKernels<SampleType>())
+            verifyKernelSet(results, *avx);
+}
+
+//==============================================================================
+// Runs sections through a StateVariableCascade, no ramps
+static std::vector<std::vector<double>> processSvf(const std::vector<SvfCoefficients<double>>& sections, const std::vector<std::vector<double>>& input,
+                                                   std::array<juce::uint32, 2> side_masks = { ~0u, ~0u }, bool mid_side = false)
+{
+    jassert((int) sections.size() <= num_chain_sections);
+    
+    auto output = input;
+    auto pointers = getPointers(output);
+    const auto num_channels = (int) output.size();
+    const auto num_samples = (int) output[0].size();
+    
+    StateVariableCascade<num_chain_sections, double> cascade;
+    cascade.prepare(num_channels, 256);
+    
+    for (size_t section = 0; section < sections.size(); ++section)
+        cascade.setCoefficients((int) section, sections[section], false);
+    
+    cascade.setActiveSections((juce::uint32) ((1ull << sections.size()) - 1));
+    cascade.setSides(side_masks[0], side_masks[1], mid_side);
+    cascade.process(pointers.data(), num_channels, 0, num_samples);
+    
+    return output;
+}
+
+static std::array<BiquadCoefficients<double>, num_chain_sections> toSections(const std::vector<BiquadCoefficients<double>>& biquads)
+{
+    std::array<BiquadCoefficients<double>, num_chain_sections> sections;
+    std::copy(biquads.begin(), biquads.end(), sections.begin());
+    return sections;
+}
+
+// The SVF run as itself against its biquad equivalent, both ways round
+static void verifyStateVariableFilters(Results& results)
+{
+    const auto sample_rate = 48000.0;
+    const int num_samples = 4096;
+    juce::Random random(2);
+    const auto input = makeNoise(random, 1, num_samples);
+    
+    double svf_to_biquad = 0, biquad_to_svf = 0, round_trip = 0;
+    
+    for (int design = 0; design < 200; ++design)
+    {
+        const auto type = design % num_band_types;
+        const auto freq = 20.0 * std::pow(1000.0, random.nextDouble());
+        const auto q = 0.2 + 8.0 * random.nextDouble();
+        const auto gain_db = 36.0 * random.nextDouble() - 18.0;
+        const auto all = (juce::uint32) ~0u;
+        
+        SvfCoefficients<double> svf;
+        makeSvfBandCoefficients(svf, type, sample_rate, freq, q, gain_db);
+        const auto biquad = toBiquadCoefficients(svf);
+        
+        auto reference = input;
+        processReference(reference, toSections({ biquad }), 1u, { all, all }, false);
+        svf_to_biquad = getWorse(svf_to_biquad, getError(processSvf({ svf }, input), reference));
+        
+        const auto back = toSvfCoefficients(biquad);
+        round_trip = getWorse(round_trip, getWorse(getWorse(std::abs(back.g - svf.g) / svf.g, std::abs(back.k - svf.k)),
+                                                   getWorse(std::abs(back.m0 - svf.m0), getWorse(std::abs(back.m1 - svf.m1), std::abs(back.m2 - svf.m2)))));
+        
+        // Matched peaks only exist as biquads
+        BiquadCoefficients<double> designed;
+        makeBandCoefficients(designed, type, sample_rate, freq, q, gain_db, design % 2 == 0 ? Design_Matched : Design_Bilinear);
+        
+        reference = input;
+        processReference(reference, toSections({ designed }), 1u, { all, all }, false);
+        biquad_to_svf = getWorse(biquad_to_svf, getError(processSvf({ toSvfCoefficients(designed) }, input), reference));
+    }
+    
+    results.check("svf band -> biquad, response", svf_to_biquad, 1.0e-9);
+    results.check("biquad band -> svf, response", biquad_to_svf, 1.0e-9);
+    results.check("svf -> biquad -> svf, coefficients", round_trip, 1.0e-9);
+    
+    // Cuts: one tan for the whole SVF cascade against the Butterworth biquads
+    double cuts = 0;
+    
+    for (int slope = Slope_12; slope <= Slope_48; ++slope)
+    {
+        for (auto is_low_cut : { true, false })
+        {
+            const auto freq = is_low_cut ? 40.0 : 12000.0;
+            CutSvfCoefficients<double> svf_cut;
+            CutCoefficients<double> biquad_cut;
+            
+            if (is_low_cut)
+            {
+                makeSvfLowCutCoefficients(svf_cut, sample_rate, freq, slope);
+                makeLowCutCoefficients(biquad_cut, sample_rate, freq, slope);
+            }
+            else
+            {
+                makeSvfHighCutCoefficients(svf_cut, sample_rate, freq, slope);
+                makeHighCutCoefficients(biquad_cut, sample_rate, freq, slope);
+            }
+            
+            const auto num_sections = getNumCutSections(slope);
+            const auto all = (juce::uint32) ~0u;
+            auto reference = input;
+            processReference(reference, toSections({ biquad_cut.begin(), biquad_cut.begin() + num_sections }),
+                             (1u << num_sections) - 1, { all, all }, false);
+            cuts = getWorse(cuts, getError(processSvf({ svf_cut.begin(), svf_cut.begin() + num_sections }, input), reference));
+        }
+    }
+    
+    results.check("svf cuts against butterworth biquads", cuts, 1.0e-9);
+    
+    // Split sides and mid / side, encoded in the first section and decoded in the last
+    const auto sections = makeTestSections(random, sample_rate);
+    const std::vector<BiquadCoefficients<double>> biquads(sections.begin(), sections.end());
+    std::vector<SvfCoefficients<double>> svf_sections;
+    
+    for (const auto& c : biquads)
+        svf_sections.push_back(toSvfCoefficients(c));
+    
+    for (auto mid_side : { false, true })
+    {
+        const auto stereo_input = makeNoise(random, 3, num_samples);
+        const std::array<juce::uint32, 2> side_masks { (juce::uint32) random.nextInt(), (juce::uint32) random.nextInt() };
+        
+        auto reference = stereo_input;
+        processReference(reference, sections, ~0u, side_masks, mid_side);
+        
+        results.check(juce::String("svf cascade 3 ch, split sides") + (mid_side ? ", mid / side" : ""),
+                      getError(processSvf(svf_sections, stereo_input, side_masks, mid_side), reference), 1.0e-8);
+    }
+}
+
+//==============================================================================
+// Partitions plain FIR taps the way LinearPhaseKernelDesigner does
+static void partitionKernel(const std::vector<float>& taps, const LinearPhaseLayout& layout, float* kernel_spectra)
+{
+    juce::dsp::FFT fft(juce::roundToInt(std::log2(layout.getFFTSize())));
+    std::vector<float> buffer((size_t) (2 * layout.getFFTSize()));
+    
+    for (int p = 0; p < layout.getNumPartitions(); ++p)
+    {
+        std::fill(buffer.begin(), buffer.end(), 0.f);
+        std::copy(taps.begin() + p * layout.partition_size, taps.begin() + (p + 1) * layout.partition_size, buffer.begin());
+        fft.performRealOnlyForwardTransform(buffer.data(), true);
+        std::copy(buffer.begin(), buffer.begin() + layout.getSpectrumFloats(), kernel_spectra + p * layout.getSpectrumFloats());
+    }
+}
+
+// Random decaying taps, a kernel for the first channel and one for the
+// others, against direct convolution delayed by one partition
+static void verifyConvolver(Results& results)
+{
+    LinearPhaseLayout layout;
+    layout.kernel_length = 2048;
+    layout.partition_size = 128;
+    
+    const int num_channels = 3, num_samples = 8192;
+    juce::Random random(3);
+    
+    std::array<std::vector<float>, LinearPhaseKernels::num_kernels> taps;
+    LinearPhaseKernels kernels;
+    kernels.spectra.resize((size_t) (LinearPhaseKernels::num_kernels * layout.getKernelFloats()));
+    
+    for (size_t k = 0; k < taps.size(); ++k)
+    {
+        taps[k].resize((size_t) layout.kernel_length);
+        
+        for (int i = 0; i < layout.kernel_length; ++i)
+            taps[k][(size_t) i] = (random.nextFloat() * 2.f - 1.f) * std::exp(-4.f * (float) i / (float) layout.kernel_length);
+        
+        partitionKernel(taps[k], layout, kernels.spectra.data() + k * (size_t) layout.getKernelFloats());
+    }
+    
+    for (auto mid_side : { false, true })
+    {
+        kernels.mid_side = mid_side;
+        
+        UniformPartitionedConvolver convolver;
+        convolver.prepare(num_channels, layout);
+        convolver.setKernels(kernels);
+        
+        const auto input = makeNoise(random, num_channels, num_samples);
+        auto output = convertChannels<float>(input);
+        auto pointers = getPointers(output);
+        
+        for (int start = 0; start < num_samples;)
+        {
+            const auto length = juce::jmin(num_samples - start, 1 + random.nextInt(300));
+            std::vector<float*> block;
+            
+            for (auto* channel : pointers)
+                block.push_back(channel + start);
+            
+            convolver.process(block.data(), num_channels, length);
+            start += length;
+        }
+        
+        // Direct form, in double
+        auto source = input;
+        
+        if (mid_side)
+        {
+            for (int i = 0; i < num_samples; ++i)
+            {
+                const auto left = input[0][(size_t) i], right = input[1][(size_t) i];
+                source[0][(size_t) i] = 0.5 * (left + right);
+                source[1][(size_t) i] = 0.5 * (left - right);
+            }
+        }
+        
+        std::vector<std::vector<double>> reference((size_t) num_channels, std::vector<double>((size_t) num_samples));
+        
+        for (int ch = 0; ch < num_channels; ++ch)
+        {
+            const auto& h = taps[ch == 0 ? 0 : 1];
+            
+            for (int i = layout.partition_size; i < num_samples; ++i)
+            {
+                const auto n = i - layout.partition_size;
+                double sum = 0;
+                
+                for (int j = 0; j <= juce::jmin(n, layout.kernel_length - 1); ++j)
+                    sum += (double) h[(size_t) j] * source[(size_t) ch][(size_t) (n - j)];
+                
+                reference[(size_t) ch][(size_t) i] = sum;
+            }
+        }
+        
+        if (mid_side)
+        {
+            for (int i = 0; i < num_samples; ++i)
+            {
+                const auto mid = reference[0][(size_t) i], side = reference[1][(size_t) i];
+                reference[0][(size_t) i] = mid + side;
+                reference[1][(size_t) i] = mid - side;
+            }
+        }
+        
+        results.check(juce::String("convolver 3 ch, two kernels") + (mid_side ? ", mid / side" : ""),
+                      getError(convertChannels<double>(output), reference), 1.0e-5);
+    }
+}
+
+// The designed kernel's impulse response is symmetric and has the chain's magnitude
+static void verifyLinearPhaseKernel(Results& results)
+{
+    const auto sample_rate = 48000.0;
+    const auto layout = LinearPhaseLayout::create(sample_rate, 512);
+    
+    ChainSettings settings;
+    settings.low_cut_freq = 100.f;
+    settings.low_cut_slope = Slope_24;
+    settings.high_cut_freq = 12000.f;
+    settings.band_gain_db = { 4.f, -6.f, 3.f };
+    
+    ChainCoefficients coefficients;
+    designChainCoefficients(settings, sample_rate, coefficients);
+    
+    LinearPhaseKernelDesigner designer;
+    designer.prepare(sample_rate, layout);
+    
+    LinearPhaseKernels kernels;
+    kernels.spectra.resize((size_t) (LinearPhaseKernels::num_kernels * layout.getKernelFloats()));
+    designer.design(coefficients, kernels.spectra.data());
+    std::copy(kernels.spectra.begin(), kernels.spectra.begin() + layout.getKernelFloats(), kernels.spectra.begin() + layout.getKernelFloats());
+    
+    UniformPartitionedConvolver convolver;
+    convolver.prepare(1, layout);
+    convolver.setKernels(kernels);
+    
+    std::vector<float> response((size_t) (layout.getLatencySamples() + layout.kernel_length));
+    response[0] = 1.f;
+    auto* data = response.data();
+    convolver.process(&data, 1, (int) response.size());
+    
+    // Centred on the latency
+    const auto centre = (size_t) layout.getLatencySamples();
+    double asymmetry = 0, peak = 0;
+    
+    for (size_t i = 0; i < (size_t) layout.kernel_length / 2; ++i)
+    {
+        asymmetry = getWorse(asymmetry, (double) std::abs(response[centre + i] - response[centre - i]));
+        peak = getWorse(peak, (double) std::abs(response[centre + i]));
+    }
+    
+    results.check("linear phase kernel, symmetry", asymmetry / peak, 1.0e-4);
+    
+    double magnitude_error_db = 0;
+    
+    for (auto freq : { 300.0, 500.0, 1000.0, 2000.0, 5000.0, 8000.0 })
+    {
+        const auto w = juce::MathConstants<double>::twoPi * freq / sample_rate;
+        const std::complex<double> z = std::polar(1.0, -w);
+        std::complex<double> fir, chain = 1.0;
+        
+        for (size_t i = 0; i < response.size(); ++i)
+            fir += (double) response[i] * std::polar(1.0, -w * (double) i);
+        
+        forEachActiveSection(coefficients, [&](const BiquadCoefficients<double>& c)
+        {
+            chain *= (c.b0 + c.b1 * z + c.b2 * z * z) / (1.0 + c.a1 * z + c.a2 * z * z);
+        });
+        
+        magnitude_error_db = getWorse(magnitude_error_db, std::abs(20.0 * std::log10(std::abs(fir) / std::abs(chain))));
+    }
+    
+    results.check("linear phase kernel, magnitude (dB)", magnitude_error_db, 0.05);
+}
+
+//==============================================================================
+int runVerification()
+{
+    Results results;
+    
+    verifyKernelSets<float>(results);
+    verifyKernelSets<double>(results);
+    verifyStateVariableFilters(results);
+    verifyConvolver(results);
+    verifyLinearPhaseKernel(results);
+    
+    std::cout << (results.failures == 0 ? juce::String("All checks passed")
+                                        : juce::String(results.failures) + " checks failed") << std::endl;
+    
+    return results.failures;
+}
@@ -0,0 +1,21 @@
+/*
+  ==============================================================================
+
+    Benchmark --verify. Checks the optimised DSP against plain references
+    instead of timing it:
+
+    - every cascade kernel set this CPU can run (scalar, SIMDRegister,
+      AVX), float and double, for every active section count, against
+      one juce::dsp::IIR::Filter per channel and section, including the
+      split sides and mid / side paths
+    - the state variable filter cascade and the SVF <-> biquad conversions
+    - the partitioned convolver against direct convolution, per side and
+      mid / side, and the linear phase kernel against the chain's response
+
+  ==============================================================================
+*/
+
+#pragma once
+
+// Runs every check, prints one line each and returns how many failed
+int runVerification();